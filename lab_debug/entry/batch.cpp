@@ -0,0 +1,53 @@
+#include <sys/stat.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sketchifyBatch.h"
+
+/**
+ * Sketchifies every image given on the command line into one directory and
+ * reports where the time went:
+ *
+ *     ./batch OUTPUT_DIR INPUT...
+ *
+ * Each INPUT is a directory of PNG files, a PNG file, or a text file listing
+ * PNG files one per line.
+ */
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " OUTPUT_DIR INPUT..." << std::endl;
+        return 1;
+    }
+
+    std::string outputDir = argv[1];
+    mkdir(outputDir.c_str(), 0755);
+    std::vector<std::string> inputs(argv + 2, argv + argc);
+    std::vector<std::string> files = listSketchifyInputs(inputs);
+    if (files.empty()) {
+        std::cerr << "No PNG files found." << std::endl;
+        return 1;
+    }
+
+    SketchifyStats stats = sketchifyBatch(files, outputDir);
+
+    double busy = stats.decodeSeconds + stats.detectSeconds + stats.encodeSeconds;
+    double megabytes = stats.inputBytes / (1024.0 * 1024.0);
+    std::cout << stats.images << " images sketchified";
+    if (stats.failed)
+        std::cout << ", " << stats.failed << " failed";
+    std::cout << " on " << stats.threads << " threads in " << stats.wallSeconds << " s" << std::endl;
+    std::cout << "  " << (stats.images / stats.wallSeconds) << " images/s, "
+              << (megabytes / stats.wallSeconds) << " MB/s in, "
+              << (stats.pixels / stats.wallSeconds / 1e6) << " Mpixels/s" << std::endl;
+
+    const char* names[] = {"decode", "detect", "encode"};
+    double seconds[] = {stats.decodeSeconds, stats.detectSeconds, stats.encodeSeconds};
+    for (int i = 0; i < 3; i++) {
+        std::cout << "  " << names[i] << ": " << seconds[i] << " s of thread time ("
+                  << (busy > 0 ? 100 * seconds[i] / busy : 0) << "%)" << std::endl;
+    }
+    std::cout << "  cores busy: " << (busy / stats.wallSeconds) << " of " << stats.threads << std::endl;
+    return stats.failed ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file ContentHash.cpp
+ * Implementation of the XXH64 hash.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <cstring>
+
+#include "ContentHash.h"
+
+namespace cs225 {
+  static const std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+  static const std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+  static const std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+  static const std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+  static const std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+  static inline std::uint64_t rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  /** Loads little-endian words regardless of alignment (x86 and ARM are little-endian). */
+  static inline std::uint64_t read64(const unsigned char * p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline std::uint32_t read32(const unsigned char * p) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  static inline std::uint64_t xxRound(std::uint64_t acc, std::uint64_t input) {
+    acc += input * prime2;
+    acc = rotl(acc, 31);
+    return acc * prime1;
+  }
+
+  static inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t lane) {
+    acc ^= xxRound(0, lane);
+    return (acc * prime1) + prime4;
+  }
+
+  std::uint64_t xxHash64(const void * data, std::size_t size, std::uint64_t seed) {
+    const unsigned char * p = static_cast<const unsigned char *>(data);
+    const unsigned char * end = p + size;
+    std::uint64_t h;
+
+    if (size >= 32) {
+      // The four lanes are independent, so the compiler can keep them all
+      // in flight (and vectorize them where 64-bit multiplies are cheap)
+      std::uint64_t v1 = seed + prime1 + prime2;
+      std::uint64_t v2 = seed + prime2;
+      std::uint64_t v3 = seed;
+      std::uint64_t v4 = seed - prime1;
+      const unsigned char * limit = end - 32;
+      do {
+        v1 = xxRound(v1, read64(p));
+        v2 = xxRound(v2, read64(p + 8));
+        v3 = xxRound(v3, read64(p + 16));
+        v4 = xxRound(v4, read64(p + 24));
+        p += 32;
+      } while (p <= limit);
+
+      h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+      h = mergeRound(h, v1);
+      h = mergeRound(h, v2);
+      h = mergeRound(h, v3);
+      h = mergeRound(h, v4);
+    } else {
+      h = seed + prime5;
+    }
+    h += static_cast<std::uint64_t>(size);
+
+    // Up to 31 remaining bytes
+    for (; p + 8 <= end; p += 8) {
+      h ^= xxRound(0, read64(p));
+      h = (rotl(h, 27) * prime1) + prime4;
+    }
+    if (p + 4 <= end) {
+      h ^= static_cast<std::uint64_t>(read32(p)) * prime1;
+      h = (rotl(h, 23) * prime2) + prime3;
+      p += 4;
+    }
+    for (; p < end; p++) {
+      h ^= (*p) * prime5;
+      h = rotl(h, 11) * prime1;
+    }
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+  }
+}
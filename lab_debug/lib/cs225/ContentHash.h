@@ -0,0 +1,25 @@
+/**
+ * @file ContentHash.h
+ * Fast 64-bit hashing of pixel data.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cs225 {
+  /**
+   * Hashes `size` bytes with the XXH64 algorithm (https://xxhash.com):
+   * four independent 64-bit lanes consume 32 bytes per step, so it runs at
+   * several GB/s, and any change to the input changes the result with
+   * probability 1 - 2^-64. Not suitable where an adversary picks the data.
+   * @param data First byte to hash.
+   * @param size Number of bytes to hash.
+   * @param seed Starting value; different seeds give unrelated hashes.
+   * @return The 64-bit hash.
+   */
+  std::uint64_t xxHash64(const void * data, std::size_t size, std::uint64_t seed = 0);
+}
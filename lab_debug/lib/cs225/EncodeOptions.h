@@ -0,0 +1,74 @@
+/**
+ * @file EncodeOptions.h
+ * Settings that trade file size for speed when writing a cs225::PNG.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+struct LodePNGEncoderSettings;
+
+namespace cs225 {
+  /**
+   * Settings for PNG::writeToFile(). Start from one of the presets and
+   * adjust individual fields as needed; a default-constructed
+   * EncodeOptions is the same as balanced(). Setting `parallel` speeds up
+   * any preset on large images at the cost of a slightly larger file.
+   */
+  struct EncodeOptions {
+    /** How each scanline is filtered before it is compressed. */
+    enum class Filter {
+      None,         /**< No filtering. */
+      MinSum,       /**< Per row, the filter with the smallest sum of absolute values. */
+      BruteForce    /**< Per row, the filter that actually compresses smallest. Slow. */
+    };
+
+    /** How the filtered scanlines are deflated. */
+    enum class Compression {
+      Stored,       /**< No compression at all. */
+      RunLength,    /**< Only repeats of the previous byte or pixel. */
+      LZ77          /**< Full LZ77 matching within windowSize bytes. */
+    };
+
+    Filter filter = Filter::MinSum;          /**< Scanline filter choice. */
+    Compression compression = Compression::LZ77;  /**< Deflate strategy. */
+    unsigned windowSize = 2048;              /**< LZ77 window: a power of two up to 32768. */
+    unsigned niceMatch = 128;                /**< LZ77 stops searching at a match this long (max 258). */
+    bool lazyMatching = true;                /**< Try one byte later before taking an LZ77 match. */
+    bool autoConvert = true;                 /**< Write the smallest color type that holds every pixel. */
+    bool parallel = false;                   /**< Deflate 128 KB blocks on the shared ThreadPool. */
+
+    /**
+      * Zero filter, run-length deflate and always 8-bit RGBA output, for
+      * intermediate frames and debug dumps that only need to be written
+      * quickly.
+      * @return The options for the fastest encode.
+      */
+    static EncodeOptions fastest();
+
+    /**
+      * The lodepng defaults: min-sum filtering and lazy LZ77 matching in a
+      * 2048 byte window.
+      * @return The default options.
+      */
+    static EncodeOptions balanced();
+
+    /**
+      * Brute-force filter selection and LZ77 over the full 32K window, for
+      * images that are written once and read many times. Much slower than
+      * balanced(); drawings and images with flat areas typically shrink by
+      * 10-15%, while noisy photographs can come out slightly larger.
+      * @return The options for the smallest files.
+      */
+    static EncodeOptions smallest();
+  };
+
+  /**
+   * Copies `options` into lodepng's encoder settings, as used by
+   * PNG::writeToFile() and PNGWriter.
+   * @param options Options to apply.
+   * @param settings lodepng settings to change.
+   */
+  void applyEncodeOptions(EncodeOptions const & options, LodePNGEncoderSettings & settings);
+}
@@ -0,0 +1,130 @@
+/**
+ * @file ImageCache.h
+ * On-disk cache of decoded images, keyed by the file they were decoded from.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cs225 {
+  /**
+   * A directory of decoded pixel buffers, so that a PNG read again later
+   * (by this or another run) is mapped into memory instead of decoded and
+   * color-converted again.
+   *
+   * Each entry is one file, named after a hash of the source file's path,
+   * modification time and size and of the pixel layout it holds, so an
+   * edited source file is simply a miss. An entry is a page of header
+   * followed by the raw pixels, page-aligned, and is mapped copy-on-write:
+   * the pixels can be used (and modified) in place without touching the
+   * file. Least recently used entries are deleted once the directory grows
+   * beyond its size cap.
+   *
+   * The cache is only an optimization: any failure to read or write it
+   * just means the image is decoded as usual.
+   */
+  class ImageCache {
+  public:
+    /**
+      * A decoded image found in the cache.
+      */
+    struct Entry {
+      unsigned int width;                     /**< Width of the image. */
+      unsigned int height;                    /**< Height of the image. */
+      std::shared_ptr<unsigned char> pixels;  /**< The pixels, writable; keeps the mapping alive. */
+      std::size_t size;                       /**< Number of bytes of pixels. */
+    };
+
+    /**
+      * Creates a cache in the given directory, which is created when the
+      * first entry is stored.
+      * @param directory Directory to keep the entries in.
+      * @param maxBytes Total size of entries to keep.
+      */
+    ImageCache(std::string const & directory, std::uint64_t maxBytes);
+
+    /**
+      * Gets the cache used by PNG::readFromFile(). Its directory is
+      * $CS225_IMAGE_CACHE if set, otherwise a cs225 directory under
+      * $XDG_CACHE_HOME or ~/.cache; its size cap is $CS225_IMAGE_CACHE_MB
+      * megabytes, 1024 by default.
+      * @return The shared cache.
+      */
+    static ImageCache & shared();
+
+    /**
+      * Looks up the pixels decoded from `fileName` in the given layout.
+      * @param fileName Source file the pixels were decoded from.
+      * @param layout Name of the pixel layout the caller expects.
+      * @param entry Set to the cached image on a hit.
+      * @return true, if the cache held a current entry.
+      */
+    bool load(std::string const & fileName, std::string const & layout, Entry & entry);
+
+    /**
+      * Stores the pixels decoded from `fileName`, then evicts the least
+      * recently used entries if the cache has grown beyond its cap.
+      * @param fileName Source file the pixels were decoded from.
+      * @param layout Name of the pixel layout of `pixels`.
+      * @param width Width of the image.
+      * @param height Height of the image.
+      * @param pixels The pixels.
+      * @param size Number of bytes of pixels.
+      * @return true, if the entry was written.
+      */
+    bool store(std::string const & fileName, std::string const & layout,
+               unsigned int width, unsigned int height,
+               const void * pixels, std::size_t size);
+
+    /**
+      * Deletes least recently used entries until the cache is within its
+      * size cap.
+      */
+    void evict();
+
+    /**
+      * Gets the directory the entries are kept in.
+      * @return The cache directory.
+      */
+    std::string const & directory() const;
+
+    /**
+      * Gets the total size of entries the cache keeps.
+      * @return The size cap in bytes.
+      */
+    std::uint64_t maxBytes() const;
+
+    /**
+      * Sets the total size of entries the cache keeps, evicting entries
+      * if it is now over the cap.
+      * @param maxBytes The size cap in bytes.
+      */
+    void setMaxBytes(std::uint64_t maxBytes);
+
+  private:
+    std::string directory_;     /*< Directory holding the entries */
+    std::uint64_t maxBytes_;    /*< Size cap for the entries */
+    std::uint64_t usedBytes_;   /*< Estimated size of the entries, once scanned */
+    bool scanned_;              /*< Whether usedBytes_ has been measured */
+    std::mutex mutex_;          /*< Guards the fields above */
+
+    /**
+     * Gets the path of the entry for `fileName` in `layout`, and the source
+     * file's size and modification time; returns false if it can't be stat'd.
+     */
+    bool _entryPath(std::string const & fileName, std::string const & layout, std::string & path,
+                    std::uint64_t & sourceSize, std::int64_t & sourceTime) const;
+
+    /**
+     * Deletes entries until the cache is within its cap; mutex_ must be held.
+     */
+    void _evict();
+  };
+}
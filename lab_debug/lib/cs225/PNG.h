@@ -6,12 +6,31 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 using std::string;
 
+#include <vector>
+
+#include "EncodeOptions.h"
 #include "HSLAPixel.h"
+#include "PixelFormat.h"
+#include "SpanMask.h"
 
 namespace cs225 {
+  /**
+   * An image made of HSLAPixels, read from and written to PNG files.
+   *
+   * A PNG is not safe to use from several threads at once, even through
+   * its const functions: const row(), getPixel() and forEachRow() expand a
+   * compact image (see setPixelFormat()) to HSLA64 in place, and digest()
+   * caches its result. To read one image from several threads, first call
+   * setPixelFormat(PixelFormat::HSLA64) and digest() on one thread; after
+   * that, const functions may be called concurrently.
+   */
   class PNG {
   public:
     /**
@@ -28,11 +47,23 @@ namespace cs225 {
 
     /**
       * Copy constructor: creates a new PNG image that is a copy of
-      * another.
+      * another. The copy shares the other image's pixel buffer and takes
+      * O(1) time; the pixels are only copied when one of the sharing
+      * images first hands out mutable access (non-const getPixel(), row()
+      * or forEachRow(), or transform()). An image that has handed out
+      * mutable access since its pixels were allocated is copied eagerly,
+      * so references obtained before a copy never alias it.
       * @param other PNG to be copied.
       */
     PNG(PNG const & other);
 
+    /**
+      * Move constructor: takes the pixels of `other` without copying them,
+      * leaving `other` an empty 0x0 image.
+      * @param other PNG to be moved from.
+      */
+    PNG(PNG && other) noexcept;
+
     /**
       * Destructor: frees all memory associated with a given PNG object.
       * Invoked by the system.
@@ -41,13 +72,27 @@ namespace cs225 {
 
     /**
       * Assignment operator for setting two PNGs equal to one another.
+      * Shares pixels as the copy constructor does.
       * @param other Image to copy into the current image.
       * @return The current image for assignment chaining.
       */
     PNG const & operator= (PNG const & other);
 
     /**
-      * Equality operator: checks if two images are the same.
+      * Move assignment operator: takes the pixels of `other` without
+      * copying them, leaving `other` an empty 0x0 image.
+      * @param other Image to move into the current image.
+      * @return The current image for assignment chaining.
+      */
+    PNG const & operator= (PNG && other) noexcept;
+
+    /**
+      * Equality operator: checks if two images are the same, i.e. have the
+      * same dimensions and the same 8-bit RGBA value at every pixel. The
+      * dimensions and then the digest() of each image are checked first,
+      * so most different images are told apart without comparing pixels;
+      * images with equal digests are then compared pixel by pixel, so a
+      * hash collision cannot make different images equal.
       * @param other Image to be checked.
       * @return Whether the current image is equal to the other image.
       */
@@ -63,18 +108,34 @@ namespace cs225 {
 
     /**
       * Reads in a PNG image from a file.
-      * Overwrites any current image content in the PNG.
+      * Overwrites any current image content in the PNG. The file is
+      * memory-mapped and decoded in place rather than copied to the heap.
       * @param fileName Name of the file to be read from.
+      * @param useCache If true, look the decoded pixels up in
+      *   ImageCache::shared() first, and store them there after decoding.
+      *   A hit maps the cached pixels (in the current pixelFormat()) as
+      *   the image's buffer, skipping decoding and color conversion.
       * @return true, if the image was successfully read and loaded.
       */
-    bool readFromFile(string const & fileName);
+    bool readFromFile(string const & fileName, bool useCache = false);
+
+    /**
+      * Reads in a PNG image from an encoded PNG held in memory.
+      * Overwrites any current image content in the PNG.
+      * @param data First byte of the encoded PNG.
+      * @param size Number of bytes of encoded PNG.
+      * @return true, if the image was successfully read and loaded.
+      */
+    bool readFromMemory(const unsigned char * data, std::size_t size);
 
     /**
       * Writes a PNG image to a file.
       * @param fileName Name of the file to be written.
+      * @param options Filtering and compression settings, e.g.
+      *   EncodeOptions::fastest() for debug output.
       * @return true, if the image was successfully written.
       */
-    bool writeToFile(string const & fileName);
+    bool writeToFile(string const & fileName, EncodeOptions const & options = EncodeOptions());
 
     /**
       * Pixel access operator. Gets a reference to the pixel at the given
@@ -96,6 +157,52 @@ namespace cs225 {
       */
     const HSLAPixel & getPixel(unsigned int x, unsigned int y) const;
 
+    /**
+      * Gets a pointer to the first pixel of row `y`; the `width()` pixels
+      * of a row are contiguous. Unlike getPixel(), the row index is only
+      * checked (with an assert) in debug builds.
+      * @param y Row to get, in [0, height()).
+      * @return Pointer to the pixel at (0, y).
+      */
+    HSLAPixel * row(unsigned int y);
+
+    /**
+      * Gets a const pointer to the first pixel of row `y`.
+      * @param y Row to get, in [0, height()).
+      * @return Const pointer to the pixel at (0, y).
+      */
+    const HSLAPixel * row(unsigned int y) const;
+
+    /**
+      * A function run on one row of an image: gets the row index and a
+      * pointer to the row's `width()` contiguous pixels.
+      */
+    typedef std::function<void(unsigned int y, HSLAPixel * row)> RowKernel;
+    typedef std::function<void(unsigned int y, const HSLAPixel * row)> ConstRowKernel;
+
+    /**
+      * Runs `kernel` once on every row of the image. Rows are split across
+      * the shared ThreadPool, so `kernel` may run concurrently on different
+      * rows and must only write to the row it was given.
+      * @param kernel Function to run on each row.
+      */
+    void forEachRow(RowKernel const & kernel);
+
+    /**
+      * Runs `kernel` once on every row of the image, without modifying it.
+      * @param kernel Function to run on each row.
+      */
+    void forEachRow(ConstRowKernel const & kernel) const;
+
+    /**
+      * Applies `kernel` to every pixel of the image, in parallel by rows.
+      * The kernel is called as kernel(HSLAPixel & pixel) and may run
+      * concurrently on different pixels.
+      * @param kernel Function to apply to each pixel.
+      */
+    template <typename PixelKernel>
+    void transform(PixelKernel kernel);
+
     /**
       * Gets the width of this image.
       * @return Width of the image.
@@ -111,22 +218,187 @@ namespace cs225 {
     /**
       * Resizes the image to the given coordinates. Attempts to preserve
       * existing pixel data in the image when doing so, but will crop if
-      * necessary. No pixel interpolation is done.
+      * necessary; new pixels are white. No pixel interpolation is done.
+      * Rows are moved in place when the new size fits in capacity(), so
+      * no memory is allocated.
       * @param newWidth New width of the image.
       * @param newHeight New height of the image.
       */
     void resize(unsigned int newWidth, unsigned int newHeight);
 
+    /**
+      * Makes room for at least `pixels` pixels, so that resize() to any
+      * size of up to that many pixels will not allocate. Does not change
+      * the image.
+      * @param pixels Number of pixels to make room for.
+      */
+    void reserve(std::size_t pixels);
+
+    /**
+      * Gets the number of pixels the image can hold without allocating.
+      * @return The capacity of the pixel buffer.
+      */
+    std::size_t capacity() const;
+
+    /**
+      * A rectangle of pixels: the `width` x `height` pixels whose upper
+      * left corner is at (x, y).
+      */
+    struct Rect {
+      unsigned int x;
+      unsigned int y;
+      unsigned int width;
+      unsigned int height;
+    };
+
+    /**
+      * Gets a copy of the pixels of this image within `rect`. Parts of
+      * `rect` outside of the image are left out of the result.
+      * @param rect Area of this image to copy.
+      * @return A new image of (at most) rect.width x rect.height pixels.
+      */
+    PNG crop(Rect const & rect) const;
+
+    /**
+      * Copies the pixels of `source` within `rect` into this image, with
+      * the upper left corner of `rect` landing on (dstX, dstY). Pixels
+      * outside of either image are skipped; this image is not resized.
+      * `source` may be this image, and the two areas may overlap.
+      * @param source Image to copy from.
+      * @param rect Area of `source` to copy.
+      * @param dstX X-coordinate in this image of the first copied column.
+      * @param dstY Y-coordinate in this image of the first copied row.
+      * @param skipTransparent If true, pixels of `source` whose alpha is 0
+      *   are not copied, leaving this image's pixel beneath them.
+      */
+    void blit(PNG const & source, Rect const & rect, unsigned int dstX, unsigned int dstY,
+              bool skipTransparent = false);
+
+    /**
+      * Sets the pixels of this image within `rect` to `color`. Parts of
+      * `rect` outside of the image are skipped.
+      * @param rect Area to fill.
+      * @param color Color to fill it with.
+      */
+    void fill(Rect const & rect, HSLAPixel const & color);
+
+    /**
+      * Copies the opaque pixels of `source` within `rect` into this image,
+      * like blit() with skipTransparent, but one memcpy per run of `mask`
+      * instead of one alpha test per pixel.
+      * @param source Image to copy from; not this image.
+      * @param mask The SpanMask of `source`, as it is now.
+      * @param rect Area of `source` to copy.
+      * @param dstX X-coordinate in this image of the first copied column.
+      * @param dstY Y-coordinate in this image of the first copied row.
+      */
+    void blit(PNG const & source, SpanMask const & mask, Rect const & rect,
+              unsigned int dstX, unsigned int dstY);
+
+    /**
+      * Gets a 64-bit digest of the image: an XXH64 hash (see xxHash64())
+      * of its dimensions and of the 8-bit RGBA value of every pixel, so it
+      * is the same for any two images that are ==, whatever their storage
+      * format, and differs for images that are not with probability
+      * 1 - 2^-64. The digest is cached until the image is next modified;
+      * images that have handed out mutable access (see PNG(PNG const &))
+      * may still be changed through it, so theirs is recomputed each time.
+      * @return The digest of the image.
+      */
+    std::uint64_t digest() const;
+
+    /**
+      * Gets the format the pixels of this image are currently stored in.
+      * @return The current storage format.
+      */
+    PixelFormat pixelFormat() const;
+
+    /**
+      * Converts the pixel storage of this image to the given format.
+      * Compact formats (RGBA8, HSLA32, HSLA32_PLANAR) use 2-8x less memory
+      * than HSLA64 and are kept by readFromFile(), which decodes straight
+      * into them, and by writeToFile(), which encodes straight from them.
+      * Any other pixel access expands the image back to HSLA64 first, since
+      * getPixel() must hand out HSLAPixel references; call this again to
+      * re-compact the image afterwards. Converting to a compact format
+      * rounds each channel to the precision of that format.
+      * @param format The storage format to convert to.
+      */
+    void setPixelFormat(PixelFormat format);
+
   private:
+    /* Writes converted rows straight into the pixels, through _own() */
+    friend class PremultipliedImage;
+
     unsigned int width_;            /*< Width of the image */
     unsigned int height_;           /*< Height of the image */
-    HSLAPixel *imageData_;          /*< Array of pixels */
+
+    /* Expanding a compact image is invisible to users of the const API,
+     * so the storage below is mutable. */
+    mutable PixelFormat format_;                     /*< Current storage format */
+    mutable std::shared_ptr<HSLAPixel[]> buffer_;    /*< Owner of imageData_, possibly shared with copies */
+    mutable HSLAPixel *imageData_;                   /*< Array of pixels, when stored as HSLA64 */
+    mutable std::size_t capacity_;                   /*< Number of pixels allocated in buffer_ */
+    mutable bool shareable_;                         /*< No mutable access handed out since allocation */
+    mutable std::vector<unsigned char> packedData_;  /*< Pixel bytes, when stored in a compact format */
+    mutable std::uint64_t digest_;                   /*< Cached result of digest() */
+    mutable bool digestValid_;                       /*< Whether digest_ matches the pixels */
 
     /**
      * Copies the contents of `other` to self
      */
     void _copy(PNG const & other);
 
+    /**
+     * Replaces the pixel buffer with a new, unshared one of `count` pixels.
+     */
+    void _allocate(unsigned int count) const;
+
+    /**
+     * Drops this image's reference to its pixel buffer.
+     */
+    void _release() const;
+
+    /**
+     * Prepares the pixels for mutable access: expands compact storage,
+     * takes a private copy of a shared buffer and marks it unshareable.
+     */
+    void _detach();
+
+    /**
+     * Prepares the pixels for a write that hands out no references
+     * (blit(), fill(), PremultipliedImage::store()): like _detach(), but
+     * the buffer stays shareable, so later copies still share it.
+     */
+    void _own();
+
+    /**
+     * Converts compact pixel storage back to an HSLAPixel array, if needed.
+     */
+    void _expand() const;
+
+    /**
+     * Compares the 8-bit RGBA values of two images of the same size.
+     */
+    bool _samePixels(PNG const & other) const;
+
+    /**
+     * Computes digest() without consulting the cache.
+     */
+    std::uint64_t _computeDigest() const;
+
+    /**
+     * Loads the pixels decoded from `fileName` from ImageCache::shared(),
+     * in the current format; returns false on a miss.
+     */
+    bool _readFromCache(string const & fileName);
+
+    /**
+     * Receives decoded rows from lodepng_decode_scanlines() for readFromFile()
+     * and stores them in the PNG pointed to by `png`, in its pixel format.
+     */
+    static unsigned _storeRows(void * png, unsigned int y, unsigned int count, const unsigned char * rows);
+
     /**
      * Common function for powering the following signature stubs.
      * HSLAPixel & getPixel(unsigned int x, unsigned int y);
@@ -138,3 +410,5 @@ namespace cs225 {
   std::ostream & operator<<(std::ostream & out, PNG const & pixel);
   std::stringstream & operator<<(std::stringstream & out, PNG const & pixel);
 }
+
+#include "PNG.hpp"
@@ -0,0 +1,101 @@
+/**
+ * @file PixelFormat.cpp
+ * Conversions between HSLAPixels and the compact PNG storage formats.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <cassert>
+
+#include "PixelFormat.h"
+#include "RGB_HSL_Batch.h"
+
+namespace cs225 {
+  std::size_t bytesPerPixel(PixelFormat format) {
+    switch (format) {
+      case PixelFormat::RGBA8:         return 4;
+      case PixelFormat::HSLA32:        return 4 * sizeof(float);
+      case PixelFormat::HSLA32_PLANAR: return 4 * sizeof(float);
+      case PixelFormat::HSLA64:        break;
+    }
+    return sizeof(HSLAPixel);
+  }
+
+  void packPixels(PixelFormat format, const HSLAPixel * src, unsigned char * dst,
+                  std::size_t first, std::size_t count, std::size_t total) {
+    switch (format) {
+      case PixelFormat::RGBA8: {
+        hsla2rgbaBatch(src, dst + (first * 4), count);
+        break;
+      }
+
+      case PixelFormat::HSLA32: {
+        float * out = reinterpret_cast<float *>(dst) + (first * 4);
+        for (std::size_t i = 0; i < count; i++) {
+          out[(i * 4)]     = src[i].h;
+          out[(i * 4) + 1] = src[i].s;
+          out[(i * 4) + 2] = src[i].l;
+          out[(i * 4) + 3] = src[i].a;
+        }
+        break;
+      }
+
+      case PixelFormat::HSLA32_PLANAR: {
+        float * h = reinterpret_cast<float *>(dst) + first;
+        float * s = h + total;
+        float * l = s + total;
+        float * a = l + total;
+        for (std::size_t i = 0; i < count; i++) {
+          h[i] = src[i].h;
+          s[i] = src[i].s;
+          l[i] = src[i].l;
+          a[i] = src[i].a;
+        }
+        break;
+      }
+
+      case PixelFormat::HSLA64:
+        assert(false && "HSLA64 is not a compact format");
+        break;
+    }
+  }
+
+  void unpackPixels(PixelFormat format, const unsigned char * src, HSLAPixel * dst,
+                    std::size_t first, std::size_t count, std::size_t total) {
+    switch (format) {
+      case PixelFormat::RGBA8: {
+        rgba2hslaBatch(src + (first * 4), dst, count);
+        break;
+      }
+
+      case PixelFormat::HSLA32: {
+        const float * in = reinterpret_cast<const float *>(src) + (first * 4);
+        for (std::size_t i = 0; i < count; i++) {
+          dst[i].h = in[(i * 4)];
+          dst[i].s = in[(i * 4) + 1];
+          dst[i].l = in[(i * 4) + 2];
+          dst[i].a = in[(i * 4) + 3];
+        }
+        break;
+      }
+
+      case PixelFormat::HSLA32_PLANAR: {
+        const float * h = reinterpret_cast<const float *>(src) + first;
+        const float * s = h + total;
+        const float * l = s + total;
+        const float * a = l + total;
+        for (std::size_t i = 0; i < count; i++) {
+          dst[i].h = h[i];
+          dst[i].s = s[i];
+          dst[i].l = l[i];
+          dst[i].a = a[i];
+        }
+        break;
+      }
+
+      case PixelFormat::HSLA64:
+        assert(false && "HSLA64 is not a compact format");
+        break;
+    }
+  }
+}
@@ -0,0 +1,191 @@
+/**
+ * @file PremultipliedImage.cpp
+ * Implementation of premultiplied-alpha images.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "PremultipliedImage.h"
+#include "RGB_HSL_Batch.h"
+#include "ThreadPool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cs225 {
+  /** Rows converted by each task of the constructor and store(). */
+  static const std::size_t rowsPerTask = 16;
+
+  /** Converts `count` HSLAPixels to premultiplied RGBA floats. */
+  static void loadPixels(const HSLAPixel * in, std::size_t count, unsigned char * bytes, float * out) {
+    hsla2rgbaBatch(in, bytes, count);
+    for (std::size_t x = 0; x < count; x++) {
+      const unsigned char * p = bytes + (x * 4);
+      float alpha = p[3] * (1.0f / 255);
+      float scale = alpha * (1.0f / 255);
+      out[(x * 4)] = p[0] * scale;
+      out[(x * 4) + 1] = p[1] * scale;
+      out[(x * 4) + 2] = p[2] * scale;
+      out[(x * 4) + 3] = alpha;
+    }
+  }
+
+  /** Converts `count` premultiplied RGBA floats back to HSLAPixels. */
+  static void storePixels(const float * in, std::size_t count, unsigned char * bytes, HSLAPixel * out) {
+    for (std::size_t x = 0; x < count; x++) {
+      const float * p = in + (x * 4);
+      float alpha = std::min(std::max(p[3], 0.0f), 1.0f);
+      float unpremultiply = (alpha > 0) ? (255 / alpha) : 0;
+      for (unsigned c = 0; c < 3; c++) {
+        float value = std::min(std::max(p[c] * unpremultiply, 0.0f), 255.0f);
+        bytes[(x * 4) + c] = (unsigned char) std::lround(value);
+      }
+      bytes[(x * 4) + 3] = (unsigned char) std::lround(alpha * 255);
+    }
+    rgba2hslaBatch(bytes, out, count);
+  }
+
+  /** Blends `count` premultiplied pixels of `src` over those of `dst`. */
+  static void overPixels(const float * src, float * dst, std::size_t count) {
+#ifdef __SSE2__
+    // One RGBA pixel per register: dst = src + dst * (1 - src alpha)
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (std::size_t x = 0; x < count; x++) {
+      __m128 s = _mm_loadu_ps(src + (x * 4));
+      __m128 alpha = _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3));
+      __m128 d = _mm_loadu_ps(dst + (x * 4));
+      _mm_storeu_ps(dst + (x * 4), _mm_add_ps(s, _mm_mul_ps(d, _mm_sub_ps(one, alpha))));
+    }
+#else
+    for (std::size_t x = 0; x < count; x++) {
+      const float * s = src + (x * 4);
+      float * d = dst + (x * 4);
+      float remaining = 1 - s[3];
+      for (unsigned c = 0; c < 4; c++) { d[c] = s[c] + (d[c] * remaining); }
+    }
+#endif
+  }
+
+  PremultipliedImage::PremultipliedImage() : width_(0), height_(0) { }
+
+  PremultipliedImage::PremultipliedImage(unsigned int width, unsigned int height)
+    : width_(width), height_(height), pixels_(std::size_t(width) * height * 4, 0.0f) { }
+
+  PremultipliedImage::PremultipliedImage(PNG const & image)
+    : width_(image.width()), height_(image.height()), pixels_(std::size_t(width_) * height_ * 4) {
+    if (width_ == 0 || height_ == 0) { return; }
+
+    // Take the pixels' address up front: row() may expand the image, which
+    // must not happen from several threads at once
+    const HSLAPixel * in = image.row(0);
+    ThreadPool::shared().parallelFor(height_, rowsPerTask, [this, in](std::size_t begin, std::size_t end) {
+      std::vector<unsigned char> bytes(std::size_t(width_) * 4);
+      for (std::size_t y = begin; y < end; y++) {
+        loadPixels(in + (y * width_), width_, bytes.data(), row(y));
+      }
+    });
+  }
+
+  unsigned int PremultipliedImage::width() const {
+    return width_;
+  }
+
+  unsigned int PremultipliedImage::height() const {
+    return height_;
+  }
+
+  float * PremultipliedImage::row(unsigned int y) {
+    return pixels_.data() + (std::size_t(y) * width_ * 4);
+  }
+
+  const float * PremultipliedImage::row(unsigned int y) const {
+    return pixels_.data() + (std::size_t(y) * width_ * 4);
+  }
+
+  void PremultipliedImage::resize(unsigned int width, unsigned int height) {
+    if (width == width_ && height == height_) { return; }
+    PremultipliedImage resized(width, height);
+    resized.copy(*this, PNG::Rect{0, 0, width_, height_}, 0, 0);
+    *this = std::move(resized);
+  }
+
+  void PremultipliedImage::fill(PNG::Rect const & rect, HSLAPixel const & color) {
+    PNG::Rect area = rect;
+    if (!_clip(width_, height_, area, area.x, area.y)) { return; }
+
+    float pixel[4];
+    std::vector<unsigned char> bytes(4);
+    loadPixels(&color, 1, bytes.data(), pixel);
+    for (unsigned y = area.y; y < area.y + area.height; y++) {
+      float * out = row(y) + (std::size_t(area.x) * 4);
+      for (unsigned x = 0; x < area.width; x++) { std::copy(pixel, pixel + 4, out + (x * 4)); }
+    }
+  }
+
+  void PremultipliedImage::copy(PremultipliedImage const & source, PNG::Rect const & rect,
+                                unsigned int dstX, unsigned int dstY) {
+    assert(&source != this);
+    PNG::Rect area = rect;
+    if (!_clip(source.width_, source.height_, area, dstX, dstY)) { return; }
+
+    for (unsigned y = 0; y < area.height; y++) {
+      const float * from = source.row(area.y + y) + (std::size_t(area.x) * 4);
+      std::copy(from, from + (std::size_t(area.width) * 4), row(dstY + y) + (std::size_t(dstX) * 4));
+    }
+  }
+
+  void PremultipliedImage::over(PremultipliedImage const & source, SpanMask const & mask,
+                                PNG::Rect const & rect, unsigned int dstX, unsigned int dstY) {
+    assert(&source != this);
+    assert(mask.width() == source.width_ && mask.height() == source.height_);
+    PNG::Rect area = rect;
+    if (!_clip(source.width_, source.height_, area, dstX, dstY)) { return; }
+
+    unsigned right = area.x + area.width;
+    for (unsigned y = 0; y < area.height; y++) {
+      const float * from = source.row(area.y + y);
+      float * to = row(dstY + y) + (std::size_t(dstX) * 4);
+      for (const SpanMask::Span * span = mask.rowBegin(area.y + y); span != mask.rowEnd(area.y + y); span++) {
+        if (span->end <= area.x) { continue; }
+        if (span->begin >= right) { break; }
+        unsigned begin = std::max(span->begin, area.x);
+        unsigned end = std::min(span->end, right);
+        overPixels(from + (std::size_t(begin) * 4), to + (std::size_t(begin - area.x) * 4), end - begin);
+      }
+    }
+  }
+
+  void PremultipliedImage::store(PNG & image, PNG::Rect const & rect) const {
+    assert(image.width() == width_ && image.height() == height_);
+    PNG::Rect area = rect;
+    if (!_clip(width_, height_, area, area.x, area.y)) { return; }
+
+    // Not row(), which would stop later copies of `image` sharing its pixels
+    image._own();
+    HSLAPixel * out = image.imageData_;
+    ThreadPool::shared().parallelFor(area.height, rowsPerTask, [this, out, &area](std::size_t begin, std::size_t end) {
+      std::vector<unsigned char> bytes(std::size_t(area.width) * 4);
+      for (std::size_t y = area.y + begin; y < area.y + end; y++) {
+        storePixels(row(y) + (std::size_t(area.x) * 4), area.width, bytes.data(),
+                    out + (y * width_) + area.x);
+      }
+    });
+  }
+
+  bool PremultipliedImage::_clip(unsigned int sourceWidth, unsigned int sourceHeight, PNG::Rect & rect,
+                                 unsigned int dstX, unsigned int dstY) const {
+    rect.x = std::min(rect.x, sourceWidth);
+    rect.y = std::min(rect.y, sourceHeight);
+    rect.width = std::min(rect.width, sourceWidth - rect.x);
+    rect.height = std::min(rect.height, sourceHeight - rect.y);
+    rect.width = std::min(rect.width, width_ - std::min(dstX, width_));
+    rect.height = std::min(rect.height, height_ - std::min(dstY, height_));
+    return rect.width != 0 && rect.height != 0;
+  }
+}
@@ -0,0 +1,35 @@
+/**
+ * @file RGB_HSL_Batch.h
+ * Whole-scanline versions of the conversions in RGB_HSL.h.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "HSLAPixel.h"
+
+namespace cs225 {
+  /**
+   * Converts `count` interleaved 8-bit RGBA pixels to HSLAPixels.
+   * Uses AVX2 or SSE4.1 when the CPU supports them and plain rgb2hsl()
+   * otherwise; every path produces results bit-identical to rgb2hsl().
+   * @param rgba Input bytes, four per pixel.
+   * @param hsla Output pixels.
+   * @param count Number of pixels.
+   */
+  void rgba2hslaBatch(const unsigned char * rgba, HSLAPixel * hsla, std::size_t count);
+
+  /**
+   * Converts `count` HSLAPixels to interleaved 8-bit RGBA pixels.
+   * Uses AVX2 or SSE4.1 when the CPU supports them and plain hsl2rgb()
+   * otherwise; every path produces the same bytes as hsl2rgb() for
+   * pixels whose channels lie in their documented ranges.
+   * @param hsla Input pixels.
+   * @param rgba Output bytes, four per pixel.
+   * @param count Number of pixels.
+   */
+  void hsla2rgbaBatch(const HSLAPixel * hsla, unsigned char * rgba, std::size_t count);
+}
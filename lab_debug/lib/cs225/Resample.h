@@ -0,0 +1,45 @@
+/**
+ * @file Resample.h
+ * Resizing images with interpolation.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include "PNG.h"
+
+namespace cs225 {
+  /**
+   * How resample() computes each output pixel from the pixels around it.
+   */
+  enum class ResampleFilter {
+    Nearest,    /**< The nearest source pixel; blocky, but exact colors. */
+    Bilinear,   /**< Triangle filter over the 2x2 nearest pixels when enlarging. */
+    Bicubic,    /**< Catmull-Rom cubic over 4x4 pixels; sharper than bilinear. */
+    Lanczos     /**< Lanczos-3 over 6x6 pixels; sharpest, with slight ringing. */
+  };
+
+  /**
+   * Resizes `source` to `width` x `height` into `destination`.
+   *
+   * Filters other than Nearest are separable: each pass applies weights
+   * precomputed once per output column (or row), widened when shrinking so
+   * every source pixel contributes, and normalized so flat areas stay flat.
+   * Output rows are split across the shared ThreadPool; each task filters
+   * only the source rows its output rows need, so no full-size temporary
+   * copy of the image is made. Filtering is done on RGBA with premultiplied
+   * alpha (interpolating hue directly would wrap the wrong way around the
+   * color wheel), so those filters round colors to 8 bits per channel.
+   *
+   * Nearest maps output pixel (x, y) to source pixel
+   * (floor(x * source.width() / width), floor(y * source.height() / height)).
+   * @param source Image to resize; must not be `destination`.
+   * @param destination Image to write; resized to `width` x `height`.
+   * @param width Width of the resized image.
+   * @param height Height of the resized image.
+   * @param filter How to interpolate between source pixels.
+   */
+  void resample(PNG const & source, PNG & destination, unsigned int width, unsigned int height,
+                ResampleFilter filter);
+}
@@ -0,0 +1,127 @@
+/**
+ * @file ThreadPool.cpp
+ * Implementation of a small fixed-size pool of worker threads.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "ThreadPool.h"
+
+namespace cs225 {
+  struct ThreadPool::Job {
+    RangeFunction const * fn;
+    std::size_t count;
+    std::size_t grain;
+    std::size_t chunks;
+    std::atomic<std::size_t> nextChunk;
+    std::atomic<std::size_t> doneChunks;
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+  };
+
+  ThreadPool::ThreadPool(unsigned threads) : stopping_(false) {
+    for (unsigned i = 0; i < threads; i++) {
+      workers_.emplace_back(&ThreadPool::_workerLoop, this);
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread & worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ThreadPool & ThreadPool::shared() {
+    // The calling thread works too, so start one fewer worker than cores
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+  }
+
+  unsigned ThreadPool::concurrency() const {
+    return workers_.size() + 1;
+  }
+
+  void ThreadPool::parallelFor(std::size_t count, std::size_t grain, RangeFunction const & fn) {
+    if (count == 0) { return; }
+    grain = std::max<std::size_t>(grain, 1);
+
+    // Not worth waking anyone up for
+    if (workers_.empty() || count <= grain) {
+      fn(0, count);
+      return;
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->count = count;
+    job->grain = grain;
+    job->chunks = (count + grain - 1) / grain;
+    job->nextChunk = 0;
+    job->doneChunks = 0;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back(job);
+    }
+    wake_.notify_all();
+
+    // Help out, then wait for chunks still running on workers
+    _runChunks(*job);
+    {
+      std::unique_lock<std::mutex> lock(job->mutex);
+      job->finished.wait(lock, [&job] { return job->doneChunks == job->chunks; });
+    }
+
+    if (job->error) { std::rethrow_exception(job->error); }
+  }
+
+  void ThreadPool::_runChunks(Job & job) {
+    while (true) {
+      std::size_t chunk = job.nextChunk++;
+      if (chunk >= job.chunks) { return; }
+
+      std::size_t begin = chunk * job.grain;
+      std::size_t end = std::min(begin + job.grain, job.count);
+      try {
+        (*job.fn)(begin, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (!job.error) { job.error = std::current_exception(); }
+      }
+
+      if (++job.doneChunks == job.chunks) {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished.notify_all();
+      }
+    }
+  }
+
+  void ThreadPool::_workerLoop() {
+    while (true) {
+      std::shared_ptr<Job> job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (stopping_) { return; }
+
+        job = jobs_.front();
+        // Every chunk is claimed once this worker takes the last one
+        if (job->nextChunk >= job->chunks) {
+          jobs_.pop_front();
+          continue;
+        }
+      }
+      _runChunks(*job);
+    }
+  }
+}
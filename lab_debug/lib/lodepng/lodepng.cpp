@@ -504,7 +504,8 @@ Huffman tree struct, containing multiple representations of the tree
 */
 typedef struct HuffmanTree
 {
-  unsigned* tree2d;
+  unsigned char* table_len; /*decoder lookup table: code length, or 16 for an invalid code (see makeTable)*/
+  unsigned short* table_value; /*decoder lookup table: symbol, or position of the second level table*/
   unsigned* tree1d;
   unsigned* lengths; /*the lengths of the codes of the 1d-tree*/
   unsigned maxbitlen; /*maximum number of bits a single code can get*/
@@ -526,74 +527,122 @@ static void HuffmanTree_draw(HuffmanTree* tree)
 
 static void HuffmanTree_init(HuffmanTree* tree)
 {
-  tree->tree2d = 0;
+  tree->table_len = 0;
+  tree->table_value = 0;
   tree->tree1d = 0;
   tree->lengths = 0;
 }
 
 static void HuffmanTree_cleanup(HuffmanTree* tree)
 {
-  lodepng_free(tree->tree2d);
+  lodepng_free(tree->table_len);
+  lodepng_free(tree->table_value);
   lodepng_free(tree->tree1d);
   lodepng_free(tree->lengths);
 }
 
-/*the tree representation used by the decoder. return value is error*/
-static unsigned HuffmanTree_make2DTree(HuffmanTree* tree)
+/*number of code bits looked up at once in the first level of the decoder table*/
+#define FIRSTBITS 9u
+/*table_len value of bit patterns that are not a code*/
+#define INVALIDLENGTH 16u
+
+static unsigned reverseBits(unsigned bits, unsigned num)
 {
-  unsigned nodefilled = 0; /*up to which node it is filled*/
-  unsigned treepos = 0; /*position in the tree (1 of the numcodes columns)*/
-  unsigned n, i;
+  unsigned i, result = 0;
+  for(i = 0; i != num; ++i) result |= ((bits >> (num - i - 1u)) & 1u) << i;
+  return result;
+}
 
-  tree->tree2d = (unsigned*)lodepng_malloc(tree->numcodes * 2 * sizeof(unsigned));
-  if(!tree->tree2d) return 83; /*alloc fail*/
+/*
+the tree representation used by the decoder: a lookup table indexed by the next FIRSTBITS
+bits of input (first bit read in the least significant bit). Entries for codes of at most
+FIRSTBITS bits give the symbol and its length directly. For longer codes the entry instead
+holds the longest length of the codes sharing that prefix and where their second level table
+starts; that table is indexed by the bits after the prefix. return value is error.
+*/
+static unsigned HuffmanTree_makeTable(HuffmanTree* tree)
+{
+  static const unsigned headsize = 1u << FIRSTBITS;
+  static const unsigned mask = (1u << FIRSTBITS) - 1u;
+  size_t i, size, pointer;
+  unsigned j;
+  unsigned* maxlens; /*longest code length per first level entry*/
 
-  /*
-  convert tree1d[] to tree2d[][]. In the 2D array, a value of 32767 means
-  uninited, a value >= numcodes is an address to another bit, a value < numcodes
-  is a code. The 2 rows are the 2 possible bit values (0 or 1), there are as
-  many columns as codes - 1.
-  A good huffman tree has N * 2 - 1 nodes, of which N - 1 are internal nodes.
-  Here, the internal nodes are stored (what their 0 and 1 option point to).
-  There is only memory for such good tree currently, if there are more nodes
-  (due to too long length codes), error 55 will happen
-  */
-  for(n = 0; n < tree->numcodes * 2; ++n)
+  maxlens = (unsigned*)lodepng_malloc(headsize * sizeof(unsigned));
+  if(!maxlens) return 83; /*alloc fail*/
+  for(i = 0; i != headsize; ++i) maxlens[i] = 0;
+  for(i = 0; i != tree->numcodes; ++i)
+  {
+    unsigned l = tree->lengths[i];
+    unsigned index;
+    if(l <= FIRSTBITS) continue;
+    index = reverseBits(tree->tree1d[i] >> (l - FIRSTBITS), FIRSTBITS);
+    maxlens[index] = LODEPNG_MAX(maxlens[index], l);
+  }
+
+  size = headsize;
+  for(i = 0; i != headsize; ++i)
+  {
+    if(maxlens[i] > FIRSTBITS) size += (size_t)1u << (maxlens[i] - FIRSTBITS);
+  }
+
+  tree->table_len = (unsigned char*)lodepng_malloc(size * sizeof(unsigned char));
+  tree->table_value = (unsigned short*)lodepng_malloc(size * sizeof(unsigned short));
+  if(!tree->table_len || !tree->table_value)
+  {
+    lodepng_free(maxlens);
+    return 83; /*alloc fail*/
+  }
+  for(i = 0; i != size; ++i)
+  {
+    tree->table_len[i] = INVALIDLENGTH;
+    tree->table_value[i] = 0;
+  }
+
+  /*point the first level entries of long codes at their second level tables*/
+  pointer = headsize;
+  for(i = 0; i != headsize; ++i)
   {
-    tree->tree2d[n] = 32767; /*32767 here means the tree2d isn't filled there yet*/
+    if(maxlens[i] <= FIRSTBITS) continue;
+    tree->table_len[i] = (unsigned char)maxlens[i];
+    tree->table_value[i] = (unsigned short)pointer;
+    pointer += (size_t)1u << (maxlens[i] - FIRSTBITS);
   }
+  lodepng_free(maxlens);
 
-  for(n = 0; n < tree->numcodes; ++n) /*the codes*/
+  /*fill in every entry whose bits start with a code; finding one filled already means the
+  code lengths are oversubscribed, see comment in lodepng_error_text*/
+  for(i = 0; i != tree->numcodes; ++i)
   {
-    for(i = 0; i != tree->lengths[n]; ++i) /*the bits for this code*/
+    unsigned l = tree->lengths[i];
+    unsigned reverse;
+    if(l == 0) continue;
+    reverse = reverseBits(tree->tree1d[i], l);
+    if(l <= FIRSTBITS)
     {
-      unsigned char bit = (unsigned char)((tree->tree1d[n] >> (tree->lengths[n] - i - 1)) & 1);
-      /*oversubscribed, see comment in lodepng_error_text*/
-      if(treepos > 2147483647 || treepos + 2 > tree->numcodes) return 55;
-      if(tree->tree2d[2 * treepos + bit] == 32767) /*not yet filled in*/
+      unsigned num = 1u << (FIRSTBITS - l);
+      for(j = 0; j != num; ++j)
       {
-        if(i + 1 == tree->lengths[n]) /*last bit*/
-        {
-          tree->tree2d[2 * treepos + bit] = n; /*put the current code in it*/
-          treepos = 0;
-        }
-        else
-        {
-          /*put address of the next step in here, first that address has to be found of course
-          (it's just nodefilled + 1)...*/
-          ++nodefilled;
-          /*addresses encoded with numcodes added to it*/
-          tree->tree2d[2 * treepos + bit] = nodefilled + tree->numcodes;
-          treepos = nodefilled;
-        }
+        unsigned index = reverse | (j << l);
+        if(tree->table_len[index] != INVALIDLENGTH) return 55;
+        tree->table_len[index] = (unsigned char)l;
+        tree->table_value[index] = (unsigned short)i;
+      }
+    }
+    else
+    {
+      unsigned index = reverse & mask;
+      unsigned maxlen = tree->table_len[index];
+      unsigned start = tree->table_value[index];
+      unsigned num = 1u << (maxlen - l);
+      for(j = 0; j != num; ++j)
+      {
+        unsigned index2 = start + ((reverse >> FIRSTBITS) | (j << (l - FIRSTBITS)));
+        if(tree->table_len[index2] != INVALIDLENGTH) return 55;
+        tree->table_len[index2] = (unsigned char)l;
+        tree->table_value[index2] = (unsigned short)i;
       }
-      else treepos = tree->tree2d[2 * treepos + bit] - tree->numcodes;
     }
-  }
-
-  for(n = 0; n < tree->numcodes * 2; ++n)
-  {
-    if(tree->tree2d[n] == 32767) tree->tree2d[n] = 0; /*remove possible remaining 32767's*/
   }
 
   return 0;
@@ -640,7 +689,7 @@ static unsigned HuffmanTree_makeFromLengths2(HuffmanTree* tree)
   uivector_cleanup(&blcount);
   uivector_cleanup(&nextcode);
 
-  if(!error) return HuffmanTree_make2DTree(tree);
+  if(!error) return HuffmanTree_makeTable(tree);
   else return error;
 }
 
@@ -936,6 +985,53 @@ static unsigned generateFixedDistanceTree(HuffmanTree* tree)
 
 #ifdef LODEPNG_COMPILE_DECODER
 
+/*
+returns the next bits of the input from bit position bp on, the first one in the least
+significant bit. At least 56 of them are valid; bits past the end of the input read as 0.
+*/
+static unsigned long long peekBits(const unsigned char* in, size_t inlength, size_t bp)
+{
+  size_t p = bp >> 3;
+  unsigned long long result = 0;
+  if(p + 8 <= inlength)
+  {
+    result = (unsigned long long)in[p]
+           | ((unsigned long long)in[p + 1] << 8u) | ((unsigned long long)in[p + 2] << 16u)
+           | ((unsigned long long)in[p + 3] << 24u) | ((unsigned long long)in[p + 4] << 32u)
+           | ((unsigned long long)in[p + 5] << 40u) | ((unsigned long long)in[p + 6] << 48u)
+           | ((unsigned long long)in[p + 7] << 56u);
+  }
+  else
+  {
+    size_t i;
+    for(i = 0; p + i < inlength; ++i) result |= (unsigned long long)in[p + i] << (8u * i);
+  }
+  return result >> (bp & 7u);
+}
+
+/*
+decodes the symbol at the start of bits (as returned by peekBits) with one or two table lookups
+and adds its length to *used. returns the symbol, or (unsigned)(-1) if the bits are not a code
+*/
+static unsigned huffmanDecodeBits(const HuffmanTree* codetree, unsigned long long bits, size_t* used)
+{
+  unsigned index = (unsigned)(bits >> *used) & ((1u << FIRSTBITS) - 1u);
+  unsigned l = codetree->table_len[index];
+  unsigned value = codetree->table_value[index];
+  if(l <= FIRSTBITS)
+  {
+    *used += l;
+    return value;
+  }
+  if(l == INVALIDLENGTH) return (unsigned)(-1);
+  /*long code: look up the bits after the first FIRSTBITS in the second level table*/
+  index = value + ((unsigned)(bits >> (*used + FIRSTBITS)) & ((1u << (l - FIRSTBITS)) - 1u));
+  l = codetree->table_len[index];
+  if(l == INVALIDLENGTH) return (unsigned)(-1);
+  *used += l;
+  return codetree->table_value[index];
+}
+
 /*
 returns the code, or (unsigned)(-1) if error happened
 inbitlength is the length of the complete buffer, in bits (so its byte length times 8)
@@ -943,21 +1039,13 @@ inbitlength is the length of the complete buffer, in bits (so its byte length ti
 static unsigned huffmanDecodeSymbol(const unsigned char* in, size_t* bp,
                                     const HuffmanTree* codetree, size_t inbitlength)
 {
-  unsigned treepos = 0, ct;
-  for(;;)
-  {
-    if(*bp >= inbitlength) return (unsigned)(-1); /*error: end of input memory reached without endcode*/
-    /*
-    decode the symbol from the tree. The "readBitFromStream" code is inlined in
-    the expression below because this is the biggest bottleneck while decoding
-    */
-    ct = codetree->tree2d[(treepos << 1) + READBIT(*bp, in)];
-    ++(*bp);
-    if(ct < codetree->numcodes) return ct; /*the symbol is decoded, return it*/
-    else treepos = ct - codetree->numcodes; /*symbol not yet decoded, instead move tree position*/
-
-    if(treepos >= codetree->numcodes) return (unsigned)(-1); /*error: it appeared outside the codetree*/
-  }
+  size_t used = 0;
+  unsigned code = huffmanDecodeBits(codetree, peekBits(in, inbitlength >> 3, *bp), &used);
+  if(code == (unsigned)(-1)) return code;
+  /*step past the end on running out of input, so that the caller reports error 10*/
+  *bp += used;
+  if(*bp > inbitlength) return (unsigned)(-1);
+  return code;
 }
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -1123,9 +1211,98 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
   return error;
 }
 
+/*
+Receives the output of a streaming inflate (see lodepng_decode_scanlines) in pieces, so that
+the whole decompressed stream never has to be in memory at once.
+*/
+typedef struct InflateSink
+{
+  /*called with decompressed bytes not yet used up; sets *used to how many of them it is done
+  with. The remaining ones are passed again, followed by new data, on the next call.*/
+  unsigned (*consume)(void* data, const unsigned char* bytes, size_t size, size_t* used);
+  void* data;
+  size_t flushsize; /*hand out data whenever this many unused bytes are buffered*/
+  size_t start; /*position in the out buffer of the first byte not used up by consume*/
+  size_t checked; /*position in the out buffer up to which adler was computed*/
+  unsigned adler; /*adler32 of all output so far*/
+} InflateSink;
+
+static unsigned inflateSink_flush(InflateSink* sink, ucvector* out, size_t* pos);
+
+/*
+Feeds a streaming inflate (see lodepng_decode_scanlines) the data of the IDAT chunks of a PNG
+in memory, through a window of fixed size, so that the compressed stream is never gathered in
+one buffer either. The inflater reads the window as its input; it is refilled with the next
+chunk data whenever the bit pointer nears its end.
+*/
+typedef struct InflateSource
+{
+  const unsigned char* chunk; /*next chunk of the PNG to look for IDAT data in, 0 past IEND*/
+  const unsigned char* end; /*end of the PNG*/
+  const unsigned char* data; /*rest of the data of the current IDAT chunk*/
+  size_t remaining; /*bytes left at data*/
+  unsigned char* window; /*the inflater's input*/
+  size_t size; /*bytes of input in the window*/
+  size_t capacity; /*size of the window; at least 65536 + 1024, so a stored block fits*/
+  size_t total; /*bytes of IDAT data read so far*/
+  unsigned char tail[4]; /*the last 4 of them, which hold the adler32 of the stream*/
+} InflateSource;
+
+/*whether the source has IDAT data it has not put in the window yet*/
+static unsigned inflateSource_more(InflateSource* source)
+{
+  while(source->remaining == 0 && source->chunk)
+  {
+    const unsigned char* chunk = source->chunk;
+    size_t length;
+    /*readChunks already checked the chunks; stop where it stopped*/
+    if((size_t)(source->end - chunk) < 12) { source->chunk = 0; break; }
+    length = lodepng_chunk_length(chunk);
+    if(length > 2147483647 || (size_t)(source->end - chunk) - 12 < length) { source->chunk = 0; break; }
+    if(lodepng_chunk_type_equals(chunk, "IEND")) { source->chunk = 0; break; }
+    if(lodepng_chunk_type_equals(chunk, "IDAT"))
+    {
+      source->data = lodepng_chunk_data_const(chunk);
+      source->remaining = length;
+    }
+    source->chunk = lodepng_chunk_next_const(chunk);
+  }
+  return source->remaining != 0;
+}
+
+/*drops the window's bytes before bit pointer bp (moving bp along) and fills it up with more*/
+static void inflateSource_fill(InflateSource* source, size_t* bp)
+{
+  size_t skip = (*bp) >> 3;
+  if(skip > source->size) skip = source->size;
+  memmove(source->window, &source->window[skip], source->size - skip);
+  source->size -= skip;
+  *bp -= skip * 8;
+
+  while(source->size < source->capacity && inflateSource_more(source))
+  {
+    size_t n = source->capacity - source->size;
+    size_t i;
+    if(n > source->remaining) n = source->remaining;
+    memcpy(&source->window[source->size], source->data, n);
+    for(i = n < 4 ? 0 : n - 4; i != n; ++i)
+    {
+      source->tail[0] = source->tail[1];
+      source->tail[1] = source->tail[2];
+      source->tail[2] = source->tail[3];
+      source->tail[3] = source->data[i];
+    }
+    source->data += n;
+    source->remaining -= n;
+    source->size += n;
+    source->total += n;
+  }
+}
+
 /*inflate a block with dynamic of fixed Huffman tree*/
 static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+                                    size_t* pos, size_t inlength, unsigned btype, InflateSink* sink,
+                                    InflateSource* source)
 {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
@@ -1141,9 +1318,33 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll;
+    /*one read covers a whole length/distance pair: at most 15 + 5 + 15 + 13 of the 56 bits*/
+    unsigned long long bits;
+    size_t used = 0;
+    if(sink && *pos - sink->start >= sink->flushsize)
+    {
+      error = inflateSink_flush(sink, out, pos);
+      if(error) break;
+    }
+    /*a symbol with its extra bits takes at most 7 bytes*/
+    if(source && inlength - ((*bp) >> 3) < 64 && inflateSource_more(source))
+    {
+      inflateSource_fill(source, bp);
+      inlength = source->size;
+      inbitlength = inlength * 8;
+    }
+    bits = peekBits(in, inlength, *bp);
+    code_ll = huffmanDecodeBits(&tree_ll, bits, &used);
+    if(*bp + used > inbitlength)
+    {
+      /*ran out of input: step past its end so that error 10 is reported below*/
+      *bp += used;
+      code_ll = (unsigned)(-1);
+    }
     if(code_ll <= 255) /*literal symbol*/
     {
+      *bp += used;
       /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
       if(!ucvector_resize(out, (*pos) + 1)) ERROR_BREAK(83 /*alloc fail*/);
       out->data[*pos] = (unsigned char)code_ll;
@@ -1160,18 +1361,19 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       /*part 2: get extra bits and add the value of that to length*/
       numextrabits_l = LENGTHEXTRA[code_ll - FIRST_LENGTH_CODE_INDEX];
-      if((*bp + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      length += readBitsFromStream(bp, in, numextrabits_l);
+      if((*bp + used + numextrabits_l) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+      length += (unsigned)(bits >> used) & ((1u << numextrabits_l) - 1u);
+      used += numextrabits_l;
 
       /*part 3: get distance code*/
-      code_d = huffmanDecodeSymbol(in, bp, &tree_d, inbitlength);
+      code_d = huffmanDecodeBits(&tree_d, bits, &used);
+      if(code_d != (unsigned)(-1) && *bp + used > inbitlength) code_d = (unsigned)(-1);
       if(code_d > 29)
       {
-        if(code_d == (unsigned)(-1)) /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
+        if(code_d == (unsigned)(-1)) /*huffmanDecodeBits returns (unsigned)(-1) in case of error*/
         {
-          /*return error code 10 or 11 depending on the situation that happened in huffmanDecodeSymbol
-          (10=no endcode, 11=wrong jump outside of tree)*/
-          error = (*bp) > inlength * 8 ? 10 : 11;
+          /*return error code 10 or 11 depending on whether the input ran out or the code is invalid*/
+          error = (*bp + used) > inbitlength ? 10 : 11;
         }
         else error = 18; /*error: invalid distance code (30-31 are never used)*/
         break;
@@ -1180,8 +1382,10 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 
       /*part 4: get extra bits from distance*/
       numextrabits_d = DISTANCEEXTRA[code_d];
-      if((*bp + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
-      distance += readBitsFromStream(bp, in, numextrabits_d);
+      if((*bp + used + numextrabits_d) > inbitlength) ERROR_BREAK(51); /*error, bit pointer will jump past memory*/
+      distance += (unsigned)(bits >> used) & ((1u << numextrabits_d) - 1u);
+      used += numextrabits_d;
+      *bp += used;
 
       /*part 5: fill in all the out[n] values based on the length and dist*/
       start = (*pos);
@@ -1201,6 +1405,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
     }
     else if(code_ll == 256)
     {
+      *bp += used;
       break; /*end code, break the loop*/
     }
     else /*if(code == (unsigned)(-1))*/ /*huffmanDecodeSymbol returns (unsigned)(-1) in case of error*/
@@ -1221,7 +1426,7 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
 static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, size_t* bp, size_t* pos, size_t inlength)
 {
   size_t p;
-  unsigned LEN, NLEN, n, error = 0;
+  unsigned LEN, NLEN, error = 0;
 
   /*go to first boundary of byte*/
   while(((*bp) & 0x7) != 0) ++(*bp);
@@ -1239,7 +1444,9 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
 
   /*read the literal data: LEN bytes are now stored in the out buffer*/
   if(p + LEN > inlength) return 23; /*error: reading outside of in buffer*/
-  for(n = 0; n < LEN; ++n) out->data[(*pos)++] = in[p++];
+  if(LEN != 0) memcpy(out->data + *pos, in + p, LEN);
+  *pos += LEN;
+  p += LEN;
 
   (*bp) = p * 8;
 
@@ -1248,7 +1455,8 @@ static unsigned inflateNoCompression(ucvector* out, const unsigned char* in, siz
 
 static unsigned lodepng_inflatev(ucvector* out,
                                  const unsigned char* in, size_t insize,
-                                 const LodePNGDecompressSettings* settings)
+                                 const LodePNGDecompressSettings* settings, InflateSink* sink,
+                                 InflateSource* source)
 {
   /*bit pointer in the "in" data, current byte is bp >> 3, current bit is bp & 0x7 (from lsb to msb of the byte)*/
   size_t bp = 0;
@@ -1261,6 +1469,12 @@ static unsigned lodepng_inflatev(ucvector* out,
   while(!BFINAL)
   {
     unsigned BTYPE;
+    /*a stored block or the code lengths of a dynamic one must be in the window in full*/
+    if(source && insize - (bp >> 3) < 65536 + 1024 && inflateSource_more(source))
+    {
+      inflateSource_fill(source, &bp);
+      insize = source->size;
+    }
     if(bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
     BFINAL = readBitFromStream(&bp, in);
     BTYPE = 1u * readBitFromStream(&bp, in);
@@ -1268,11 +1482,16 @@ static unsigned lodepng_inflatev(ucvector* out,
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
     else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE, sink, source); /*compression, BTYPE 01 or 10*/
+    if(source) insize = source->size;
 
+    if(!error && sink && pos - sink->start >= sink->flushsize) error = inflateSink_flush(sink, out, &pos);
     if(error) return error;
   }
 
+  /*hand out whatever is left*/
+  if(sink) error = inflateSink_flush(sink, out, &pos);
+
   return error;
 }
 
@@ -1283,7 +1502,7 @@ unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
   unsigned error;
   ucvector v;
   ucvector_init_buffer(&v, *out, *outsize);
-  error = lodepng_inflatev(&v, in, insize, settings);
+  error = lodepng_inflatev(&v, in, insize, settings, 0, 0);
   *out = v.data;
   *outsize = v.size;
   return error;
@@ -1458,6 +1677,48 @@ static void updateHashChain(Hash* hash, size_t wpos, unsigned hashval, unsigned
   hash->headz[numzeros] = (int)wpos;
 }
 
+/*
+LZ77 for windows of at most 4 bytes. With so few candidate distances it is faster
+to compare each of them directly than to maintain the hash chains: a window of 1
+gives plain run-length encoding and a window of 4 also catches repeated RGBA pixels.
+*/
+static unsigned encodeShortDistances(uivector* out, const unsigned char* in, size_t inpos, size_t insize,
+                                     unsigned windowsize, unsigned minmatch)
+{
+  size_t pos = inpos;
+  if(minmatch < 3) minmatch = 3;
+  while(pos < insize)
+  {
+    size_t length = 0, offset = 0, distance;
+    size_t maxlength = insize - pos;
+    if(maxlength > MAX_SUPPORTED_DEFLATE_LENGTH) maxlength = MAX_SUPPORTED_DEFLATE_LENGTH;
+    for(distance = 1; distance <= windowsize && distance <= pos; ++distance)
+    {
+      const unsigned char* backptr = &in[pos - distance];
+      const unsigned char* foreptr = &in[pos];
+      size_t current_length = 0;
+      while(current_length != maxlength && backptr[current_length] == foreptr[current_length]) ++current_length;
+      if(current_length > length)
+      {
+        length = current_length;
+        offset = distance;
+      }
+    }
+
+    if(length >= minmatch)
+    {
+      addLengthDistance(out, length, offset);
+      pos += length;
+    }
+    else
+    {
+      if(!uivector_push_back(out, in[pos])) return 83; /*alloc fail*/
+      ++pos;
+    }
+  }
+  return 0;
+}
+
 /*
 LZ77-encode the data. Return value is error code. The input are raw bytes, the output
 is in the form of unsigned integers with codes representing for example literal bytes, or
@@ -1492,6 +1753,7 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
   if(windowsize == 0 || windowsize > 32768) return 60; /*error: windowsize smaller/larger than allowed*/
   if((windowsize & (windowsize - 1)) != 0) return 90; /*error: must be power of two*/
+  if(windowsize <= 4) return encodeShortDistances(out, in, inpos, insize, windowsize, minmatch);
 
   if(nicematch > MAX_SUPPORTED_DEFLATE_LENGTH) nicematch = MAX_SUPPORTED_DEFLATE_LENGTH;
 
@@ -1646,19 +1908,20 @@ static unsigned encodeLZ77(uivector* out, Hash* hash,
 
 /* /////////////////////////////////////////////////////////////////////////// */
 
-static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize)
+static unsigned deflateNoCompression(ucvector* out, const unsigned char* data, size_t datasize, unsigned final)
 {
   /*non compressed deflate block data: 1 bit BFINAL,2 bits BTYPE,(5 bits): it jumps to start of next byte,
   2 bytes LEN, 2 bytes NLEN, LEN bytes literal DATA*/
 
   size_t i, j, numdeflateblocks = (datasize + 65534) / 65535;
   unsigned datapos = 0;
+  if(numdeflateblocks == 0 && final) numdeflateblocks = 1; /*the stream still needs its final block*/
   for(i = 0; i != numdeflateblocks; ++i)
   {
     unsigned BFINAL, BTYPE, LEN, NLEN;
     unsigned char firstbyte;
 
-    BFINAL = (i == numdeflateblocks - 1);
+    BFINAL = final && (i == numdeflateblocks - 1);
     BTYPE = 0;
 
     firstbyte = (unsigned char)(BFINAL + ((BTYPE & 1) << 1) + ((BTYPE & 2) << 1));
@@ -2010,47 +2273,91 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+/*Enters the last windowsize bytes before pos into the hash chains, as if they had just been
+encoded, so that the data after pos can refer back to them.*/
+static void hash_prime(Hash* hash, const unsigned char* in, size_t pos, size_t insize, unsigned windowsize)
+{
+  size_t i = pos > windowsize ? pos - windowsize : 0;
+  unsigned numzeros = 0;
+  for(; i < pos; ++i)
+  {
+    unsigned hashval = getHash(in, insize, i);
+    if(hashval == 0)
+    {
+      if(numzeros == 0) numzeros = countZeros(in, insize, i);
+      else if(i + numzeros > insize || in[i + numzeros - 1] != 0) --numzeros;
+    }
+    else
+    {
+      numzeros = 0;
+    }
+    updateHashChain(hash, i & (windowsize - 1), hashval, (unsigned short)numzeros);
+  }
+}
+
+/*Deflates in[dictsize..insize-1], with in[0..dictsize-1] as already encoded history. Unless final is
+set, the output ends with an empty stored block so that it stops on a byte boundary.*/
+static unsigned deflateChunkv(ucvector* out, const unsigned char* in, size_t dictsize, size_t insize,
+                              unsigned final, const LodePNGCompressSettings* settings)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
+  size_t datasize = insize - dictsize;
   size_t bp = 0; /*the bit pointer*/
   Hash hash;
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
-  else if(settings->btype == 1) blocksize = insize;
+  else if(settings->btype == 0) return deflateNoCompression(out, &in[dictsize], datasize, final);
+  else if(settings->btype == 1) blocksize = datasize;
   else /*if(settings->btype == 2)*/
   {
     /*on PNGs, deflate blocks of 65-262k seem to give most dense encoding*/
-    blocksize = insize / 8 + 8;
+    blocksize = datasize / 8 + 8;
     if(blocksize < 65536) blocksize = 65536;
     if(blocksize > 262144) blocksize = 262144;
   }
 
-  numdeflateblocks = (insize + blocksize - 1) / blocksize;
-  if(numdeflateblocks == 0) numdeflateblocks = 1;
-
-  error = hash_init(&hash, settings->windowsize);
-  if(error) return error;
+  numdeflateblocks = blocksize == 0 ? 0 : (datasize + blocksize - 1) / blocksize;
+  if(numdeflateblocks == 0 && final) numdeflateblocks = 1;
 
-  for(i = 0; i != numdeflateblocks && !error; ++i)
+  if(numdeflateblocks != 0)
   {
-    unsigned final = (i == numdeflateblocks - 1);
-    size_t start = i * blocksize;
-    size_t end = start + blocksize;
-    if(end > insize) end = insize;
+    error = hash_init(&hash, settings->windowsize);
+    if(error) return error;
+    if(dictsize != 0 && settings->windowsize > 4) hash_prime(&hash, in, dictsize, insize, settings->windowsize);
+
+    for(i = 0; i != numdeflateblocks && !error; ++i)
+    {
+      size_t start = dictsize + i * blocksize;
+      size_t end = start + blocksize;
+      if(end > insize) end = insize;
+
+      if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final && i == numdeflateblocks - 1);
+      else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final && i == numdeflateblocks - 1);
+    }
 
-    if(settings->btype == 1) error = deflateFixed(out, &bp, &hash, in, start, end, settings, final);
-    else if(settings->btype == 2) error = deflateDynamic(out, &bp, &hash, in, start, end, settings, final);
+    hash_cleanup(&hash);
   }
 
-  hash_cleanup(&hash);
+  if(!error && !final)
+  {
+    /*sync flush: an empty non-final stored block, whose header is padded to a byte boundary*/
+    addBitsToStream(&bp, out, 0, 3);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 0);
+    ucvector_push_back(out, 255);
+    ucvector_push_back(out, 255);
+  }
 
   return error;
 }
 
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings)
+{
+  return deflateChunkv(out, in, 0, insize, 1, settings);
+}
+
 unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings)
@@ -2064,6 +2371,20 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
   return error;
 }
 
+unsigned lodepng_deflate_chunk(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t dictsize, size_t insize,
+                               unsigned final, const LodePNGCompressSettings* settings)
+{
+  unsigned error;
+  ucvector v;
+  if(dictsize > insize) return 105; /*dictionary larger than the input*/
+  ucvector_init_buffer(&v, *out, *outsize);
+  error = deflateChunkv(&v, in, dictsize, insize, final, settings);
+  *out = v.data;
+  *outsize = v.size;
+  return error;
+}
+
 static unsigned deflate(unsigned char** out, size_t* outsize,
                         const unsigned char* in, size_t insize,
                         const LodePNGCompressSettings* settings)
@@ -2113,16 +2434,76 @@ static unsigned adler32(const unsigned char* data, unsigned len)
   return update_adler32(1L, data, len);
 }
 
+unsigned lodepng_adler32(const unsigned char* data, size_t len)
+{
+  unsigned adler = 1;
+  while(len > 0)
+  {
+    unsigned amount = len > 1073741824u ? 1073741824u : (unsigned)len;
+    adler = update_adler32(adler, data, amount);
+    data += amount;
+    len -= amount;
+  }
+  return adler;
+}
+
+unsigned lodepng_adler32_combine(unsigned adler1, unsigned adler2, size_t len2)
+{
+  /*after len2 more bytes, every byte of A has been added to s2 len2 more times through s1*/
+  static const unsigned BASE = 65521;
+  unsigned rem = (unsigned)(len2 % BASE);
+  unsigned s1 = adler1 & 0xffff;
+  unsigned s2 = (rem * s1) % BASE;
+  s1 += (adler2 & 0xffff) + BASE - 1;
+  s2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + BASE - rem;
+  if(s1 >= BASE) s1 -= BASE;
+  if(s1 >= BASE) s1 -= BASE;
+  if(s2 >= (BASE << 1)) s2 -= (BASE << 1);
+  if(s2 >= BASE) s2 -= BASE;
+  return (s2 << 16) | s1;
+}
+
+#ifdef LODEPNG_COMPILE_DECODER
+/*Hands the buffered output to the sink, then drops all of it that neither the sink nor later
+length/distance pairs (which reach back at most 32768 bytes) still need.*/
+static unsigned inflateSink_flush(InflateSink* sink, ucvector* out, size_t* pos)
+{
+  static const size_t WINDOW = 32768;
+  size_t used = 0;
+  size_t keep;
+  unsigned error;
+
+  sink->adler = update_adler32(sink->adler, &out->data[sink->checked], (unsigned)(*pos - sink->checked));
+  sink->checked = *pos;
+
+  error = sink->consume(sink->data, &out->data[sink->start], *pos - sink->start, &used);
+  if(error) return error;
+  sink->start += used;
+
+  keep = *pos - sink->start;
+  if(keep < WINDOW) keep = (*pos < WINDOW) ? *pos : WINDOW;
+  if(keep < *pos)
+  {
+    size_t shift = *pos - keep;
+    memmove(out->data, &out->data[shift], keep);
+    *pos -= shift;
+    sink->start -= shift;
+    sink->checked -= shift;
+    out->size = *pos;
+  }
+  return 0;
+}
+#endif /*LODEPNG_COMPILE_DECODER*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* / Zlib                                                                   / */
 /* ////////////////////////////////////////////////////////////////////////// */
 
 #ifdef LODEPNG_COMPILE_DECODER
 
-unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
-                                 size_t insize, const LodePNGDecompressSettings* settings)
+/*Checks the 2-byte zlib header at the start of in*/
+static unsigned zlib_check_header(const unsigned char* in, size_t insize)
 {
-  unsigned error = 0;
   unsigned CM, CINFO, FDICT;
 
   if(insize < 2) return 53; /*error, size of zlib data too small*/
@@ -2151,6 +2532,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
     return 26;
   }
 
+  return 0;
+}
+
+unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const unsigned char* in,
+                                 size_t insize, const LodePNGDecompressSettings* settings)
+{
+  unsigned error = zlib_check_header(in, insize);
+  if(error) return error;
+
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
@@ -4059,6 +4449,297 @@ static unsigned char paethPredictor(short a, short b, short c)
   else return (unsigned char)a;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / SIMD scanline filters                                                  / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+/*
+Vectorized filtering and unfiltering of scanlines with 4 bytes per pixel (8-bit RGBA, which
+is what cs225::PNG reads and writes) on x86, picked at runtime from what the CPU supports.
+Setting the CS225_SIMD environment variable to "none", "sse2" or "ssse3" caps the instruction
+set, e.g. to compare against the scalar loops. Every path gives the same bytes as those loops.
+
+Filtering, and unfiltering Up, has no dependency between pixels and does 16 or 32 bytes at a
+time. Unfiltering Sub, Average and Paeth needs the pixel just reconstructed: Sub uses a prefix
+sum over the 4 pixels of a register, Average and Paeth do the 4 channels of a pixel at once.
+*/
+#if defined(__cplusplus) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LODEPNG_SIMD_X86
+
+#include <immintrin.h>
+#include <string.h>
+
+#define SIMD_NONE 0
+#define SIMD_SSE2 1
+#define SIMD_SSSE3 2
+#define SIMD_AVX2 3
+
+static int detectSimdLevel(void)
+{
+  int level = SIMD_NONE;
+  const char* cap = getenv("CS225_SIMD");
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse2")) level = SIMD_SSE2;
+  if(__builtin_cpu_supports("ssse3")) level = SIMD_SSSE3;
+  if(__builtin_cpu_supports("avx2")) level = SIMD_AVX2;
+  if(cap)
+  {
+    if(strcmp(cap, "none") == 0) level = SIMD_NONE;
+    else if(strcmp(cap, "sse2") == 0 && level > SIMD_SSE2) level = SIMD_SSE2;
+    else if((strcmp(cap, "ssse3") == 0 || strcmp(cap, "sse4.1") == 0) && level > SIMD_SSSE3) level = SIMD_SSSE3;
+  }
+  return level;
+}
+
+/*highest usable SIMD_ level, detected once*/
+static int simdLevel(void)
+{
+  static const int level = detectSimdLevel();
+  return level;
+}
+
+__attribute__((target("sse2")))
+static inline __m128i load4(const unsigned char* p)
+{
+  int v;
+  memcpy(&v, p, 4);
+  return _mm_cvtsi32_si128(v);
+}
+
+__attribute__((target("sse2")))
+static inline void store4(unsigned char* p, __m128i x)
+{
+  int v = _mm_cvtsi128_si32(x);
+  memcpy(p, &v, 4);
+}
+
+/*floor((a + b) / 2) per byte: pavgb rounds up, so subtract the bit lost when a + b is odd*/
+__attribute__((target("sse2")))
+static inline __m128i average8(__m128i a, __m128i b)
+{
+  return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i average8AVX2(__m256i a, __m256i b)
+{
+  return _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1)));
+}
+
+/*paethPredictor on 16-bit lanes: a if pa is smallest, else b if pb is, else c*/
+__attribute__((target("ssse3")))
+static inline __m128i paeth16(__m128i a, __m128i b, __m128i c)
+{
+  __m128i p = _mm_sub_epi16(b, c);
+  __m128i q = _mm_sub_epi16(a, c);
+  __m128i pa = _mm_abs_epi16(p);
+  __m128i pb = _mm_abs_epi16(q);
+  __m128i pc = _mm_abs_epi16(_mm_add_epi16(p, q));
+  __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+  __m128i useb = _mm_cmpeq_epi16(pb, smallest);
+  __m128i usea = _mm_cmpeq_epi16(pa, smallest);
+  __m128i pred = _mm_or_si128(_mm_and_si128(useb, b), _mm_andnot_si128(useb, c));
+  return _mm_or_si128(_mm_and_si128(usea, a), _mm_andnot_si128(usea, pred));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i paeth16AVX2(__m256i a, __m256i b, __m256i c)
+{
+  __m256i p = _mm256_sub_epi16(b, c);
+  __m256i q = _mm256_sub_epi16(a, c);
+  __m256i pa = _mm256_abs_epi16(p);
+  __m256i pb = _mm256_abs_epi16(q);
+  __m256i pc = _mm256_abs_epi16(_mm256_add_epi16(p, q));
+  __m256i smallest = _mm256_min_epi16(pc, _mm256_min_epi16(pa, pb));
+  __m256i pred = _mm256_blendv_epi8(c, b, _mm256_cmpeq_epi16(pb, smallest));
+  return _mm256_blendv_epi8(pred, a, _mm256_cmpeq_epi16(pa, smallest));
+}
+
+#ifdef LODEPNG_COMPILE_DECODER
+__attribute__((target("sse2")))
+static void unfilterUpSSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                           size_t length)
+{
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&precon[i]);
+    _mm_storeu_si128((__m128i*)&recon[i], _mm_add_epi8(x, b));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+__attribute__((target("avx2")))
+static void unfilterUpAVX2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                           size_t length)
+{
+  size_t i = 0;
+  for(; i + 32 <= length; i += 32)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*)&scanline[i]);
+    __m256i b = _mm256_loadu_si256((const __m256i*)&precon[i]);
+    _mm256_storeu_si256((__m256i*)&recon[i], _mm256_add_epi8(x, b));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + precon[i];
+}
+
+__attribute__((target("sse2")))
+static void unfilterSub4SSE2(unsigned char* recon, const unsigned char* scanline, size_t length)
+{
+  size_t i = 0;
+  __m128i a = _mm_setzero_si128(); /*the previous pixel, in all 4 lanes*/
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi8(x, a);
+    _mm_storeu_si128((__m128i*)&recon[i], x);
+    a = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  for(; i != length; ++i) recon[i] = scanline[i] + (i >= 4 ? recon[i - 4] : 0);
+}
+
+__attribute__((target("sse2")))
+static void unfilterAverage4SSE2(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                 size_t length)
+{
+  size_t i;
+  __m128i a = _mm_setzero_si128();
+  for(i = 0; i != length; i += 4)
+  {
+    a = _mm_add_epi8(load4(&scanline[i]), average8(a, load4(&precon[i])));
+    store4(&recon[i], a);
+  }
+}
+
+__attribute__((target("ssse3")))
+static void unfilterPaeth4SSSE3(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                size_t length)
+{
+  /*channels widened to 16 bits: a is the pixel to the left, b the one above, c the one above left*/
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero, c = zero;
+  size_t i;
+  for(i = 0; i != length; i += 4)
+  {
+    __m128i b = _mm_unpacklo_epi8(load4(&precon[i]), zero);
+    __m128i pred = paeth16(a, b, c);
+    __m128i x = _mm_add_epi8(load4(&scanline[i]), _mm_packus_epi16(pred, pred));
+    store4(&recon[i], x);
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+}
+
+/*unfilters a 4 bytes per pixel scanline with SIMD. returns 0 if it left the scanline to the scalar code*/
+static int unfilterScanline4SIMD(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+                                 unsigned char filterType, size_t length)
+{
+  int level = simdLevel();
+  if(level == SIMD_NONE || (length & 3) != 0) return 0;
+  switch(filterType)
+  {
+    case 1: unfilterSub4SSE2(recon, scanline, length); return 1;
+    case 2:
+      if(!precon) return 0;
+      if(level >= SIMD_AVX2) unfilterUpAVX2(recon, scanline, precon, length);
+      else unfilterUpSSE2(recon, scanline, precon, length);
+      return 1;
+    case 3:
+      if(!precon) return 0;
+      unfilterAverage4SSE2(recon, scanline, precon, length);
+      return 1;
+    case 4:
+      if(!precon) { unfilterSub4SSE2(recon, scanline, length); return 1; }
+      if(level < SIMD_SSSE3) return 0;
+      unfilterPaeth4SSSE3(recon, scanline, precon, length);
+      return 1;
+    default: return 0;
+  }
+}
+#endif /*LODEPNG_COMPILE_DECODER*/
+
+#ifdef LODEPNG_COMPILE_ENCODER
+/*
+filter types 1-4 for i >= 4 (the first pixel is left to the caller), with prevline given. Each
+block of output only depends on the input, so this runs 16 bytes at a time.
+*/
+__attribute__((target("ssse3")))
+static void filterScanline4SSSE3(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+                                 size_t length, unsigned char filterType, size_t* done)
+{
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 4;
+  for(; i + 16 <= length; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&scanline[i]);
+    __m128i a = _mm_loadu_si128((const __m128i*)&scanline[i - 4]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&prevline[i]);
+    __m128i pred;
+    if(filterType == 1) pred = a;
+    else if(filterType == 2) pred = b;
+    else if(filterType == 3) pred = average8(a, b);
+    else
+    {
+      __m128i c = _mm_loadu_si128((const __m128i*)&prevline[i - 4]);
+      __m128i lo = paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+      __m128i hi = paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+      pred = _mm_packus_epi16(lo, hi);
+    }
+    _mm_storeu_si128((__m128i*)&out[i], _mm_sub_epi8(x, pred));
+  }
+  *done = i;
+}
+
+__attribute__((target("avx2")))
+static void filterScanline4AVX2(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+                                size_t length, unsigned char filterType, size_t* done)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 4;
+  for(; i + 32 <= length; i += 32)
+  {
+    __m256i x = _mm256_loadu_si256((const __m256i*)&scanline[i]);
+    __m256i a = _mm256_loadu_si256((const __m256i*)&scanline[i - 4]);
+    __m256i b = _mm256_loadu_si256((const __m256i*)&prevline[i]);
+    __m256i pred;
+    if(filterType == 1) pred = a;
+    else if(filterType == 2) pred = b;
+    else if(filterType == 3) pred = average8AVX2(a, b);
+    else
+    {
+      /*unpack and pack both work within 128-bit lanes, so the bytes come back in order*/
+      __m256i c = _mm256_loadu_si256((const __m256i*)&prevline[i - 4]);
+      __m256i lo = paeth16AVX2(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero),
+                               _mm256_unpacklo_epi8(c, zero));
+      __m256i hi = paeth16AVX2(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero),
+                               _mm256_unpackhi_epi8(c, zero));
+      pred = _mm256_packus_epi16(lo, hi);
+    }
+    _mm256_storeu_si256((__m256i*)&out[i], _mm256_sub_epi8(x, pred));
+  }
+  *done = i;
+}
+
+/*
+filters bytes [4, *done) of a 4 bytes per pixel scanline with SIMD, for filter types 1-4 when there
+is a previous line (the first scanline only needs cheap or no filtering). the caller does the rest.
+*/
+static void filterScanline4SIMD(unsigned char* out, const unsigned char* scanline, const unsigned char* prevline,
+                                size_t length, unsigned char filterType, size_t* done)
+{
+  int level = simdLevel();
+  *done = 4;
+  if(!prevline || filterType < 1 || filterType > 4 || length < 4) return;
+  if(level >= SIMD_AVX2) filterScanline4AVX2(out, scanline, prevline, length, filterType, done);
+  else if(level >= SIMD_SSSE3) filterScanline4SSSE3(out, scanline, prevline, length, filterType, done);
+}
+#endif /*LODEPNG_COMPILE_ENCODER*/
+
+#endif /*LODEPNG_SIMD_X86*/
+
 /*shared values used by multiple Adam7 related functions*/
 
 static const unsigned ADAM7_IX[7] = { 0, 4, 0, 2, 0, 1, 0 }; /*x start values*/
@@ -4195,6 +4876,9 @@ static unsigned unfilterScanline(unsigned char* recon, const unsigned char* scan
   */
 
   size_t i;
+#ifdef LODEPNG_SIMD_X86
+  if(bytewidth == 4 && unfilterScanline4SIMD(recon, scanline, precon, filterType, length)) return 0;
+#endif /*LODEPNG_SIMD_X86*/
   switch(filterType)
   {
     case 0:
@@ -4822,17 +5506,14 @@ static unsigned readChunk_iCCP(LodePNGInfo* info, const LodePNGDecompressSetting
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*Reads the header and all chunks of the PNG, appending the contents of the IDAT chunks to idat
+unless it is 0*/
+static void readChunks(unsigned* w, unsigned* h, LodePNGState* state,
+                       const unsigned char* in, size_t insize, ucvector* idat)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
-  size_t predict;
-  size_t outsize = 0;
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4840,9 +5521,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
 
@@ -4851,7 +5529,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     CERROR_RETURN(state->error, 92); /*overflow possible due to amount of pixels*/
   }
 
-  ucvector_init(&idat);
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4889,11 +5566,14 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT"))
     {
-      size_t oldsize = idat.size;
+      size_t oldsize = idat ? idat->size : 0;
       size_t newsize;
       if(lodepng_addofl(oldsize, chunkLength, &newsize)) CERROR_BREAK(state->error, 95);
-      if(!ucvector_resize(&idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i != chunkLength; ++i) idat.data[oldsize + i] = data[i];
+      if(idat)
+      {
+        if(!ucvector_resize(idat, newsize)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+        for(i = 0; i != chunkLength; ++i) idat->data[oldsize + i] = data[i];
+      }
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -5011,6 +5691,28 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  size_t i;
+  ucvector idat; /*the data from idat chunks*/
+  ucvector scanlines;
+  size_t predict;
+  size_t outsize = 0;
+
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  ucvector_init(&idat);
+  readChunks(w, h, state, in, insize, &idat);
+  if(state->error)
+  {
+    ucvector_cleanup(&idat);
+    return;
+  }
 
   ucvector_init(&scanlines);
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
@@ -5100,6 +5802,189 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
   return state->error;
 }
 
+/*State of lodepng_decode_scanlines: turns inflated scanlines into rows for the callback*/
+typedef struct ScanlineStream
+{
+  unsigned w, h;
+  unsigned y; /*next row to unfilter*/
+  size_t linebytes; /*bytes per scanline in the PNG color mode, excluding the filter type byte*/
+  size_t bytewidth; /*bytes per pixel used by the filters, at least 1*/
+  unsigned char* line; /*the row being unfiltered*/
+  unsigned char* prevline; /*the previous unfiltered row*/
+  unsigned char* rows; /*rows converted to the raw color mode, waiting for the callback*/
+  size_t rawlinebytes; /*bytes per row in the raw color mode*/
+  unsigned maxrows; /*capacity of rows*/
+  const LodePNGColorMode* mode_in;
+  const LodePNGColorMode* mode_out;
+  unsigned convert; /*whether the rows need color conversion*/
+  LodePNGScanlineCallback callback;
+  void* user;
+} ScanlineStream;
+
+static unsigned scanlineStream_consume(void* data, const unsigned char* bytes, size_t size, size_t* used)
+{
+  ScanlineStream* stream = (ScanlineStream*)data;
+  unsigned count = 0;
+  unsigned error = 0;
+
+  *used = 0;
+  while(!error && stream->y < stream->h && size - *used >= stream->linebytes + 1)
+  {
+    const unsigned char* scanline = &bytes[*used];
+    unsigned char* row = &stream->rows[count * stream->rawlinebytes];
+    unsigned char* temp;
+
+    error = unfilterScanline(stream->line, &scanline[1], stream->y ? stream->prevline : 0,
+                             stream->bytewidth, scanline[0], stream->linebytes);
+    if(error) break;
+    if(stream->convert) error = lodepng_convert(row, stream->line, stream->mode_out, stream->mode_in, stream->w, 1);
+    else memcpy(row, stream->line, stream->linebytes);
+    if(error) break;
+
+    temp = stream->prevline;
+    stream->prevline = stream->line;
+    stream->line = temp;
+    *used += stream->linebytes + 1;
+    ++stream->y;
+
+    if(++count == stream->maxrows)
+    {
+      error = stream->callback(stream->user, stream->y - count, count, stream->rows);
+      count = 0;
+    }
+  }
+
+  if(!error && count) error = stream->callback(stream->user, stream->y - count, count, stream->rows);
+  if(!error && stream->y == stream->h && *used != size) error = 91; /*more data than the image needs*/
+  return error;
+}
+
+/*Decodes the whole image with lodepng_decode and hands it to the callback in one go*/
+static unsigned decodeScanlinesWhole(unsigned* w, unsigned* h, LodePNGState* state,
+                                     const unsigned char* in, size_t insize,
+                                     LodePNGScanlineCallback callback, void* user)
+{
+  unsigned char* image = 0;
+  unsigned error = lodepng_decode(&image, w, h, state, in, insize);
+  if(!error && *h > 0) error = callback(user, 0, *h, image);
+  lodepng_free(image);
+  return error;
+}
+
+unsigned lodepng_decode_scanlines(unsigned* w, unsigned* h, LodePNGState* state,
+                                  const unsigned char* in, size_t insize,
+                                  LodePNGScanlineCallback callback, void* user)
+{
+  const LodePNGDecompressSettings* zlibsettings = &state->decoder.zlibsettings;
+  InflateSource source;
+  size_t bp = 0;
+  ucvector window;
+  InflateSink sink;
+  ScanlineStream stream;
+  unsigned bpp;
+  size_t rowbytes;
+
+  state->error = lodepng_inspect(w, h, state, in, insize);
+  if(state->error) return state->error;
+
+  /*only the built-in inflate can stream, and Adam7 passes do not map to output rows*/
+  if(state->info_png.interlace_method != 0 || zlibsettings->custom_zlib || zlibsettings->custom_inflate)
+  {
+    return decodeScanlinesWhole(w, h, state, in, insize, callback, user);
+  }
+
+  /*the IDAT data is read in place, as the inflater gets to it*/
+  readChunks(w, h, state, in, insize, 0);
+
+  stream.convert = state->decoder.color_convert
+                   && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color);
+  if(!state->error && !state->decoder.color_convert)
+  {
+    state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+  }
+  if(!state->error && stream.convert
+     && !(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+     && !(state->info_raw.bitdepth == 8))
+  {
+    state->error = 56; /*unsupported color mode conversion*/
+  }
+  if(state->error) return state->error;
+
+  source.chunk = &in[33];
+  source.end = &in[insize];
+  source.data = 0;
+  source.remaining = 0;
+  source.capacity = 131072;
+  source.size = 0;
+  source.total = 0;
+  memset(source.tail, 0, sizeof(source.tail));
+  source.window = (unsigned char*)lodepng_malloc(source.capacity);
+  if(!source.window) return state->error = 83; /*alloc fail*/
+  inflateSource_fill(&source, &bp);
+  state->error = zlib_check_header(source.window, source.size);
+  if(state->error)
+  {
+    lodepng_free(source.window);
+    return state->error;
+  }
+  bp = 16; /*past the zlib header*/
+
+  bpp = lodepng_get_bpp(&state->info_png.color);
+  stream.w = *w;
+  stream.h = *h;
+  stream.y = 0;
+  stream.linebytes = lodepng_get_raw_size_idat(*w, 1, &state->info_png.color) - 1;
+  stream.bytewidth = (bpp + 7) / 8;
+  stream.rawlinebytes = lodepng_get_raw_size(*w, 1, &state->info_raw);
+  stream.mode_in = &state->info_png.color;
+  stream.mode_out = &state->info_raw;
+  stream.callback = callback;
+  stream.user = user;
+
+  /*hand out roughly 256K of rows at a time*/
+  rowbytes = stream.rawlinebytes > stream.linebytes ? stream.rawlinebytes : stream.linebytes;
+  stream.maxrows = (unsigned)(262144 / (rowbytes + 1)) + 1;
+  if(stream.maxrows > *h) stream.maxrows = *h;
+  stream.line = (unsigned char*)lodepng_malloc(stream.linebytes);
+  stream.prevline = (unsigned char*)lodepng_malloc(stream.linebytes);
+  stream.rows = (unsigned char*)lodepng_malloc(stream.maxrows * stream.rawlinebytes);
+
+  sink.consume = scanlineStream_consume;
+  sink.data = &stream;
+  sink.flushsize = 2 * (stream.linebytes + 1);
+  if(sink.flushsize < 262144) sink.flushsize = 262144;
+  sink.start = 0;
+  sink.checked = 0;
+  sink.adler = 1;
+
+  ucvector_init(&window);
+  if(!stream.line || !stream.prevline || !stream.rows) state->error = 83; /*alloc fail*/
+  else
+  {
+    inflateSource_fill(&source, &bp);
+    state->error = lodepng_inflatev(&window, source.window, source.size, zlibsettings, &sink, &source);
+  }
+
+  if(!state->error && stream.y != stream.h) state->error = 91; /*decompressed size doesn't match prediction*/
+  if(!state->error && !zlibsettings->ignore_adler32)
+  {
+    /*the adler32 is the last 4 bytes of all the IDAT data, after whatever the inflater left*/
+    while(inflateSource_more(&source))
+    {
+      bp = source.size * 8;
+      inflateSource_fill(&source, &bp);
+    }
+    if(source.total < 6 || sink.adler != lodepng_read32bitInt(source.tail)) state->error = 58;
+  }
+
+  ucvector_cleanup(&window);
+  lodepng_free(source.window);
+  lodepng_free(stream.line);
+  lodepng_free(stream.prevline);
+  lodepng_free(stream.rows);
+  return state->error;
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth)
 {
@@ -5549,6 +6434,10 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
                            size_t length, size_t bytewidth, unsigned char filterType)
 {
   size_t i;
+  size_t from = bytewidth; /*where the loops below continue after the first pixel*/
+#ifdef LODEPNG_SIMD_X86
+  if(bytewidth == 4) filterScanline4SIMD(out, scanline, prevline, length, filterType, &from);
+#endif /*LODEPNG_SIMD_X86*/
   switch(filterType)
   {
     case 0: /*None*/
@@ -5556,12 +6445,13 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
       break;
     case 1: /*Sub*/
       for(i = 0; i != bytewidth; ++i) out[i] = scanline[i];
-      for(i = bytewidth; i < length; ++i) out[i] = scanline[i] - scanline[i - bytewidth];
+      for(i = from; i < length; ++i) out[i] = scanline[i] - scanline[i - bytewidth];
       break;
     case 2: /*Up*/
       if(prevline)
       {
-        for(i = 0; i != length; ++i) out[i] = scanline[i] - prevline[i];
+        for(i = 0; i != bytewidth; ++i) out[i] = scanline[i] - prevline[i];
+        for(i = from; i < length; ++i) out[i] = scanline[i] - prevline[i];
       }
       else
       {
@@ -5572,7 +6462,7 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
       if(prevline)
       {
         for(i = 0; i != bytewidth; ++i) out[i] = scanline[i] - (prevline[i] >> 1);
-        for(i = bytewidth; i < length; ++i) out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) >> 1);
+        for(i = from; i < length; ++i) out[i] = scanline[i] - ((scanline[i - bytewidth] + prevline[i]) >> 1);
       }
       else
       {
@@ -5585,7 +6475,7 @@ static void filterScanline(unsigned char* out, const unsigned char* scanline, co
       {
         /*paethPredictor(0, prevline[i], 0) is always prevline[i]*/
         for(i = 0; i != bytewidth; ++i) out[i] = (scanline[i] - prevline[i]);
-        for(i = bytewidth; i < length; ++i)
+        for(i = from; i < length; ++i)
         {
           out[i] = (scanline[i] - paethPredictor(scanline[i - bytewidth], prevline[i], prevline[i - bytewidth]));
         }
@@ -5610,6 +6500,148 @@ static float flog2(float f)
   return result + 1.442695f * (f * f * f / 3 - 3 * f * f / 2 + 3 * f - 1.83333f);
 }
 
+/*
+Filters one scanline with the given strategy, which may be anything but LFS_PREDEFINED:
+out[0] gets the chosen filter type and out[1..linebytes] the filtered bytes. attempt
+holds five buffers of linebytes bytes to try the filter types in (unused for LFS_ZERO).
+*/
+static unsigned filterScanlineStrategy(unsigned char* out, const unsigned char* scanline,
+                                       const unsigned char* prevline, size_t linebytes, size_t bytewidth,
+                                       LodePNGFilterStrategy strategy, const LodePNGCompressSettings* settings,
+                                       unsigned char* attempt[5])
+{
+  size_t x;
+  unsigned type, bestType = 0;
+
+  if(strategy == LFS_ZERO)
+  {
+    out[0] = 0; /*filter type byte*/
+    filterScanline(&out[1], scanline, prevline, linebytes, bytewidth, 0);
+    return 0;
+  }
+  else if(strategy == LFS_MINSUM)
+  {
+    /*adaptive filtering*/
+    size_t sum, smallest = 0;
+
+    /*try the 5 filter types*/
+    for(type = 0; type != 5; ++type)
+    {
+      filterScanline(attempt[type], scanline, prevline, linebytes, bytewidth, (unsigned char)type);
+
+      /*calculate the sum of the result*/
+      sum = 0;
+      if(type == 0)
+      {
+        for(x = 0; x != linebytes; ++x) sum += (unsigned char)(attempt[type][x]);
+      }
+      else
+      {
+        for(x = 0; x != linebytes; ++x)
+        {
+          /*For differences, each byte should be treated as signed, values above 127 are negative
+          (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
+          This means filtertype 0 is almost never chosen, but that is justified.*/
+          unsigned char s = attempt[type][x];
+          sum += s < 128 ? s : (255U - s);
+        }
+      }
+
+      /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+      if(type == 0 || sum < smallest)
+      {
+        bestType = type;
+        smallest = sum;
+      }
+    }
+  }
+  else if(strategy == LFS_ENTROPY)
+  {
+    float sum, smallest = 0;
+    unsigned count[256];
+
+    /*try the 5 filter types*/
+    for(type = 0; type != 5; ++type)
+    {
+      filterScanline(attempt[type], scanline, prevline, linebytes, bytewidth, (unsigned char)type);
+      for(x = 0; x != 256; ++x) count[x] = 0;
+      for(x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
+      ++count[type]; /*the filter type itself is part of the scanline*/
+      sum = 0;
+      for(x = 0; x != 256; ++x)
+      {
+        float p = count[x] / (float)(linebytes + 1);
+        sum += count[x] == 0 ? 0 : flog2(1 / p) * p;
+      }
+      /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
+      if(type == 0 || sum < smallest)
+      {
+        bestType = type;
+        smallest = sum;
+      }
+    }
+  }
+  else if(strategy == LFS_BRUTE_FORCE)
+  {
+    /*brute force filter chooser.
+    deflate the scanline after every filter attempt to see which one deflates best.
+    This is very slow and gives only slightly smaller, sometimes even larger, result*/
+    size_t size, smallest = 0;
+    unsigned char* dummy;
+    LodePNGCompressSettings zlibsettings = *settings;
+    /*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
+    to simulate the true case where the tree is the same for the whole image. Sometimes it gives
+    better result with dynamic tree anyway. Using the fixed tree sometimes gives worse, but in rare
+    cases better compression. It does make this a bit less slow, so it's worth doing this.*/
+    zlibsettings.btype = 1;
+    /*a custom encoder likely doesn't read the btype setting and is optimized for complete PNG
+    images only, so disable it*/
+    zlibsettings.custom_zlib = 0;
+    zlibsettings.custom_deflate = 0;
+    for(type = 0; type != 5; ++type) /*try the 5 filter types*/
+    {
+      unsigned testsize = (unsigned)linebytes;
+      /*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
+
+      filterScanline(attempt[type], scanline, prevline, linebytes, bytewidth, (unsigned char)type);
+      size = 0;
+      dummy = 0;
+      zlib_compress(&dummy, &size, attempt[type], testsize, &zlibsettings);
+      lodepng_free(dummy);
+      /*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
+      if(type == 0 || size < smallest)
+      {
+        bestType = type;
+        smallest = size;
+      }
+    }
+  }
+  else return 88; /* unknown filter strategy */
+
+  out[0] = (unsigned char)bestType; /*the first byte of a scanline will be the filter type*/
+  for(x = 0; x != linebytes; ++x) out[1 + x] = attempt[bestType][x];
+  return 0;
+}
+
+unsigned lodepng_filter_scanline(unsigned char* out, const unsigned char* scanline,
+                                 const unsigned char* prevline, size_t linebytes, size_t bytewidth,
+                                 LodePNGFilterStrategy strategy, const LodePNGCompressSettings* settings)
+{
+  unsigned char* attempt[5] = {0, 0, 0, 0, 0};
+  unsigned char* buffer = 0;
+  unsigned type, error;
+
+  if(strategy != LFS_ZERO)
+  {
+    buffer = (unsigned char*)lodepng_malloc(5 * linebytes);
+    if(!buffer) return 83; /*alloc fail*/
+    for(type = 0; type != 5; ++type) attempt[type] = &buffer[type * linebytes];
+  }
+  error = filterScanlineStrategy(out, scanline, prevline, linebytes, bytewidth, strategy, settings, attempt);
+  lodepng_free(buffer);
+  return error;
+}
+
 static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w, unsigned h,
                        const LodePNGColorMode* info, const LodePNGEncoderSettings* settings)
 {
@@ -5625,7 +6657,7 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
   /*bytewidth is used for filtering, is 1 when bpp < 8, number of bytes per pixel otherwise*/
   size_t bytewidth = (bpp + 7) / 8;
   const unsigned char* prevline = 0;
-  unsigned x, y;
+  unsigned y;
   unsigned error = 0;
   LodePNGFilterStrategy strategy = settings->filter_strategy;
 
@@ -5647,182 +6679,42 @@ static unsigned filter(unsigned char* out, const unsigned char* in, unsigned w,
 
   if(bpp == 0) return 31; /*error: invalid color type*/
 
-  if(strategy == LFS_ZERO)
+  if(strategy == LFS_PREDEFINED)
   {
     for(y = 0; y != h; ++y)
     {
       size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
       size_t inindex = linebytes * y;
-      out[outindex] = 0; /*filter type byte*/
-      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, 0);
+      unsigned char type = settings->predefined_filters[y];
+      out[outindex] = type; /*filter type byte*/
+      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
       prevline = &in[inindex];
     }
   }
-  else if(strategy == LFS_MINSUM)
+  else if(strategy == LFS_ZERO || strategy == LFS_MINSUM || strategy == LFS_ENTROPY ||
+          strategy == LFS_BRUTE_FORCE)
   {
-    /*adaptive filtering*/
-    size_t sum[5];
-    unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-    size_t smallest = 0;
-    unsigned char type, bestType = 0;
-
-    for(type = 0; type != 5; ++type)
-    {
-      attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-      if(!attempt[type]) return 83; /*alloc fail*/
-    }
+    unsigned char* attempt[5] = {0, 0, 0, 0, 0}; /*five filtering attempts, one for each filter type*/
+    unsigned type;
 
-    if(!error)
+    if(strategy != LFS_ZERO)
     {
-      for(y = 0; y != h; ++y)
-      {
-        /*try the 5 filter types*/
-        for(type = 0; type != 5; ++type)
-        {
-          filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-
-          /*calculate the sum of the result*/
-          sum[type] = 0;
-          if(type == 0)
-          {
-            for(x = 0; x != linebytes; ++x) sum[type] += (unsigned char)(attempt[type][x]);
-          }
-          else
-          {
-            for(x = 0; x != linebytes; ++x)
-            {
-              /*For differences, each byte should be treated as signed, values above 127 are negative
-              (converted to signed char). Filtertype 0 isn't a difference though, so use unsigned there.
-              This means filtertype 0 is almost never chosen, but that is justified.*/
-              unsigned char s = attempt[type][x];
-              sum[type] += s < 128 ? s : (255U - s);
-            }
-          }
-
-          /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-          if(type == 0 || sum[type] < smallest)
-          {
-            bestType = type;
-            smallest = sum[type];
-          }
-        }
-
-        prevline = &in[y * linebytes];
-
-        /*now fill the out values*/
-        out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-        for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-      }
-    }
-
-    for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-  }
-  else if(strategy == LFS_ENTROPY)
-  {
-    float sum[5];
-    unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-    float smallest = 0;
-    unsigned type, bestType = 0;
-    unsigned count[256];
-
-    for(type = 0; type != 5; ++type)
-    {
-      attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-      if(!attempt[type]) return 83; /*alloc fail*/
-    }
-
-    for(y = 0; y != h; ++y)
-    {
-      /*try the 5 filter types*/
       for(type = 0; type != 5; ++type)
       {
-        filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-        for(x = 0; x != 256; ++x) count[x] = 0;
-        for(x = 0; x != linebytes; ++x) ++count[attempt[type][x]];
-        ++count[type]; /*the filter type itself is part of the scanline*/
-        sum[type] = 0;
-        for(x = 0; x != 256; ++x)
-        {
-          float p = count[x] / (float)(linebytes + 1);
-          sum[type] += count[x] == 0 ? 0 : flog2(1 / p) * p;
-        }
-        /*check if this is smallest sum (or if type == 0 it's the first case so always store the values)*/
-        if(type == 0 || sum[type] < smallest)
-        {
-          bestType = type;
-          smallest = sum[type];
-        }
+        attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
+        if(!attempt[type]) error = 83; /*alloc fail*/
       }
-
-      prevline = &in[y * linebytes];
-
-      /*now fill the out values*/
-      out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-      for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
     }
 
-    for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
-  }
-  else if(strategy == LFS_PREDEFINED)
-  {
-    for(y = 0; y != h; ++y)
+    for(y = 0; !error && y != h; ++y)
     {
       size_t outindex = (1 + linebytes) * y; /*the extra filterbyte added to each row*/
       size_t inindex = linebytes * y;
-      unsigned char type = settings->predefined_filters[y];
-      out[outindex] = type; /*filter type byte*/
-      filterScanline(&out[outindex + 1], &in[inindex], prevline, linebytes, bytewidth, type);
+      error = filterScanlineStrategy(&out[outindex], &in[inindex], prevline, linebytes, bytewidth,
+                                     strategy, &settings->zlibsettings, attempt);
       prevline = &in[inindex];
     }
-  }
-  else if(strategy == LFS_BRUTE_FORCE)
-  {
-    /*brute force filter chooser.
-    deflate the scanline after every filter attempt to see which one deflates best.
-    This is very slow and gives only slightly smaller, sometimes even larger, result*/
-    size_t size[5];
-    unsigned char* attempt[5]; /*five filtering attempts, one for each filter type*/
-    size_t smallest = 0;
-    unsigned type = 0, bestType = 0;
-    unsigned char* dummy;
-    LodePNGCompressSettings zlibsettings = settings->zlibsettings;
-    /*use fixed tree on the attempts so that the tree is not adapted to the filtertype on purpose,
-    to simulate the true case where the tree is the same for the whole image. Sometimes it gives
-    better result with dynamic tree anyway. Using the fixed tree sometimes gives worse, but in rare
-    cases better compression. It does make this a bit less slow, so it's worth doing this.*/
-    zlibsettings.btype = 1;
-    /*a custom encoder likely doesn't read the btype setting and is optimized for complete PNG
-    images only, so disable it*/
-    zlibsettings.custom_zlib = 0;
-    zlibsettings.custom_deflate = 0;
-    for(type = 0; type != 5; ++type)
-    {
-      attempt[type] = (unsigned char*)lodepng_malloc(linebytes);
-      if(!attempt[type]) return 83; /*alloc fail*/
-    }
-    for(y = 0; y != h; ++y) /*try the 5 filter types*/
-    {
-      for(type = 0; type != 5; ++type)
-      {
-        unsigned testsize = (unsigned)linebytes;
-        /*if(testsize > 8) testsize /= 8;*/ /*it already works good enough by testing a part of the row*/
-
-        filterScanline(attempt[type], &in[y * linebytes], prevline, linebytes, bytewidth, type);
-        size[type] = 0;
-        dummy = 0;
-        zlib_compress(&dummy, &size[type], attempt[type], testsize, &zlibsettings);
-        lodepng_free(dummy);
-        /*check if this is smallest size (or if type == 0 it's the first case so always store the values)*/
-        if(type == 0 || size[type] < smallest)
-        {
-          bestType = type;
-          smallest = size[type];
-        }
-      }
-      prevline = &in[y * linebytes];
-      out[y * (linebytes + 1)] = bestType; /*the first byte of a scanline will be the filter type*/
-      for(x = 0; x != linebytes; ++x) out[y * (linebytes + 1) + 1 + x] = attempt[bestType][x];
-    }
+
     for(type = 0; type != 5; ++type) lodepng_free(attempt[type]);
   }
   else return 88; /* unknown filter strategy */
@@ -6510,6 +7402,7 @@ const char* lodepng_error_text(unsigned code)
     case 102: return "not allowed to set greyscale ICC profile with colored pixels by PNG specification";
     case 103: return "Invalid palette index in bKGD chunk. Maybe it came before PLTE chunk?";
     case 104: return "Invalid bKGD color while encoding (e.g. palette index out of range)";
+    case 105: return "deflate chunk dictionary is larger than its input";
   }
   return "unknown error code";
 }
@@ -287,7 +287,8 @@ struct LodePNGCompressSettings /*deflate = compress*/
   /*LZ77 related settings*/
   unsigned btype; /*the block type for LZ (0, 1, 2 or 3, see zlib standard). Should be 2 for proper compression.*/
   unsigned use_lz77; /*whether or not to use LZ77. Should be 1 for proper compression.*/
-  unsigned windowsize; /*must be a power of two <= 32768. higher compresses more but is slower. Default value: 2048.*/
+  unsigned windowsize; /*must be a power of two <= 32768. higher compresses more but is slower. Default value: 2048.
+                       1 gives fast run-length encoding, and windows up to 4 skip the hash chains.*/
   unsigned minmatch; /*mininum lz77 length. 3 is normally best, 6 can be better for some PNGs. Default: 0*/
   unsigned nicematch; /*stop searching if >= this length found. Set to 258 for best compression. Default: 128*/
   unsigned lazymatching; /*use lazy matching: better compression but a bit slower. Default: true*/
@@ -723,6 +724,18 @@ typedef struct LodePNGEncoderSettings
 } LodePNGEncoderSettings;
 
 void lodepng_encoder_settings_init(LodePNGEncoderSettings* settings);
+
+/*
+Filters one scanline the way the encoder does, for encoders that produce the scanlines
+themselves. out must have room for 1 + linebytes bytes: out[0] gets the chosen filter
+type and the rest the filtered scanline. prevline is the unfiltered scanline above, or
+NULL for the first one. bytewidth is the number of bytes per pixel (1 below 8 bits per
+pixel). strategy may be anything but LFS_PREDEFINED; settings is only used by
+LFS_BRUTE_FORCE. Return value: error code (0 means ok)
+*/
+unsigned lodepng_filter_scanline(unsigned char* out, const unsigned char* scanline,
+                                 const unsigned char* prevline, size_t linebytes, size_t bytewidth,
+                                 LodePNGFilterStrategy strategy, const LodePNGCompressSettings* settings);
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
 
@@ -768,6 +781,28 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+/*
+Receives decoded rows from lodepng_decode_scanlines: `count` consecutive rows starting
+at row y, in the color mode of state->info_raw, each lodepng_get_raw_size(w, 1, &info_raw)
+bytes long and stored one after the other. The rows are only valid during the call.
+Return 0 to continue decoding, or an error code to stop with that error.
+*/
+typedef unsigned (*LodePNGScanlineCallback)(void* user, unsigned y, unsigned count,
+                                            const unsigned char* rows);
+
+/*
+Same as lodepng_decode, but instead of returning the whole image it hands the image
+to callback a few rows at a time, as they are inflated, unfiltered and color converted.
+Besides the compressed data, only a 32K inflate window and about 256K of rows are held
+in memory at once. *w and *h are set before the first call to callback; user is passed
+through to it. Interlaced images, and settings with a custom zlib or inflate function,
+are decoded whole first and then handed out in one call.
+*/
+unsigned lodepng_decode_scanlines(unsigned* w, unsigned* h,
+                                  LodePNGState* state,
+                                  const unsigned char* in, size_t insize,
+                                  LodePNGScanlineCallback callback, void* user);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 
@@ -889,6 +924,15 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize,
                                  const LodePNGDecompressSettings* settings);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
+/*Returns the Adler32 checksum (as used by zlib) of data[0..len-1].*/
+unsigned lodepng_adler32(const unsigned char* data, size_t len);
+
+/*
+Given adler1, the Adler32 of some data A, and adler2, the Adler32 of data B of
+length len2, returns the Adler32 of A followed by B without looking at the data.
+*/
+unsigned lodepng_adler32_combine(unsigned adler1, unsigned adler2, size_t len2);
+
 #ifdef LODEPNG_COMPILE_ENCODER
 /*
 Compresses data with Zlib. Reallocates the out buffer and appends the data.
@@ -913,6 +957,20 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Compresses in[dictsize..insize-1] as one piece of a longer deflate stream, so that the
+pieces of a stream can be compressed independently (e.g. on several threads) and then
+concatenated. in[0..dictsize-1] is the data preceding the piece, which LZ77 matches may
+refer back to (only the last windowsize bytes are used). Unless final is set, the piece
+ends with an empty stored block (a zlib "sync flush"), which leaves the stream on a
+byte boundary. Only the last piece of a stream may be final.
+Either, *out must be NULL and *outsize must be 0, or, *out must be a valid
+buffer and *outsize its size in bytes. out must be freed by user after usage.
+*/
+unsigned lodepng_deflate_chunk(unsigned char** out, size_t* outsize,
+                               const unsigned char* in, size_t dictsize, size_t insize,
+                               unsigned final, const LodePNGCompressSettings* settings);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -1300,6 +1358,8 @@ can encode the colors of all pixels without information loss.
    true for proper compression.
 *) windowsize: the window size used by the LZ77 encoder (1 - 32768). Has value
    2048 by default, but can be set to 32768 for better, but slow, compression.
+   Windows of 4 or less compare those distances directly instead of hashing,
+   which makes 1 a fast run-length encoder.
 *) force_palette: if colortype is 2 or 6, you can make the encoder write a PLTE
    chunk if force_palette is true. This can used as suggested palette to convert
    to by viewers that don't support more than 256 colors (if those still exist)
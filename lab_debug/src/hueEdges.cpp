@@ -0,0 +1,204 @@
+/**
+ * @file hueEdges.cpp
+ * Implementation of the hue edge detector used by sketchify.
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "hueEdges.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace cs225;
+
+EdgeMask::EdgeMask() : width_(0), height_(0), stride_(0) { }
+
+EdgeMask::EdgeMask(unsigned width, unsigned height)
+    : width_(width), height_(height), stride_((width + 63) / 64),
+      bits_(stride_ * height, 0) { }
+
+unsigned EdgeMask::width() const { return width_; }
+
+unsigned EdgeMask::height() const { return height_; }
+
+bool EdgeMask::get(unsigned x, unsigned y) const {
+    return (row(y)[x / 64] >> (x % 64)) & 1;
+}
+
+std::uint64_t* EdgeMask::row(unsigned y) { return bits_.data() + (y * stride_); }
+
+const std::uint64_t* EdgeMask::row(unsigned y) const { return bits_.data() + (y * stride_); }
+
+std::size_t EdgeMask::stride() const { return stride_; }
+
+std::size_t EdgeMask::count() const {
+    std::size_t total = 0;
+    for (std::uint64_t word : bits_)
+        total += __builtin_popcountll(word);
+    return total;
+}
+
+namespace {
+    // The three rows a pixel's neighborhood can reach
+    struct Rows {
+        const HSLAPixel* above;
+        const HSLAPixel* here;
+        const HSLAPixel* below;
+    };
+
+    // a - b, the short way around (in (-180, 180]) if wrap is set
+    double hueDifference(double a, double b, bool wrap) {
+        double d = a - b;
+        if (!wrap)
+            return d;
+        if (d > 180)
+            d -= 360;
+        else if (d < -180)
+            d += 360;
+        return d;
+    }
+
+    // |a - b|, the short way around (in [0, 180]) if wrap is set
+    double hueDistance(double a, double b, bool wrap) {
+        double d = std::fabs(a - b);
+        return wrap ? std::min(d, 360 - d) : d;
+    }
+
+    // Whether pixel x is an edge, one pixel at a time. Used on the columns
+    // the vector loop skips, and everywhere without SSE2. Neighbors off the
+    // left or right end repeat the end pixel.
+    bool isEdge(const Rows& rows, unsigned x, unsigned width, const EdgeOptions& options) {
+        unsigned left = (x > 0) ? x - 1 : 0;
+        unsigned right = (x + 1 < width) ? x + 1 : x;
+        double h = rows.here[x].h;
+        double t = options.threshold;
+        bool w = options.wrapHue;
+
+        switch (options.neighborhood) {
+            case EdgeNeighborhood::Diagonal:
+                return hueDistance(h, rows.above[left].h, w) > t;
+
+            case EdgeNeighborhood::FourConnected:
+                return hueDistance(h, rows.here[left].h, w) > t || hueDistance(h, rows.here[right].h, w) > t ||
+                       hueDistance(h, rows.above[x].h, w) > t || hueDistance(h, rows.below[x].h, w) > t;
+
+            case EdgeNeighborhood::Sobel: {
+                double gx = hueDifference(rows.above[right].h, rows.above[left].h, w) +
+                            2 * hueDifference(rows.here[right].h, rows.here[left].h, w) +
+                            hueDifference(rows.below[right].h, rows.below[left].h, w);
+                double gy = hueDifference(rows.below[left].h, rows.above[left].h, w) +
+                            2 * hueDifference(rows.below[x].h, rows.above[x].h, w) +
+                            hueDifference(rows.below[right].h, rows.above[right].h, w);
+                return (gx * gx) + (gy * gy) > 16 * (t * t);
+            }
+        }
+        return false;
+    }
+
+    void setBit(std::uint64_t* row, unsigned x) {
+        row[x / 64] |= std::uint64_t(1) << (x % 64);
+    }
+
+#ifdef __SSE2__
+    // The hues of pixels x and x + 1
+    __m128d loadHues(const HSLAPixel* row, unsigned x) {
+        return _mm_loadh_pd(_mm_load_sd(&row[x].h), &row[x + 1].h);
+    }
+
+    // The masks zero the wrap corrections when wrapping is off
+    __m128d hueDifference(__m128d a, __m128d b, __m128d wrap) {
+        const __m128d half = _mm_set1_pd(180), full = _mm_and_pd(_mm_set1_pd(360), wrap);
+        __m128d d = _mm_sub_pd(a, b);
+        d = _mm_sub_pd(d, _mm_and_pd(_mm_cmpgt_pd(d, half), full));
+        return _mm_add_pd(d, _mm_and_pd(_mm_cmplt_pd(d, _mm_sub_pd(_mm_setzero_pd(), half)), full));
+    }
+
+    __m128d hueDistance(__m128d a, __m128d b, __m128d wrap) {
+        const __m128d sign = _mm_set1_pd(-0.0), full = _mm_set1_pd(360);
+        const __m128d infinity = _mm_set1_pd(std::numeric_limits<double>::infinity());
+        __m128d d = _mm_andnot_pd(sign, _mm_sub_pd(a, b));
+        __m128d around = _mm_or_pd(_mm_and_pd(wrap, _mm_sub_pd(full, d)), _mm_andnot_pd(wrap, infinity));
+        return _mm_min_pd(d, around);
+    }
+
+    // Two bits, for pixels x and x + 1: which of them are edges. Both
+    // pixels must have neighbors on both sides.
+    int edgePair(const Rows& rows, unsigned x, const EdgeOptions& options) {
+        __m128d h = loadHues(rows.here, x);
+        __m128d t = _mm_set1_pd(options.threshold);
+        __m128d w = _mm_castsi128_pd(_mm_set1_epi32(options.wrapHue ? -1 : 0));
+
+        switch (options.neighborhood) {
+            case EdgeNeighborhood::Diagonal:
+                return _mm_movemask_pd(_mm_cmpgt_pd(hueDistance(h, loadHues(rows.above, x - 1), w), t));
+
+            case EdgeNeighborhood::FourConnected: {
+                __m128d d = _mm_max_pd(hueDistance(h, loadHues(rows.here, x - 1), w),
+                                       hueDistance(h, loadHues(rows.here, x + 1), w));
+                d = _mm_max_pd(d, hueDistance(h, loadHues(rows.above, x), w));
+                d = _mm_max_pd(d, hueDistance(h, loadHues(rows.below, x), w));
+                return _mm_movemask_pd(_mm_cmpgt_pd(d, t));
+            }
+
+            case EdgeNeighborhood::Sobel: {
+                const __m128d two = _mm_set1_pd(2);
+                __m128d aboveLeft = loadHues(rows.above, x - 1), aboveRight = loadHues(rows.above, x + 1);
+                __m128d belowLeft = loadHues(rows.below, x - 1), belowRight = loadHues(rows.below, x + 1);
+                __m128d gx = _mm_add_pd(
+                    _mm_add_pd(hueDifference(aboveRight, aboveLeft, w), hueDifference(belowRight, belowLeft, w)),
+                    _mm_mul_pd(two, hueDifference(loadHues(rows.here, x + 1), loadHues(rows.here, x - 1), w)));
+                __m128d gy = _mm_add_pd(
+                    _mm_add_pd(hueDifference(belowLeft, aboveLeft, w), hueDifference(belowRight, aboveRight, w)),
+                    _mm_mul_pd(two, hueDifference(loadHues(rows.below, x), loadHues(rows.above, x), w)));
+                __m128d magnitude = _mm_add_pd(_mm_mul_pd(gx, gx), _mm_mul_pd(gy, gy));
+                return _mm_movemask_pd(_mm_cmpgt_pd(magnitude, _mm_mul_pd(_mm_set1_pd(16), _mm_mul_pd(t, t))));
+            }
+        }
+        return 0;
+    }
+#endif
+}
+
+void findHueEdges(const HSLAPixel* above, const HSLAPixel* here, const HSLAPixel* below,
+                  unsigned width, std::uint64_t* bits, const EdgeOptions& options) {
+    bool diagonal = (options.neighborhood == EdgeNeighborhood::Diagonal);
+    if (width == 0 || (diagonal && above == here))
+        return;
+    Rows rows = {above, here, below};
+
+    // Pixels 0 and width - 1 lack a neighbor on one side; the diagonal
+    // never marks pixel 0 at all
+    unsigned x = 1;
+    if (!diagonal && isEdge(rows, 0, width, options))
+        setBit(bits, 0);
+#ifdef __SSE2__
+    for (; x + 2 < width; x += 2) {
+        int pair = edgePair(rows, x, options);
+        if (pair & 1)
+            setBit(bits, x);
+        if (pair & 2)
+            setBit(bits, x + 1);
+    }
+#endif
+    for (; x < width; x++) {
+        if (isEdge(rows, x, width, options))
+            setBit(bits, x);
+    }
+}
+
+EdgeMask findHueEdges(const PNG& image, const EdgeOptions& options) {
+    unsigned width = image.width();
+    unsigned height = image.height();
+    EdgeMask mask(width, height);
+    if (width == 0 || height == 0)
+        return mask;
+
+    image.forEachRow([&](unsigned y, const HSLAPixel* here) {
+        findHueEdges(image.row(y > 0 ? y - 1 : 0), here, image.row(y + 1 < height ? y + 1 : y),
+                     width, mask.row(y), options);
+    });
+    return mask;
+}
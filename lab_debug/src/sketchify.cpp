@@ -5,9 +5,14 @@
 #pragma GCC diagnostic ignored "-Wuninitialized"
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
 #include "cs225/PNG.h"
 #include "cs225/HSLAPixel.h"
+#include "cs225/PNGStream.h"
+#include "hueEdges.h"
 using namespace cs225;
 
 /**
@@ -32,44 +37,74 @@ HSLAPixel* myFavoriteColor() {
     return new HSLAPixel(177, 0.8, 0.5);
 }
 
-void sketchify(std::string inputFile, std::string outputFile) {
-    // Load in.png
-    PNG* original = new PNG();
+PNG* sketchifyImage(const PNG& original) {
+    unsigned width = original.width();
+    unsigned height = original.height();
 
-    original->readFromFile(inputFile);
-    unsigned width = original->width();
-    unsigned height = original->height();
-
-    // Create out.png
+    // Create the output image
     PNG* output = setupOutput(width, height);
 
     // Load our favorite color to color the outline
     HSLAPixel* myPixel = myFavoriteColor();
 
-    // Go over the whole image, and if a pixel differs from that to its upper
-    // left, color it my favorite color in the output
+    // Color every pixel whose hue differs from that to its upper left by
+    // more than 20 degrees my favorite color in the output
+    EdgeOptions options;
+    options.wrapHue = false;
+    EdgeMask edges = findHueEdges(original, options);
     for (unsigned y = 1; y < height; y++) {
         for (unsigned x = 1; x < width; x++) {
-            // Calculate the pixel difference
-            HSLAPixel& prev = original->getPixel(x - 1, y - 1);
-            HSLAPixel& curr = original->getPixel(x, y);
-            double diff = std::fabs(curr.h - prev.h);
-            
-            // If the pixel is an edge pixel,
-            // color the output pixel with my favorite color
-            HSLAPixel& currOutPixel = (*output).getPixel(x, y);
-            if (diff > 20) {
-                currOutPixel = *myPixel;
+            if (edges.get(x, y)) {
+                output->getPixel(x, y) = *myPixel;
             }
-            
         }
     }
 
+    delete myPixel;
+    return output;
+}
+
+void sketchify(std::string inputFile, std::string outputFile) {
+    // Load in.png
+    PNG* original = new PNG();
+    original->readFromFile(inputFile);
+
+    // Create out.png
+    PNG* output = sketchifyImage(*original);
+
     // Save the output file
     output->writeToFile(outputFile);
 
     // Clean up memory
-    delete myPixel;
     delete output;
     delete original;
 }
+
+void sketchifyStreaming(std::string inputFile, std::string outputFile) {
+    PNGReader reader;
+    if (!reader.open(inputFile))
+        return;
+    unsigned width = reader.width();
+    unsigned height = reader.height();
+
+    PNGWriter writer;
+    if (!writer.open(outputFile, width, height))
+        return;
+
+    // The edge test only looks one row up, so a two-row window is enough
+    HSLAPixel myPixel(177, 0.8, 0.5);
+    EdgeOptions options;
+    options.wrapHue = false;
+    std::vector<HSLAPixel> previous(width);
+    std::vector<HSLAPixel> output(width);
+    std::vector<std::uint64_t> edges((width + 63) / 64);
+    reader.readRows([&](unsigned y, const HSLAPixel* row) {
+        std::fill(edges.begin(), edges.end(), 0);
+        findHueEdges(y > 0 ? previous.data() : row, row, row, width, edges.data(), options);
+        for (unsigned x = 0; x < width; x++)
+            output[x] = ((edges[x / 64] >> (x % 64)) & 1) ? myPixel : HSLAPixel();
+        previous.assign(row, row + width);
+        return writer.writeRow(output.data());
+    });
+    writer.close();
+}
@@ -7,6 +7,8 @@
 
 #include <string>
 
+#include "cs225/PNG.h"
+
 /**
  * Reads in an image, runs a simple "sketchify" algorithm on it to highlight
  * edges in the image, and then writes the resulting image back out to a
@@ -16,3 +18,23 @@
  * @param outputFile the name of the file where the output will be written
  */
 void sketchify(std::string inputFile, std::string outputFile);
+
+/**
+ * The edge-detection step of sketchify on its own, for callers that load
+ * and save images themselves.
+
+ * @param original the image to sketchify
+ * @return a pointer to the newly-created sketch, which the caller deletes
+ */
+cs225::PNG* sketchifyImage(const cs225::PNG& original);
+
+/**
+ * Same as sketchify, but streams the image through one row at a time
+ * instead of loading it whole: only the current and previous input rows
+ * and one output row are held, so memory use grows with the width of the
+ * image and not its height.
+
+ * @param inputFile the name of the PNG file to sketchify
+ * @param outputFile the name of the file where the output will be written
+ */
+void sketchifyStreaming(std::string inputFile, std::string outputFile);
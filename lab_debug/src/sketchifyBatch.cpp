@@ -0,0 +1,186 @@
+/**
+ * @file sketchifyBatch.cpp
+ * Implementation of the batch sketchify functions.
+ */
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include "cs225/PNG.h"
+#include "cs225/ThreadPool.h"
+#include "sketchify.h"
+#include "sketchifyBatch.h"
+using namespace cs225;
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    std::size_t fileSize(const std::string& fileName) {
+        struct stat info;
+        return (stat(fileName.c_str(), &info) == 0) ? info.st_size : 0;
+    }
+
+    bool isDirectory(const std::string& fileName) {
+        struct stat info;
+        return stat(fileName.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    }
+
+    bool isPNG(const std::string& fileName) {
+        return fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".png") == 0;
+    }
+
+    // One thread's share of the batch: it takes images from the front, and
+    // other threads steal from the back once their own queues run dry
+    struct WorkQueue {
+        std::deque<std::size_t> images;
+        std::mutex mutex;
+    };
+
+    bool takeImage(std::vector<std::unique_ptr<WorkQueue>>& queues, std::size_t own, std::size_t& image) {
+        {
+            WorkQueue& queue = *queues[own];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.images.empty()) {
+                image = queue.images.front();
+                queue.images.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < queues.size(); i++) {
+            WorkQueue& victim = *queues[(own + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.images.empty()) {
+                image = victim.images.back();
+                victim.images.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+std::vector<std::string> listSketchifyInputs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> files;
+    for (const std::string& input : inputs) {
+        if (isDirectory(input)) {
+            // readdir() order is arbitrary, so sort each directory's files
+            std::vector<std::string> found;
+            if (DIR* dir = opendir(input.c_str())) {
+                while (dirent* entry = readdir(dir)) {
+                    std::string name = entry->d_name;
+                    if (isPNG(name))
+                        found.push_back(input + "/" + name);
+                }
+                closedir(dir);
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        } else if (isPNG(input)) {
+            files.push_back(input);
+        } else {
+            std::ifstream list(input);
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty())
+                    files.push_back(line);
+            }
+        }
+    }
+    return files;
+}
+
+SketchifyStats sketchifyBatch(const std::vector<std::string>& inputFiles, const std::string& outputDir) {
+    // What each image did, filled in by whichever thread ran it and summed
+    // at the end so no thread waits on another for bookkeeping
+    struct Result {
+        bool ok = false;
+        std::size_t inputBytes = 0, outputBytes = 0, pixels = 0;
+        double decodeSeconds = 0, detectSeconds = 0, encodeSeconds = 0;
+    };
+    std::vector<Result> results(inputFiles.size());
+    for (std::size_t i = 0; i < inputFiles.size(); i++)
+        results[i].inputBytes = fileSize(inputFiles[i]);
+
+    // Inputs from different directories may share a file name; only the
+    // first of them is written, and the others count as failed
+    std::vector<std::string> outputFiles(inputFiles.size());
+    std::unordered_set<std::string> taken;
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < inputFiles.size(); i++) {
+        outputFiles[i] = outputDir + "/" + inputFiles[i].substr(inputFiles[i].find_last_of('/') + 1);
+        if (taken.insert(outputFiles[i]).second)
+            order.push_back(i);
+    }
+
+    // Deal the images out largest first, so the big ones start early and
+    // the small ones at the end of every queue even out the finish
+    std::stable_sort(order.begin(), order.end(), [&results](std::size_t a, std::size_t b) {
+        return results[a].inputBytes > results[b].inputBytes;
+    });
+
+    ThreadPool& pool = ThreadPool::shared();
+    std::size_t threads = std::max<std::size_t>(1, std::min<std::size_t>(pool.concurrency(), inputFiles.size()));
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    for (std::size_t t = 0; t < threads; t++)
+        queues.emplace_back(new WorkQueue());
+    for (std::size_t i = 0; i < order.size(); i++)
+        queues[i % threads]->images.push_back(order[i]);
+
+    Clock::time_point start = Clock::now();
+    pool.parallelFor(threads, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t own = begin; own < end; own++) {
+            std::size_t image;
+            while (takeImage(queues, own, image)) {
+                Result& result = results[image];
+                const std::string& inputFile = inputFiles[image];
+                const std::string& outputFile = outputFiles[image];
+
+                Clock::time_point stage = Clock::now();
+                PNG original;
+                bool read = original.readFromFile(inputFile);
+                result.decodeSeconds = secondsSince(stage);
+                if (!read)
+                    continue;
+
+                stage = Clock::now();
+                std::unique_ptr<PNG> output(sketchifyImage(original));
+                result.detectSeconds = secondsSince(stage);
+                result.pixels = std::size_t(original.width()) * original.height();
+
+                stage = Clock::now();
+                result.ok = output->writeToFile(outputFile);
+                result.encodeSeconds = secondsSince(stage);
+                result.outputBytes = fileSize(outputFile);
+            }
+        }
+    });
+
+    SketchifyStats stats;
+    stats.wallSeconds = secondsSince(start);
+    stats.threads = threads;
+    for (const Result& result : results) {
+        if (result.ok) {
+            stats.images++;
+        } else {
+            stats.failed++;
+        }
+        stats.inputBytes += result.inputBytes;
+        stats.outputBytes += result.outputBytes;
+        stats.pixels += result.pixels;
+        stats.decodeSeconds += result.decodeSeconds;
+        stats.detectSeconds += result.detectSeconds;
+        stats.encodeSeconds += result.encodeSeconds;
+    }
+    return stats;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file sketchifyBatch.h
+ * Declaration of the batch sketchify functions.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * What a batch did and where its time went. Stage times are summed over
+ * every thread, so with N threads busy they can add up to N times the
+ * wall-clock time.
+ */
+struct SketchifyStats {
+    unsigned images = 0;           // Images sketchified
+    unsigned failed = 0;           // Inputs that could not be read or written
+    std::size_t inputBytes = 0;    // Total size of the input files
+    std::size_t outputBytes = 0;   // Total size of the output files
+    std::size_t pixels = 0;        // Total pixels sketchified
+    double decodeSeconds = 0;      // Reading and decoding input files
+    double detectSeconds = 0;      // Finding edges
+    double encodeSeconds = 0;      // Encoding and writing output files
+    double wallSeconds = 0;        // Elapsed time for the whole batch
+    unsigned threads = 0;          // Threads that worked on the batch
+};
+
+/**
+ * Lists the PNG files to sketchify. Each input may be a directory (every
+ * .png file directly inside it), a .png file, or a text file naming one
+ * PNG file per line.
+
+ * @param inputs directories, PNG files and file lists
+ * @return the PNG files, in the order given
+ */
+std::vector<std::string> listSketchifyInputs(const std::vector<std::string>& inputs);
+
+/**
+ * Sketchifies many files at once, writing each to `outputDir` under its
+ * own file name. Of several inputs with the same file name, only the
+ * first is written; the others are counted as failed. Every thread of the
+ * shared cs225::ThreadPool takes whole images through decode, edge
+ * detection and encode, so the three stages of different images overlap.
+ * The images are dealt out largest first into one queue per thread; a
+ * thread that empties its own queue steals from the back of the others',
+ * so uneven image sizes do not leave cores idle.
+
+ * @param inputFiles the PNG files to sketchify
+ * @param outputDir the directory where the output files will be written
+ * @return the counts and per-stage timings of the batch
+ */
+SketchifyStats sketchifyBatch(const std::vector<std::string>& inputFiles, const std::string& outputDir);
@@ -1,9 +1,13 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "sketchify.h"
+#include "sketchifyBatch.h"
+#include "hueEdges.h"
 #include "cs225/PNG.h"
 #include "cs225/HSLAPixel.h"
 
+#include <sys/stat.h>
+
 #include <fstream>
 
 using namespace cs225;
@@ -135,3 +139,74 @@ TEST_CASE("in_03.png produces a correct sketch", "[weight=1]") {
     }
   }
 }
+
+TEST_CASE("sketchifyStreaming() produces the same sketch as sketchify()", "[weight=1]") {
+  PNG expected, png;
+  sketchify("../tests/in_01.png", "../tests/out.png");
+  expected.readFromFile("../tests/out.png");
+  sketchifyStreaming("../tests/in_01.png", "../tests/out.png");
+  png.readFromFile("../tests/out.png");
+
+  REQUIRE( png.width() == expected.width() );
+  REQUIRE( png.height() == expected.height() );
+  REQUIRE( png == expected );
+}
+
+TEST_CASE("sketchifyBatch() writes the same sketches as sketchify()", "[weight=1]") {
+  std::vector<std::string> files = listSketchifyInputs({"../tests/in_01.png", "../tests/in_02.png", "../tests/in_03.png"});
+  REQUIRE( files.size() == 3 );
+
+  mkdir("batch_out", 0755);
+  SketchifyStats stats = sketchifyBatch(files, "batch_out");
+  REQUIRE( stats.images == 3 );
+  REQUIRE( stats.failed == 0 );
+
+  for (std::string name : {"in_01.png", "in_02.png", "in_03.png"}) {
+    PNG expected, png;
+    sketchify("../tests/" + name, "../tests/out.png");
+    expected.readFromFile("../tests/out.png");
+    png.readFromFile("batch_out/" + name);
+    REQUIRE( png == expected );
+  }
+}
+
+TEST_CASE("sketchifyBatch() fails inputs whose file names clash", "[weight=1]") {
+  // Another in_01.png, holding in_02.png's pixels
+  mkdir("batch_clash", 0755);
+  PNG other;
+  other.readFromFile("../tests/in_02.png");
+  REQUIRE( other.writeToFile("batch_clash/in_01.png") );
+
+  mkdir("batch_clash_out", 0755);
+  SketchifyStats stats = sketchifyBatch({"../tests/in_01.png", "batch_clash/in_01.png"}, "batch_clash_out");
+  REQUIRE( stats.images == 1 );
+  REQUIRE( stats.failed == 1 );
+
+  PNG expected, png;
+  sketchify("../tests/in_01.png", "../tests/out.png");
+  expected.readFromFile("../tests/out.png");
+  png.readFromFile("batch_clash_out/in_01.png");
+  REQUIRE( png == expected );
+}
+
+TEST_CASE("findHueEdges() measures hue differences the short way around", "[weight=1]") {
+  // Hues 350 and 10 are 20 degrees apart, not 340
+  PNG png(80, 3);
+  for (unsigned x = 0; x < png.width(); x++) {
+    for (unsigned y = 0; y < png.height(); y++) {
+      png.getPixel(x, y) = HSLAPixel((x < 40) ? 350 : 10, 1, 0.5);
+    }
+  }
+
+  for (EdgeNeighborhood neighborhood : {EdgeNeighborhood::Diagonal, EdgeNeighborhood::FourConnected, EdgeNeighborhood::Sobel}) {
+    EdgeOptions options;
+    options.neighborhood = neighborhood;
+    REQUIRE( findHueEdges(png, options).count() == 0 );
+
+    options.wrapHue = false;
+    EdgeMask edges = findHueEdges(png, options);
+    REQUIRE( edges.get(40, 1) );
+    REQUIRE( !edges.get(20, 1) );
+    REQUIRE( !edges.get(60, 1) );
+  }
+}
@@ -0,0 +1,62 @@
+#include "kdtree.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * Times `op` and returns the elapsed milliseconds.
+ */
+double timeIt(std::function<void()> op) {
+  auto start = std::chrono::steady_clock::now();
+  op();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/**
+ * `count` random points spread over the LUV color space, as the average
+ * colors of a tile library would be.
+ */
+std::vector<Point<3>> randomColors(std::size_t count, std::mt19937 & random) {
+  std::uniform_real_distribution<double> l(0, 100), uv(-100, 100);
+  std::vector<Point<3>> points;
+  points.reserve(count);
+  for (std::size_t i = 0; i < count; i++) {
+    points.push_back(Point<3>(l(random), uv(random), uv(random)));
+  }
+  return points;
+}
+
+/**
+ * Builds a KDTree<3> over a tile library of `argv[1]` (default 100000)
+ * colors with each layout and times the build and `argv[2]` (default
+ * 100000) nearest-neighbor queries, as mapTiles() makes for a mosaic.
+ */
+int main(int argc, char *argv[]) {
+  std::size_t tiles = (argc > 1) ? std::atol(argv[1]) : 100000;
+  std::size_t queries = (argc > 2) ? std::atol(argv[2]) : 100000;
+
+  std::mt19937 random(225);
+  std::vector<Point<3>> library = randomColors(tiles, random);
+  std::vector<Point<3>> targets = randomColors(queries, random);
+  std::cout << "Tiles: " << tiles << ", queries: " << queries << std::endl;
+
+  for (KDTree<3>::Layout layout : {KDTree<3>::Layout::Nodes, KDTree<3>::Layout::Implicit}) {
+    KDTree<3> * tree = NULL;
+    double build = timeIt([&] { tree = new KDTree<3>(library, layout); });
+    double checksum = 0;
+    double query = timeIt([&] {
+      for (const Point<3> & target : targets) { checksum += tree->findNearestNeighbor(target)[0]; }
+    });
+    delete tree;
+
+    std::cout << ((layout == KDTree<3>::Layout::Nodes) ? "Nodes:    " : "Implicit: ")
+              << "build " << build << " ms, " << queries << " queries " << query << " ms ("
+              << (query * 1e6 / queries) << " ns each, checksum " << checksum << ")" << std::endl;
+  }
+  return 0;
+}
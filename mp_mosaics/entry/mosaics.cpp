@@ -1,5 +1,6 @@
 #include <iostream>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "cs225/PNG.h"
@@ -14,12 +15,13 @@ using namespace cs225;
 
 void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
                      int pixelsPerTile, const string& outFile);
-vector<TileImage> getTiles(string tileDir);
+vector<TileImage> getTiles(string tileDir, bool useCache);
 bool hasImageExtension(const string& fileName);
 
 namespace opts
 {
     bool help = false;
+    bool cache = false;
 }
 
 int main(int argc, const char** argv) {
@@ -37,12 +39,16 @@ int main(int argc, const char** argv) {
     optsparse.addArg(outFile);
     optsparse.addOption("help", opts::help);
     optsparse.addOption("h", opts::help);
+    optsparse.addOption("cache", opts::cache);
     optsparse.parse(argc, argv);
 
     if (opts::help) {
         cout << "Usage: " << argv[0]
              << " background_image.png tile_directory/ [number of tiles] "
-                "[pixels per tile] [output_image.png]"
+                "[pixels per tile] [output_image.png] [--cache]"
+             << endl;
+        cout << "  --cache: keep decoded images in the ImageCache, so later "
+                "runs load them without decoding"
              << endl;
         return 0;
     }
@@ -65,9 +71,9 @@ void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
                      int pixelsPerTile, const string& outFile)
 {
     PNG inImage;
-    inImage.readFromFile(inFile);
+    inImage.readFromFile(inFile, opts::cache);
     SourceImage source(inImage, numTiles);
-    vector<TileImage> tiles = getTiles(tileDir);
+    vector<TileImage> tiles = getTiles(tileDir, opts::cache);
 
     if (tiles.empty()) {
         cerr << "ERROR: No tile images found in " << tileDir << endl;
@@ -90,7 +96,7 @@ void makePhotoMosaic(const string& inFile, const string& tileDir, int numTiles,
     delete mosaic;
 }
 
-vector<TileImage> getTiles(string tileDir)
+vector<TileImage> getTiles(string tileDir, bool useCache)
 {
 #if 1
     if (tileDir[tileDir.length() - 1] != '/')
@@ -113,13 +119,13 @@ vector<TileImage> getTiles(string tileDir)
              << ")" << string(20, ' ') << "\r";
         cerr.flush();
         PNG png;
-        png.readFromFile(imageFiles.at(i));
+        png.readFromFile(imageFiles.at(i), useCache);
         TileImage next(png);
 
         LUVAPixel avg = next.getAverageColor();
         if (avgColors.count(avg) == 0) {
             avgColors.insert(avg);
-            images.push_back(next);
+            images.push_back(std::move(next));
         }
     }
     cerr << "\rLoading Tile Images... ("
@@ -16,13 +16,16 @@ using std::string;
 using std::vector;
 
 #include <cassert>
+#include <cstring>
 #include <algorithm>
 #include <functional>
 
 #include "lodepng/lodepng.h"
 #include "PNG.h"
+#include "ImageCache.h"
 
 #include "RGB_LUV.h"
+#include "RGB_LUV_Batch.h"
 #include "LUVAPixel.h"
 
 namespace cs225 {
@@ -33,7 +36,8 @@ namespace cs225 {
     // Copy `other` to self
     width_ = other.width_;
     height_ = other.height_;
-    imageData_ = new LUVAPixel[width_ * height_];
+    capacity_ = width_ * height_;
+    imageData_ = new LUVAPixel[capacity_];
     for (unsigned i = 0; i < width_ * height_; i++) {
       imageData_[i] = other.imageData_[i];
     }
@@ -43,12 +47,14 @@ namespace cs225 {
     width_ = 0;
     height_ = 0;
     imageData_ = NULL;
+    capacity_ = 0;
   }
 
   PNG::PNG(unsigned int width, unsigned int height) {
     width_ = width;
     height_ = height;
-    imageData_ = new LUVAPixel[width * height];
+    capacity_ = width * height;
+    imageData_ = new LUVAPixel[capacity_];
   }
 
   PNG::PNG(PNG const & other) {
@@ -56,6 +62,18 @@ namespace cs225 {
     _copy(other);
   }
 
+  PNG::PNG(PNG && other) noexcept {
+    width_ = other.width_;
+    height_ = other.height_;
+    imageData_ = other.imageData_;
+    capacity_ = other.capacity_;
+
+    other.width_ = 0;
+    other.height_ = 0;
+    other.imageData_ = NULL;
+    other.capacity_ = 0;
+  }
+
   PNG::~PNG() {
     delete[] imageData_;
   }
@@ -65,25 +83,37 @@ namespace cs225 {
     return *this;
   }
 
+  PNG const & PNG::operator=(PNG && other) noexcept {
+    if (this != &other) {
+      delete[] imageData_;
+      width_ = other.width_;
+      height_ = other.height_;
+      imageData_ = other.imageData_;
+      capacity_ = other.capacity_;
+
+      other.width_ = 0;
+      other.height_ = 0;
+      other.imageData_ = NULL;
+      other.capacity_ = 0;
+    }
+    return *this;
+  }
+
   bool PNG::operator== (PNG const & other) const {
     if (width_ != other.width_) { return false; }
     if (height_ != other.height_) { return false; }
 
-    luvaColor luvaSpace1;
-    luvaColor luvaSpace2;
-    rgbaColor rgbaSpace1;
-    rgbaColor rgbaSpace2;
+    unsigned char rgba1[4];
+    unsigned char rgba2[4];
     for (unsigned i = 0; i < width_ * height_; i++) {
+      // Identical stored channels always convert to identical bytes
       LUVAPixel & p1 = imageData_[i];
       LUVAPixel & p2 = other.imageData_[i];
-      luvaSpace1 = {p1.l, p1.u, p1.v, p1.a};
-      luvaSpace2 = {p2.l, p2.u, p2.v, p2.a};
-      rgbaSpace1 = luv2rgb(luvaSpace1);
-      rgbaSpace2 = luv2rgb(luvaSpace2);
-      if (rgbaSpace1.r != rgbaSpace2.r
-          || rgbaSpace1.g != rgbaSpace2.g
-          || rgbaSpace1.b != rgbaSpace2.b
-          || rgbaSpace1.a != rgbaSpace2.a) { return false; }
+      if (std::memcmp(&p1, &p2, sizeof(LUVAPixel)) == 0) { continue; }
+
+      luva2rgbaBatch(&p1, rgba1, 1);
+      luva2rgbaBatch(&p2, rgba2, 1);
+      if (std::memcmp(rgba1, rgba2, sizeof(rgba1)) != 0) { return false; }
     }
 
     return true;
@@ -122,7 +152,23 @@ namespace cs225 {
 
   const LUVAPixel & PNG::getPixel(unsigned int x, unsigned int y) const { return _getPixelHelper(x,y); }
 
-  bool PNG::readFromFile(string const & fileName) {
+  /** Names the layout of the pixels in the ImageCache. */
+  static const char * cacheLayout = "cs225::PNG/LUVA64";
+
+  bool PNG::readFromFile(string const & fileName, bool useCache) {
+    static_assert(sizeof(LUVAPixel) == 32, "cached pixels are four packed doubles");
+    ImageCache::Entry entry;
+    if (useCache && ImageCache::shared().load(fileName, cacheLayout, entry)
+        && entry.size == std::size_t(entry.width) * entry.height * sizeof(LUVAPixel)) {
+      delete[] imageData_;
+      width_ = entry.width;
+      height_ = entry.height;
+      capacity_ = width_ * height_;
+      imageData_ = new LUVAPixel[capacity_];
+      std::memcpy(imageData_, entry.pixels.get(), entry.size);
+      return true;
+    }
+
     vector<unsigned char> byteData;
     unsigned error = lodepng::decode(byteData, width_, height_, fileName);
 
@@ -132,43 +178,22 @@ namespace cs225 {
     }
 
     delete[] imageData_;
-    imageData_ = new LUVAPixel[width_ * height_];
-
-    for (unsigned i = 0; i < byteData.size(); i += 4) {
-      rgbaColor rgb;
-      rgb.r = byteData[i];
-      rgb.g = byteData[i + 1];
-      rgb.b = byteData[i + 2];
-      rgb.a = byteData[i + 3];
-
-      luvaColor luv = rgb2luv(rgb);
-      LUVAPixel & pixel = imageData_[i/4];
-      pixel.l = luv.l;
-      pixel.u = luv.u;
-      pixel.v = luv.v;
-      pixel.a = luv.a;
-    }
+    capacity_ = width_ * height_;
+    imageData_ = new LUVAPixel[capacity_];
 
+    rgba2luvaBatch(byteData.data(), imageData_, width_ * height_);
+
+    if (useCache) {
+      ImageCache::shared().store(fileName, cacheLayout, width_, height_, imageData_,
+                                 std::size_t(width_) * height_ * sizeof(LUVAPixel));
+    }
     return true;
   }
 
   bool PNG::writeToFile(string const & fileName) {
     unsigned char *byteData = new unsigned char[width_ * height_ * 4];
 
-    for (unsigned i = 0; i < width_ * height_; i++) {
-      luvaColor luv;
-      luv.l = imageData_[i].l;
-      luv.u = imageData_[i].u;
-      luv.v = imageData_[i].v;
-      luv.a = imageData_[i].a;
-
-      rgbaColor rgb = luv2rgb(luv);
-
-      byteData[(i * 4)]     = rgb.r;
-      byteData[(i * 4) + 1] = rgb.g;
-      byteData[(i * 4) + 2] = rgb.b;
-      byteData[(i * 4) + 3] = rgb.a;
-    }
+    luva2rgbaBatch(imageData_, byteData, width_ * height_);
 
     unsigned error = lodepng::encode(fileName, byteData, width_, height_);
     if (error) {
@@ -188,28 +213,89 @@ namespace cs225 {
   }
 
   void PNG::resize(unsigned int newWidth, unsigned int newHeight) {
-    // Create a new vector to store the image data for the new (resized) image
-    LUVAPixel * newImageData = new LUVAPixel[newWidth * newHeight];
-
-    // Copy the current data to the new image data, using the existing pixel
-    // for coordinates within the bounds of the old image size
-    for (unsigned x = 0; x < newWidth; x++) {
-      for (unsigned y = 0; y < newHeight; y++) {
-        if (x < width_ && y < height_) {
-          LUVAPixel & oldPixel = this->getPixel(x, y);
-          LUVAPixel & newPixel = newImageData[ (x + (y * newWidth)) ];
-          newPixel = oldPixel;
+    std::size_t count = std::size_t(newWidth) * newHeight;
+    unsigned rows = std::min(height_, newHeight);
+    unsigned columns = std::min(width_, newWidth);
+
+    if (imageData_ != NULL && count <= capacity_) {
+      // Move the rows within the current array: narrowing moves each row
+      // towards the front, so go top to bottom; widening moves them towards
+      // the back, so go bottom to top and whiten the end of each row
+      if (newWidth <= width_) {
+        for (unsigned y = 0; y < rows; y++) {
+          std::memmove(imageData_ + (std::size_t(y) * newWidth), imageData_ + (std::size_t(y) * width_),
+                       columns * sizeof(LUVAPixel));
         }
+      } else {
+        for (unsigned y = rows; y-- > 0; ) {
+          LUVAPixel * row = imageData_ + (std::size_t(y) * newWidth);
+          std::memmove(row, imageData_ + (std::size_t(y) * width_), columns * sizeof(LUVAPixel));
+          std::fill(row + columns, row + newWidth, LUVAPixel());
+        }
+      }
+      std::fill(imageData_ + (std::size_t(rows) * newWidth), imageData_ + count, LUVAPixel());
+    } else {
+      // Copy the rows that stay to a new array for the resized image
+      LUVAPixel * newImageData = new LUVAPixel[count];
+      for (unsigned y = 0; y < rows; y++) {
+        std::memcpy(newImageData + (std::size_t(y) * newWidth), imageData_ + (std::size_t(y) * width_),
+                    columns * sizeof(LUVAPixel));
       }
+      delete[] imageData_;
+      imageData_ = newImageData;
+      capacity_ = count;
     }
 
-    // Clear the existing image
-    delete[] imageData_;
-
-    // Update the image to reflect the new image size and data
+    // Update the image to reflect the new image size
     width_ = newWidth;
     height_ = newHeight;
+  }
+
+  void PNG::reserve(std::size_t pixels) {
+    if (pixels <= capacity_) { return; }
+
+    LUVAPixel * newImageData = new LUVAPixel[pixels];
+    if (imageData_ != NULL) {
+      std::memcpy(newImageData, imageData_, std::size_t(width_) * height_ * sizeof(LUVAPixel));
+    }
+    delete[] imageData_;
     imageData_ = newImageData;
+    capacity_ = pixels;
+  }
+
+  std::size_t PNG::capacity() const {
+    return capacity_;
+  }
+
+  PNG PNG::crop(Rect const & rect) const {
+    unsigned x = std::min(rect.x, width_);
+    unsigned y = std::min(rect.y, height_);
+    PNG cropped(std::min(rect.width, width_ - x), std::min(rect.height, height_ - y));
+    cropped.blit(*this, Rect{x, y, cropped.width_, cropped.height_}, 0, 0);
+    return cropped;
+  }
+
+  void PNG::blit(PNG const & source, Rect const & rect, unsigned int dstX, unsigned int dstY) {
+    // Clip the rectangle to both images
+    unsigned x = std::min(rect.x, source.width_);
+    unsigned y = std::min(rect.y, source.height_);
+    unsigned columns = std::min(rect.width, source.width_ - x);
+    unsigned rows = std::min(rect.height, source.height_ - y);
+    columns = std::min(columns, width_ - std::min(dstX, width_));
+    rows = std::min(rows, height_ - std::min(dstY, height_));
+    if (columns == 0 || rows == 0) { return; }
+
+    const LUVAPixel * from = source.imageData_ + x + (std::size_t(y) * source.width_);
+    LUVAPixel * to = imageData_ + dstX + (std::size_t(dstY) * width_);
+
+    // Within one image, copy bottom to top when moving pixels down, so
+    // that no row is overwritten before it is read
+    bool backwards = (&source == this) && to > from;
+    for (unsigned step = 0; step < rows; step++) {
+      unsigned row = backwards ? (rows - 1 - step) : step;
+      std::memmove(to + (std::size_t(row) * width_), from + (std::size_t(row) * source.width_),
+                   columns * sizeof(LUVAPixel));
+    }
   }
 
   std::ostream & operator << ( std::ostream& os, PNG const& png ) {
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 using std::string;
 
@@ -34,6 +35,13 @@ namespace cs225 {
       */
     PNG(PNG const & other);
 
+    /**
+      * Move constructor: takes the pixels of `other` without copying them,
+      * leaving `other` an empty 0x0 image.
+      * @param other PNG to be moved from.
+      */
+    PNG(PNG && other) noexcept;
+
     /**
       * Destructor: frees all memory associated with a given PNG object.
       * Invoked by the system.
@@ -47,6 +55,14 @@ namespace cs225 {
       */
     PNG const & operator= (PNG const & other);
 
+    /**
+      * Move assignment operator: takes the pixels of `other` without
+      * copying them, leaving `other` an empty 0x0 image.
+      * @param other Image to move into the current image.
+      * @return The current image for assignment chaining.
+      */
+    PNG const & operator= (PNG && other) noexcept;
+
     /**
       * Equality operator: checks if two images are the same.
       * @param other Image to be checked.
@@ -66,9 +82,13 @@ namespace cs225 {
       * Reads in a PNG image from a file.
       * Overwrites any current image content in the PNG.
       * @param fileName Name of the file to be read from.
+      * @param useCache If true, look the decoded pixels up in
+      *   ImageCache::shared() first, and store them there after decoding.
+      *   A hit copies the cached LUVAPixels, skipping decoding and color
+      *   conversion.
       * @return true, if the image was successfully read and loaded.
       */
-    bool readFromFile(string const & fileName);
+    bool readFromFile(string const & fileName, bool useCache = false);
 
     /**
       * Writes a PNG image to a file.
@@ -112,16 +132,65 @@ namespace cs225 {
     /**
       * Resizes the image to the given coordinates. Attempts to preserve
       * existing pixel data in the image when doing so, but will crop if
-      * necessary. No pixel interpolation is done.
+      * necessary; new pixels are default-constructed LUVAPixel()s. No
+      * pixel interpolation is done.
+      * Rows are moved in place when the new size fits in capacity(), so
+      * no memory is allocated.
       * @param newWidth New width of the image.
       * @param newHeight New height of the image.
       */
     void resize(unsigned int newWidth, unsigned int newHeight);
 
+    /**
+      * Makes room for at least `pixels` pixels, so that resize() to any
+      * size of up to that many pixels will not allocate. Does not change
+      * the image.
+      * @param pixels Number of pixels to make room for.
+      */
+    void reserve(std::size_t pixels);
+
+    /**
+      * Gets the number of pixels the image can hold without allocating.
+      * @return The capacity of the pixel array.
+      */
+    std::size_t capacity() const;
+
+    /**
+      * A rectangle of pixels: the `width` x `height` pixels whose upper
+      * left corner is at (x, y).
+      */
+    struct Rect {
+      unsigned int x;
+      unsigned int y;
+      unsigned int width;
+      unsigned int height;
+    };
+
+    /**
+      * Gets a copy of the pixels of this image within `rect`. Parts of
+      * `rect` outside of the image are left out of the result.
+      * @param rect Area of this image to copy.
+      * @return A new image of (at most) rect.width x rect.height pixels.
+      */
+    PNG crop(Rect const & rect) const;
+
+    /**
+      * Copies the pixels of `source` within `rect` into this image, with
+      * the upper left corner of `rect` landing on (dstX, dstY). Pixels
+      * outside of either image are skipped; this image is not resized.
+      * `source` may be this image, and the two areas may overlap.
+      * @param source Image to copy from.
+      * @param rect Area of `source` to copy.
+      * @param dstX X-coordinate in this image of the first copied column.
+      * @param dstY Y-coordinate in this image of the first copied row.
+      */
+    void blit(PNG const & source, Rect const & rect, unsigned int dstX, unsigned int dstY);
+
   private:
     unsigned int width_;            /*< Width of the image */
     unsigned int height_;           /*< Height of the image */
     LUVAPixel *imageData_;          /*< Array of pixels */
+    std::size_t capacity_;          /*< Number of pixels allocated in imageData_ */
 
     /**
      * Copies the contents of `other` to self
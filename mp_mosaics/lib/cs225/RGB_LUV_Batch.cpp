@@ -0,0 +1,289 @@
+/**
+ * @file RGB_LUV_Batch.cpp
+ * Table-driven, whole-scanline versions of the conversions in RGB_LUV.h.
+ *
+ * Every expression below mirrors the order of operations in
+ * ColorSpace/Conversion.cpp so the results match rgb2luv()/luv2rgb() to
+ * the bit; only the pow() calls are replaced by exact table lookups.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "RGB_LUV_Batch.h"
+#include "ColorSpace/ColorSpace.h"
+#include "ColorSpace/Conversion.h"
+#include "ColorSpace/Utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CS225_LUV_SSE2
+#endif
+
+namespace cs225 {
+  namespace {
+    typedef ColorSpace::XyzConverter Xyz;
+
+    /** The sRGB companding curve used by XyzConverter::ToColor(), before rounding. */
+    double compandCurve(double c) {
+      return ((c > 0.0031308) ? (1.055*pow(c, 1 / 2.4) - 0.055) : (12.92*c)) * 255.0;
+    }
+
+    /**
+     * Linear-light value (scaled by 100) of every 8-bit sRGB channel value,
+     * exactly as XyzConverter::ToColorSpace() computes it.
+     */
+    struct DecompandTable {
+      double value[256];
+
+      DecompandTable() {
+        for (int i = 0; i < 256; i++) {
+          double c = i / 255.0;
+          value[i] = ((c > 0.04045) ? pow((c + 0.055) / 1.055, 2.4) : (c / 12.92)) * 100.0;
+        }
+      }
+    };
+
+    /**
+     * Inverse of round(compandCurve(c)) for linear values in (0.0031308, 1]:
+     * threshold[k] is the smallest double whose channel rounds to at least k,
+     * and start[i] is the channel value already reached at c = i / kBuckets,
+     * so a lookup only has to step over the odd threshold inside a bucket.
+     */
+    struct CompandTable {
+      static const int kBuckets = 4096;
+      double threshold[257];
+      unsigned char start[kBuckets + 1];
+
+      CompandTable() {
+        const double low = 0.0031308;
+        const double high = 1.0;
+        threshold[0] = 0;
+        for (int k = 1; k < 256; k++) {
+          if (round(compandCurve(high)) < k) {
+            threshold[k] = HUGE_VAL;
+            continue;
+          }
+          // Bisect on the bit patterns, which order positive doubles
+          std::uint64_t below = bits(low);
+          std::uint64_t above = bits(high);
+          while (above - below > 1) {
+            std::uint64_t mid = below + (above - below) / 2;
+            if (round(compandCurve(fromBits(mid))) >= k) { above = mid; }
+            else { below = mid; }
+          }
+          threshold[k] = fromBits(above);
+        }
+        threshold[256] = HUGE_VAL;
+
+        int k = 0;
+        for (int i = 0; i <= kBuckets; i++) {
+          double c = static_cast<double>(i) / kBuckets;
+          while (k < 255 && threshold[k + 1] <= c) { k++; }
+          start[i] = k;
+        }
+      }
+
+      /** round(compandCurve(c)) for any c. */
+      double channel(double c) const {
+        if (c > 0.0031308 && c <= 1.0) {
+          int k = start[static_cast<int>(c * kBuckets)];
+          while (threshold[k + 1] <= c) { k++; }
+          return k;
+        }
+        return round(compandCurve(c));
+      }
+
+      static std::uint64_t bits(double d) {
+        std::uint64_t b;
+        std::memcpy(&b, &d, sizeof(b));
+        return b;
+      }
+
+      static double fromBits(std::uint64_t b) {
+        double d;
+        std::memcpy(&d, &b, sizeof(d));
+        return d;
+      }
+    };
+
+    const DecompandTable & decompandTable() {
+      static const DecompandTable table;
+      return table;
+    }
+
+    const CompandTable & compandTable() {
+      static const CompandTable table;
+      return table;
+    }
+
+    /** LuvConverter::ToColorSpace() from linear r, g, b (scaled by 100). */
+    void linearToLuv(double r, double g, double b, double a, LUVAPixel & out) {
+      const ColorSpace::Xyz & white = Xyz::whiteReference;
+      double x = r*0.4124564 + g*0.3575761 + b*0.1804375;
+      double yy = r*0.2126729 + g*0.7151522 + b*0.0721750;
+      double z = r*0.0193339 + g*0.1191920 + b*0.9503041;
+
+      double y = yy / white.y;
+      double temp = (x + 15 * yy + 3 * z);
+      double tempr = (white.x + 15 * white.y + 3 * white.z);
+
+      out.l = (y > Xyz::eps) ? (116 * cbrt(y) - 16) : (Xyz::kappa*y);
+      out.u = 52 * out.l * (((temp > 1e-3) ? (x / temp) : 0) - white.x / tempr);
+      out.v = 117 * out.l * (((temp > 1e-3) ? (yy / temp) : 0) - white.y / tempr);
+      out.a = a / 255.0;
+    }
+
+    /** LuvConverter::ToColor() and XyzConverter::ToColor(), then luv2rgb()'s rounding. */
+    void luvToBytes(LUVAPixel const & in, unsigned char * out, CompandTable const & table) {
+      const ColorSpace::Xyz & white = Xyz::whiteReference;
+      double y = (in.l > Xyz::eps*Xyz::kappa) ? POW3((in.l + 16) / 116) : (in.l / Xyz::kappa);
+      double tempr = white.x + 15 * white.y + 3 * white.z;
+      double up = 4 * white.x / tempr;
+      double vp = 9 * white.y / tempr;
+
+      double a = 1. / 3. * (52 * in.l / (in.u + 13 * in.l*up) - 1);
+      double b = -5 * y;
+      double x = (y*(39 * in.l / (in.v + 13 * in.l*vp) - 5) - b) / (a + 1. / 3.);
+      double z = x*a + b;
+
+      double xs = (x * 100) / 100.0;
+      double ys = (y * 100) / 100.0;
+      double zs = (z * 100) / 100.0;
+
+      out[0] = table.channel(xs * 3.2404542 + ys * -1.5371385 + zs * -0.4985314);
+      out[1] = table.channel(xs * -0.9692660 + ys * 1.8760108 + zs * 0.0415560);
+      out[2] = table.channel(xs * 0.0556434 + ys * -0.2040259 + zs * 1.0572252);
+      out[3] = round(in.a * 255);
+    }
+
+#ifdef CS225_LUV_SSE2
+    /** Lane-wise `mask ? a : b`. */
+    inline __m128d select(__m128d mask, __m128d a, __m128d b) {
+      return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+    }
+
+    /** Two pixels of linearToLuv(); cbrt() stays scalar per lane. */
+    void linearToLuv2(__m128d r, __m128d g, __m128d b, const unsigned char * rgba, LUVAPixel * out) {
+      const ColorSpace::Xyz & white = Xyz::whiteReference;
+      #define CS225_DOT(c0, c1, c2) _mm_add_pd(_mm_add_pd(_mm_mul_pd(r, _mm_set1_pd(c0)), \
+          _mm_mul_pd(g, _mm_set1_pd(c1))), _mm_mul_pd(b, _mm_set1_pd(c2)))
+      __m128d x = CS225_DOT(0.4124564, 0.3575761, 0.1804375);
+      __m128d yy = CS225_DOT(0.2126729, 0.7151522, 0.0721750);
+      __m128d z = CS225_DOT(0.0193339, 0.1191920, 0.9503041);
+      #undef CS225_DOT
+
+      __m128d y = _mm_div_pd(yy, _mm_set1_pd(white.y));
+      __m128d temp = _mm_add_pd(_mm_add_pd(x, _mm_mul_pd(_mm_set1_pd(15), yy)),
+                                _mm_mul_pd(_mm_set1_pd(3), z));
+      double tempr = (white.x + 15 * white.y + 3 * white.z);
+
+      double ys[2];
+      _mm_storeu_pd(ys, y);
+      double ls[2];
+      for (int i = 0; i < 2; i++) {
+        ls[i] = (ys[i] > Xyz::eps) ? (116 * cbrt(ys[i]) - 16) : (Xyz::kappa*ys[i]);
+      }
+      __m128d l = _mm_loadu_pd(ls);
+
+      __m128d valid = _mm_cmpgt_pd(temp, _mm_set1_pd(1e-3));
+      __m128d zero = _mm_setzero_pd();
+      __m128d qu = select(valid, _mm_div_pd(x, temp), zero);
+      __m128d qv = select(valid, _mm_div_pd(yy, temp), zero);
+      __m128d u = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(52), l), _mm_sub_pd(qu, _mm_set1_pd(white.x / tempr)));
+      __m128d v = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(117), l), _mm_sub_pd(qv, _mm_set1_pd(white.y / tempr)));
+
+      double us[2], vs[2];
+      _mm_storeu_pd(us, u);
+      _mm_storeu_pd(vs, v);
+      for (int i = 0; i < 2; i++) {
+        out[i].l = ls[i];
+        out[i].u = us[i];
+        out[i].v = vs[i];
+        out[i].a = rgba[(i * 4) + 3] / 255.0;
+      }
+    }
+
+    /** Two pixels of luvToBytes(); companding stays a scalar lookup per lane. */
+    void luvToBytes2(const LUVAPixel * in, unsigned char * out, CompandTable const & table) {
+      const ColorSpace::Xyz & white = Xyz::whiteReference;
+      __m128d l = _mm_set_pd(in[1].l, in[0].l);
+      __m128d u = _mm_set_pd(in[1].u, in[0].u);
+      __m128d v = _mm_set_pd(in[1].v, in[0].v);
+
+      __m128d t = _mm_div_pd(_mm_add_pd(l, _mm_set1_pd(16)), _mm_set1_pd(116));
+      __m128d cube = _mm_mul_pd(_mm_mul_pd(t, t), t);
+      __m128d y = select(_mm_cmpgt_pd(l, _mm_set1_pd(Xyz::eps*Xyz::kappa)),
+                         cube, _mm_div_pd(l, _mm_set1_pd(Xyz::kappa)));
+      double tempr = white.x + 15 * white.y + 3 * white.z;
+      double up = 4 * white.x / tempr;
+      double vp = 9 * white.y / tempr;
+
+      __m128d l13 = _mm_mul_pd(_mm_set1_pd(13), l);
+      __m128d a = _mm_mul_pd(_mm_set1_pd(1. / 3.), _mm_sub_pd(
+          _mm_div_pd(_mm_mul_pd(_mm_set1_pd(52), l), _mm_add_pd(u, _mm_mul_pd(l13, _mm_set1_pd(up)))),
+          _mm_set1_pd(1)));
+      __m128d b = _mm_mul_pd(_mm_set1_pd(-5), y);
+      __m128d inner = _mm_sub_pd(
+          _mm_div_pd(_mm_mul_pd(_mm_set1_pd(39), l), _mm_add_pd(v, _mm_mul_pd(l13, _mm_set1_pd(vp)))),
+          _mm_set1_pd(5));
+      __m128d x = _mm_div_pd(_mm_sub_pd(_mm_mul_pd(y, inner), b), _mm_add_pd(a, _mm_set1_pd(1. / 3.)));
+      __m128d z = _mm_add_pd(_mm_mul_pd(x, a), b);
+
+      __m128d hundred = _mm_set1_pd(100);
+      __m128d xs = _mm_div_pd(_mm_mul_pd(x, hundred), hundred);
+      __m128d ys = _mm_div_pd(_mm_mul_pd(y, hundred), hundred);
+      __m128d zs = _mm_div_pd(_mm_mul_pd(z, hundred), hundred);
+
+      #define CS225_DOT(c0, c1, c2) _mm_add_pd(_mm_add_pd(_mm_mul_pd(xs, _mm_set1_pd(c0)), \
+          _mm_mul_pd(ys, _mm_set1_pd(c1))), _mm_mul_pd(zs, _mm_set1_pd(c2)))
+      double rs[2], gs[2], bs[2];
+      _mm_storeu_pd(rs, CS225_DOT(3.2404542, -1.5371385, -0.4985314));
+      _mm_storeu_pd(gs, CS225_DOT(-0.9692660, 1.8760108, 0.0415560));
+      _mm_storeu_pd(bs, CS225_DOT(0.0556434, -0.2040259, 1.0572252));
+      #undef CS225_DOT
+
+      for (int i = 0; i < 2; i++) {
+        unsigned char * px = out + (i * 4);
+        px[0] = table.channel(rs[i]);
+        px[1] = table.channel(gs[i]);
+        px[2] = table.channel(bs[i]);
+        px[3] = round(in[i].a * 255);
+      }
+    }
+#endif
+  }
+
+  void rgba2luvaBatch(const unsigned char * rgba, LUVAPixel * luva, std::size_t count) {
+    const double * linear = decompandTable().value;
+    std::size_t i = 0;
+#ifdef CS225_LUV_SSE2
+    for (; i + 2 <= count; i += 2) {
+      const unsigned char * px = rgba + (i * 4);
+      linearToLuv2(_mm_set_pd(linear[px[4]], linear[px[0]]),
+                   _mm_set_pd(linear[px[5]], linear[px[1]]),
+                   _mm_set_pd(linear[px[6]], linear[px[2]]), px, luva + i);
+    }
+#endif
+    for (; i < count; i++) {
+      const unsigned char * px = rgba + (i * 4);
+      linearToLuv(linear[px[0]], linear[px[1]], linear[px[2]], px[3], luva[i]);
+    }
+  }
+
+  void luva2rgbaBatch(const LUVAPixel * luva, unsigned char * rgba, std::size_t count) {
+    CompandTable const & table = compandTable();
+    std::size_t i = 0;
+#ifdef CS225_LUV_SSE2
+    for (; i + 2 <= count; i += 2) {
+      luvToBytes2(luva + i, rgba + (i * 4), table);
+    }
+#endif
+    for (; i < count; i++) {
+      luvToBytes(luva[i], rgba + (i * 4), table);
+    }
+  }
+}
@@ -0,0 +1,35 @@
+/**
+ * @file RGB_LUV_Batch.h
+ * Table-driven, whole-scanline versions of the conversions in RGB_LUV.h.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "LUVAPixel.h"
+
+namespace cs225 {
+  /**
+   * Converts `count` interleaved 8-bit RGBA pixels to LUVAPixels.
+   * sRGB decompanding is read from a 256-entry table and the remaining
+   * arithmetic runs two pixels at a time with SSE2 where available; the
+   * results are bit-identical to rgb2luv().
+   * @param rgba Input bytes, four per pixel.
+   * @param luva Output pixels.
+   * @param count Number of pixels.
+   */
+  void rgba2luvaBatch(const unsigned char * rgba, LUVAPixel * luva, std::size_t count);
+
+  /**
+   * Converts `count` LUVAPixels to interleaved 8-bit RGBA pixels.
+   * sRGB companding of in-gamut channels is a table lookup instead of
+   * pow(); every pixel gets the same bytes luv2rgb() would produce.
+   * @param luva Input pixels.
+   * @param rgba Output bytes, four per pixel.
+   * @param count Number of pixels.
+   */
+  void luva2rgbaBatch(const LUVAPixel * luva, unsigned char * rgba, std::size_t count);
+}
@@ -45,6 +45,20 @@ class KDTree
     };
 
   public:
+    /**
+     * How a KDTree stores its points.
+     *
+     * Nodes allocates a KDTreeNode per point and links them with pointers.
+     * Implicit keeps the points in one array, ordered so the median of
+     * every subtree sits in the middle of that subtree's range: the root of
+     * the points in [lo, hi) is at lo + (hi - lo - 1) / 2, its left subtree
+     * is the range before it and its right subtree the range after. The tree
+     * has the same shape, but no node is allocated on its own and
+     * findNearestNeighbor() walks a contiguous array of coordinates.
+     * printTree() only draws trees built with Nodes.
+     */
+    enum class Layout { Nodes, Implicit };
+
     /**
      * Determines if Point a is smaller than Point b in a given dimension d.
      * If there is a tie, break it with Point::operator<().
@@ -151,8 +165,9 @@ class KDTree
      *
      * @todo This function is required for Part 1.
      * @param newPoints The vector of points to build your KDTree off of.
+     * @param layout How to store the tree.
      */
-    KDTree(const vector<Point<Dim>>& newPoints);
+    KDTree(const vector<Point<Dim>>& newPoints, Layout layout = Layout::Nodes);
 
 
     /**
@@ -251,6 +266,11 @@ class KDTree
     KDTreeNode *root;
     size_t size;
 
+    /** The Implicit layout: median-ordered points, and their coordinates **/
+    Layout layout;
+    vector<Point<Dim>> points;
+    vector<double> coords;
+
     /** Helper function for grading */
     int getPrintData(KDTreeNode * subroot) const;
 
@@ -266,7 +286,10 @@ class KDTree
     Point<Dim> quickselect(vector<Point<Dim>>& points, int dim, int k);
     int partition(vector<Point<Dim>>& points, int dim);
     Point<Dim> findNearestNeighborHelper(KDTreeNode* root, const Point<Dim>& query, int dim) const;
-    KDTreeNode copy(const KDTreeNode* node);
+    KDTreeNode* copy(const KDTreeNode* node);
+    void buildImplicitHelper(size_t lo, size_t hi, int dim);
+    void findNearestImplicitHelper(size_t lo, size_t hi, int dim, const Point<Dim>& query,
+                                   const double* target, size_t& best, double& bestDist) const;
 };
 
 #include "kdtree.hpp"
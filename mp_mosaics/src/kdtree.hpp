@@ -33,10 +33,33 @@ bool KDTree<Dim>::shouldReplace(const Point<Dim>& target,
 }
 
 template <int Dim>
-KDTree<Dim>::KDTree(const vector<Point<Dim>>& newPoints)
+KDTree<Dim>::KDTree(const vector<Point<Dim>>& newPoints, Layout layout)
+  : root(NULL), size(newPoints.size()), layout(layout)
 {
-    vector<Point<Dim>> points = newPoints;
-    buildTreeHelper(points, 0, root);
+  if (layout == Layout::Implicit) {
+    points = newPoints;
+    buildImplicitHelper(0, points.size(), 0);
+    coords.resize(points.size() * Dim);
+    for (size_t i = 0; i < points.size(); i++)
+      for (int d = 0; d < Dim; d++) coords[i * Dim + d] = points[i][d];
+    return;
+  }
+
+  vector<Point<Dim>> nodePoints = newPoints;
+  buildTreeHelper(nodePoints, 0, root);
+}
+
+template <int Dim>
+void KDTree<Dim>::buildImplicitHelper(size_t lo, size_t hi, int dim)
+{
+  if (hi - lo <= 1) return;
+
+  // Put the median in the middle of the range, smaller points before it
+  size_t mid = lo + (hi - lo - 1) / 2;
+  nth_element(points.begin() + lo, points.begin() + mid, points.begin() + hi,
+              [this, dim](const Point<Dim>& a, const Point<Dim>& b) { return smallerDimVal(a, b, dim); });
+  buildImplicitHelper(lo, mid, (dim + 1) % Dim);
+  buildImplicitHelper(mid + 1, hi, (dim + 1) % Dim);
 }
 
 template <int Dim>
@@ -104,13 +127,21 @@ int KDTree<Dim>::partition(vector<Point<Dim>>& points, int dim)
 template <int Dim>
 KDTree<Dim>::KDTree(const KDTree<Dim>& other) {
   root = copy(other.root);
+  size = other.size;
+  layout = other.layout;
+  points = other.points;
+  coords = other.coords;
 }
 
 template <int Dim>
 const KDTree<Dim>& KDTree<Dim>::operator=(const KDTree<Dim>& rhs) {
-  if (!this == &rhs) {
+  if (this != &rhs) {
     destroy(root);
     root = copy(rhs.root);
+    size = rhs.size;
+    layout = rhs.layout;
+    points = rhs.points;
+    coords = rhs.coords;
   }
   return *this;
 }
@@ -122,12 +153,12 @@ KDTree<Dim>::~KDTree() {
 }
 
 template <int Dim>
-typename KDTree<Dim>::KDTreeNode KDTree<Dim>::copy(const KDTreeNode* root) {
-  if (root == NULL) return root;
+typename KDTree<Dim>::KDTreeNode* KDTree<Dim>::copy(const KDTreeNode* root) {
+  if (root == NULL) return NULL;
 
-  KDTreeNode node = new KDTreeNode(root);
+  KDTreeNode* node = new KDTreeNode(root->point);
   node->left = copy(root->left);
-  node->left = copy(root->right);
+  node->right = copy(root->right);
 
   return node;
 }
@@ -143,9 +174,48 @@ void KDTree<Dim>::destroy(KDTreeNode* node) {
 template <int Dim>
 Point<Dim> KDTree<Dim>::findNearestNeighbor(const Point<Dim>& query) const
 {
+  if (layout == Layout::Implicit) {
+    if (points.empty()) return Point<Dim>();
+    double target[Dim];
+    for (int i = 0; i < Dim; i++) target[i] = query[i];
+    size_t best = points.size();
+    double bestDist = INFINITY;
+    findNearestImplicitHelper(0, points.size(), 0, query, target, best, bestDist);
+    return points[best];
+  }
+
   return findNearestNeighborHelper(root, query, 0);
 }
 
+template <int Dim>
+void KDTree<Dim>::findNearestImplicitHelper(size_t lo, size_t hi, int dim, const Point<Dim>& query,
+                                            const double* target, size_t& best, double& bestDist) const
+{
+  if (lo >= hi) return;
+
+  size_t mid = lo + (hi - lo - 1) / 2;
+  const double* node = &coords[mid * Dim];
+  double split = target[dim] - node[dim];
+  bool goLeft = split < 0 || (split == 0 && query < points[mid]);
+
+  // The side of the splitting plane holding the query first, then this
+  // node, then the far side if the plane is no farther than the best so far
+  if (goLeft) findNearestImplicitHelper(lo, mid, (dim + 1) % Dim, query, target, best, bestDist);
+  else findNearestImplicitHelper(mid + 1, hi, (dim + 1) % Dim, query, target, best, bestDist);
+
+  double dist = 0;
+  for (int i = 0; i < Dim; i++) dist += (node[i] - target[i]) * (node[i] - target[i]);
+  if (dist < bestDist || (dist == bestDist && points[mid] < points[best])) {
+    best = mid;
+    bestDist = dist;
+  }
+
+  if (split * split <= bestDist) {
+    if (goLeft) findNearestImplicitHelper(mid + 1, hi, (dim + 1) % Dim, query, target, best, bestDist);
+    else findNearestImplicitHelper(lo, mid, (dim + 1) % Dim, query, target, best, bestDist);
+  }
+}
+
 template <int Dim>
 Point<Dim> KDTree<Dim>::findNearestNeighborHelper(KDTreeNode* root, const Point<Dim>& query, int dim) const
 {
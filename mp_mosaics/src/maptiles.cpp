@@ -29,7 +29,7 @@ MosaicCanvas* mapTiles(SourceImage const& theSource,
         tiles_map.insert(pair<Point<3>, TileImage*>(point, new TileImage(theTiles[i])));
     }
 
-    KDTree<3>* kd_tree = new KDTree<3>(points);
+    KDTree<3>* kd_tree = new KDTree<3>(points, KDTree<3>::Layout::Implicit);
     for (int y = 0; y < theSource.getRows(); y++) {
         for (int x = 0; x < theSource.getColumns(); x++) {
             LUVAPixel region_color = theSource.getRegionColor(y, x);
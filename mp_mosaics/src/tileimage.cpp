@@ -40,13 +40,8 @@ PNG TileImage::cropSourceImage(const PNG& source) {
             startX = (width - width) / 2;
     }
 
-    PNG cropped(resolution, resolution);
-
-    for (int y = 0; y < resolution; y++)
-        for (int x = 0; x < resolution; x++)
-            cropped.getPixel(x, y) = source.getPixel(startX + x, startY + y);
-
-    return cropped;
+    PNG::Rect square = { unsigned(startX), unsigned(startY), unsigned(resolution), unsigned(resolution) };
+    return source.crop(square);
 }
 
 LUVAPixel TileImage::calculateAverageColor(unsigned x0, unsigned x1, unsigned y0, unsigned y1) const {
@@ -395,3 +395,51 @@ TEST_CASE("KDTree::findNearestNeighbor (3D), testing that left recursion does no
 
   REQUIRE( tree.findNearestNeighbor(target) == expected );
 }
+
+TEST_CASE("KDTree with the Implicit layout finds the same neighbors as a linear search", "[weight=1][part=1]") {
+  // Coordinates on a small grid, so distances and splits often tie
+  srand(225);
+  vector<Point<3>> points;
+  for (int i = 0; i < 500; i++)
+    points.push_back(Point<3>(rand() % 8, rand() % 8, rand() % 8));
+  KDTree<3> tree(points, KDTree<3>::Layout::Implicit);
+
+  for (int i = 0; i < 500; i++) {
+    Point<3> target(rand() % 8, rand() % 8, rand() % 8);
+    Point<3> expected = points[0];
+    for (const Point<3>& point : points) {
+      if (tree.shouldReplace(target, expected, point))
+        expected = point;
+    }
+    REQUIRE( tree.findNearestNeighbor(target) == expected );
+  }
+
+  KDTree<3> empty(vector<Point<3>>(), KDTree<3>::Layout::Implicit);
+  REQUIRE( empty.findNearestNeighbor(Point<3>(1, 2, 3)) == Point<3>() );
+}
+
+TEST_CASE("KDTree copies with the Implicit layout find the same neighbors", "[weight=1][part=1]") {
+  srand(225);
+  vector<Point<3>> points;
+  for (int i = 0; i < 200; i++)
+    points.push_back(Point<3>(rand() % 8, rand() % 8, rand() % 8));
+  KDTree<3>* tree = new KDTree<3>(points, KDTree<3>::Layout::Implicit);
+
+  KDTree<3> copied(*tree);
+  KDTree<3> assigned(vector<Point<3>>{Point<3>(100, 100, 100)});
+  assigned = *tree;
+  assigned = assigned;
+
+  vector<Point<3>> targets;
+  vector<Point<3>> expected;
+  for (int i = 0; i < 200; i++) {
+    targets.push_back(Point<3>(rand() % 8, rand() % 8, rand() % 8));
+    expected.push_back(tree->findNearestNeighbor(targets.back()));
+  }
+  delete tree;
+
+  for (size_t i = 0; i < targets.size(); i++) {
+    REQUIRE( copied.findNearestNeighbor(targets[i]) == expected[i] );
+    REQUIRE( assigned.findNearestNeighbor(targets[i]) == expected[i] );
+  }
+}
@@ -0,0 +1,540 @@
+#include "Image.h"
+#include "StickerSheet.h"
+#include "lodepng/lodepng.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Heap allocations made so far, counted by the operator new below. The
+ * allocations, stickers and tiles sections report them; counting is two
+ * relaxed atomic adds, cheap next to the malloc, so it stays on for all.
+ */
+static std::atomic<std::size_t> allocationCount(0);
+static std::atomic<std::size_t> allocationBytes(0);
+
+void * operator new(std::size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  allocationBytes.fetch_add(size, std::memory_order_relaxed);
+  void * p = std::malloc(size ? size : 1);
+  if (!p) { throw std::bad_alloc(); }
+  return p;
+}
+
+void * operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::size_t) noexcept { std::free(p); }
+
+/**
+ * Times `op` on a fresh copy of `source` and returns the elapsed milliseconds.
+ */
+double timeIt(const Image & source, std::function<void(Image &)> op) {
+  Image image(source);
+  auto start = std::chrono::steady_clock::now();
+  op(image);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/**
+ * The pre-forEachRow way of writing a filter: column-major getPixel() calls.
+ */
+void lightenPerPixel(Image & image) {
+  for (unsigned int i = 0; i < image.width(); i++) {
+    for (unsigned int j = 0; j < image.height(); j++) {
+      if (image.getPixel(i,j).l + 0.1 > 1)
+        image.getPixel(i,j).l = 1;
+      else
+        image.getPixel(i,j).l += 0.1;
+    }
+  }
+}
+
+/**
+ * Prints the number and total size of the heap allocations made by `op`.
+ */
+void reportAllocations(const std::string & name, std::function<void()> op) {
+  std::size_t count = allocationCount;
+  std::size_t bytes = allocationBytes;
+  op();
+  std::cout << name << ": " << (allocationCount - count) << " allocations, "
+            << ((allocationBytes - bytes) >> 20) << " MB" << std::endl;
+}
+
+void report(const std::string & name, double perPixelMs, double rowMs) {
+  std::cout << name << ": getPixel " << perPixelMs << " ms, forEachRow " << rowMs
+            << " ms (" << (perPixelMs / rowMs) << "x)" << std::endl;
+}
+
+/**
+ * Prints how long writeToFile() takes with each EncodeOptions preset (and
+ * with parallel deflate) and how large the resulting file is.
+ */
+void reportEncoding(const PNG & image) {
+  const std::string fileName = "benchmark-encode.png";
+  EncodeOptions parallel = EncodeOptions::balanced();
+  parallel.parallel = true;
+  std::pair<const char *, EncodeOptions> presets[] = {
+    { "fastest", EncodeOptions::fastest() },
+    { "balanced", EncodeOptions::balanced() },
+    { "balanced+parallel", parallel },
+    { "smallest", EncodeOptions::smallest() }
+  };
+  std::cout << "writeToFile:";
+  for (auto & preset : presets) {
+    PNG copy(image);
+    auto start = std::chrono::steady_clock::now();
+    copy.writeToFile(fileName, preset.second);
+    auto end = std::chrono::steady_clock::now();
+    std::ifstream written(fileName, std::ios::binary | std::ios::ate);
+    std::cout << " " << preset.first << " "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms, "
+              << (static_cast<std::size_t>(written.tellg()) >> 10) << " KB;";
+  }
+  std::cout << std::endl;
+  std::remove(fileName.c_str());
+}
+
+/**
+ * Prints how long operator== takes on two equal images, the first time
+ * (digests computed) and again (digest of `expected` cached).
+ */
+void reportEquality(const PNG & expected, const PNG & actual) {
+  std::cout << "operator==:";
+  for (const char * pass : {"first", "cached"}) {
+    auto start = std::chrono::steady_clock::now();
+    bool equal = (expected == actual);
+    auto end = std::chrono::steady_clock::now();
+    std::cout << " " << pass << " " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms" << (equal ? "" : " (not equal!)") << ";";
+  }
+  std::cout << std::endl;
+}
+
+/**
+ * Lists the .png files in `directory`.
+ */
+std::vector<std::string> listPngFiles(const std::string & directory) {
+  std::vector<std::string> files;
+  if (DIR * dir = opendir(directory.c_str())) {
+    while (dirent * entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".png") == 0) {
+        files.push_back(directory + "/" + name);
+      }
+    }
+    closedir(dir);
+  }
+  return files;
+}
+
+/**
+ * Prints how many megabytes of RGBA pixels per second lodepng decodes from
+ * the given files (already in memory), best of three passes.
+ */
+void reportDecoding(const std::vector<std::string> & files) {
+  std::vector<std::vector<unsigned char>> encoded(files.size());
+  for (std::size_t i = 0; i < files.size(); i++) { lodepng::load_file(encoded[i], files[i]); }
+
+  double best = 0;
+  std::size_t bytes = 0;
+  for (int pass = 0; pass < 3; pass++) {
+    bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const std::vector<unsigned char> & png : encoded) {
+      std::vector<unsigned char> pixels;
+      unsigned w, h;
+      lodepng::decode(pixels, w, h, png);
+      bytes += pixels.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if (pass == 0 || ms < best) { best = ms; }
+  }
+  std::cout << "decode " << files.size() << " files: " << (bytes / 1000.0 / best)
+            << " MB/s" << std::endl;
+}
+
+/**
+ * Decodes every .png file in `directory`, first by reading each file into a
+ * heap buffer (lodepng::load_file()), then through readFromFile()'s memory
+ * mapping, and finally through the ImageCache (the first pass fills it, so
+ * the best pass is a warm start), and prints the best of three passes for each.
+ */
+void benchmarkTileLoading(const std::string & directory) {
+  std::vector<std::string> files = listPngFiles(directory);
+  if (files.empty()) {
+    std::cout << "No .png files in " << directory << std::endl;
+    return;
+  }
+
+  auto bestOf = [&files](std::function<void(const std::string &)> load) {
+    double best = 0;
+    std::size_t bytes = 0;
+    for (int pass = 0; pass < 3; pass++) {
+      std::size_t before = allocationBytes;
+      auto start = std::chrono::steady_clock::now();
+      for (const std::string & file : files) { load(file); }
+      auto end = std::chrono::steady_clock::now();
+      double ms = std::chrono::duration<double, std::milli>(end - start).count();
+      if (pass == 0 || ms < best) { best = ms; }
+      bytes = allocationBytes - before;
+    }
+    return std::make_pair(best, bytes);
+  };
+
+  auto heap = bestOf([](const std::string & file) {
+    std::vector<unsigned char> data;
+    lodepng::load_file(data, file);
+    PNG image;
+    image.readFromMemory(data.data(), data.size());
+  });
+  auto mapped = bestOf([](const std::string & file) {
+    PNG image;
+    image.readFromFile(file);
+  });
+  auto cached = bestOf([](const std::string & file) {
+    PNG image;
+    image.readFromFile(file, true);
+  });
+
+  std::cout << "load " << files.size() << " tiles: heap copy " << heap.first << " ms ("
+            << (heap.second >> 20) << " MB allocated), mmap " << mapped.first << " ms ("
+            << (mapped.second >> 20) << " MB allocated), cached " << cached.first << " ms ("
+            << (cached.second >> 20) << " MB allocated)" << std::endl;
+}
+
+/** What the sections below work on, from the command line. */
+struct Options {
+  unsigned width = 4000;      /**< Size of the synthetic image. */
+  unsigned height = 3000;
+  std::string tileDirectory;  /**< Directory of tiles to load, if any. */
+};
+
+/**
+ * The synthetic image most sections work on: flat teal, width x height.
+ * Made on first use, so sections that don't need it don't pay for it.
+ */
+const Image & sourceImage(const Options & options) {
+  static const Image source = [&options]() {
+    Image image;
+    image.resize(options.width, options.height);
+    image.transform([](HSLAPixel & pixel) {
+      pixel.h = 180;
+      pixel.s = 0.5;
+      pixel.l = 0.5;
+    });
+    return image;
+  }();
+  return source;
+}
+
+/**
+ * Compares the Image filters against equivalent getPixel() loops, and
+ * separate filter passes against one pipeline().
+ */
+void benchmarkFilters(const Options & options) {
+  const Image & source = sourceImage(options);
+
+  report("lighten", timeIt(source, lightenPerPixel),
+         timeIt(source, [](Image & image) { image.lighten(); }));
+
+  report("grayscale",
+         timeIt(source, [](Image & image) {
+           for (unsigned x = 0; x < image.width(); x++)
+             for (unsigned y = 0; y < image.height(); y++)
+               image.getPixel(x, y).s = 0;
+         }),
+         timeIt(source, [](Image & image) { image.grayscale(); }));
+
+  report("rotateColor",
+         timeIt(source, [](Image & image) {
+           for (unsigned x = 0; x < image.width(); x++)
+             for (unsigned y = 0; y < image.height(); y++) {
+               HSLAPixel & pixel = image.getPixel(x, y);
+               pixel.h += 90;
+               if (pixel.h >= 360) { pixel.h -= 360; }
+             }
+         }),
+         timeIt(source, [](Image & image) { image.rotateColor(90); }));
+
+  double separate = timeIt(source, [](Image & image) {
+    image.lighten();
+    image.saturate(0.2);
+    image.rotateColor(90);
+    image.darken(0.05);
+    image.desaturate();
+  });
+  double fused = timeIt(source, [](Image & image) {
+    image.pipeline().lighten().saturate(0.2).rotateColor(90).darken(0.05).desaturate().apply();
+  });
+  std::cout << "5 filters: one pass each " << separate << " ms, pipeline() " << fused
+            << " ms (" << (separate / fused) << "x)" << std::endl;
+}
+
+/**
+ * Times scale(0.25) with each ResampleFilter.
+ */
+void benchmarkScale(const Options & options) {
+  const Image & source = sourceImage(options);
+
+  std::cout << "scale(0.25):";
+  std::pair<const char *, ResampleFilter> filters[] = {
+    { "nearest", ResampleFilter::Nearest },
+    { "bilinear", ResampleFilter::Bilinear },
+    { "bicubic", ResampleFilter::Bicubic },
+    { "lanczos", ResampleFilter::Lanczos }
+  };
+  for (auto & filter : filters) {
+    ResampleFilter f = filter.second;
+    std::cout << " " << filter.first << " "
+              << timeIt(source, [f](Image & image) { image.scale(0.25, f); }) << " ms;";
+  }
+  std::cout << std::endl;
+}
+
+/**
+ * Counts the heap allocations of common operations on shareable images.
+ */
+void benchmarkAllocations(const Options & options) {
+  unsigned width = options.width, height = options.height;
+  // Fresh copies that never hand out mutable access, so they can be shared
+  const Image base(sourceImage(options));
+  Image sticker;
+  sticker.resize(width / 4, height / 4);
+  Image stickerBase(sticker);
+
+  reportAllocations("Image::scale", [&base]() {
+    Image image(base);
+    image.scale(0.5);
+  });
+  reportAllocations("StickerSheet::render", [&]() {
+    StickerSheet sheet(base, 3);
+    sheet.addSticker(stickerBase, 0, 0);
+    sheet.addSticker(stickerBase, width / 2, height / 2);
+    Image rendered = sheet.render();
+  });
+  reportAllocations("StickerSheet stamping one sticker 256 times, then copied", [&sticker]() {
+    Image small(sticker);
+    small.resize(64, 64);
+    StickerSheet sheet(small, 256);
+    for (unsigned i = 0; i < 256; i++) { sheet.addSticker(sticker, i, i); }
+    StickerSheet copy(sheet);
+  });
+  reportAllocations("PNG::resize, growing 64 times after reserve", [width, height]() {
+    PNG image;
+    image.reserve(std::size_t(width) * height);
+    for (unsigned i = 1; i <= 64; i++) { image.resize(width * i / 64, height * i / 64); }
+  });
+  reportAllocations("vector<PNG> of frames", [&stickerBase]() {
+    std::vector<PNG> frames;
+    for (unsigned i = 0; i < 16; i++) { frames.push_back(stickerBase); }
+  });
+}
+
+/**
+ * Times re-rendering a sheet as one sticker is dragged around it, and
+ * rendering a sheet of 100k stickers in tiles.
+ */
+void benchmarkStickers(const Options & options) {
+  unsigned width = options.width, height = options.height;
+  const Image & base = sourceImage(options);
+  Image sticker;
+  sticker.resize(width / 4, height / 4);
+
+  for (bool blend : {false, true}) {
+    // An editor dragging one sticker around a busy sheet, re-rendering each step
+    StickerSheet sheet(base, 64);
+    sheet.setAlphaBlending(blend);
+    for (unsigned i = 0; i < 64; i++) {
+      sheet.addSticker(sticker, (i % 8) * (width / 8), (i / 8) * (height / 8));
+    }
+    auto start = std::chrono::steady_clock::now();
+    Image first = sheet.render();
+    auto rendered = std::chrono::steady_clock::now();
+    for (unsigned step = 1; step <= 10; step++) {
+      sheet.translate(0, step * 8, step * 8);
+      Image frame = sheet.render();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "StickerSheet drag" << (blend ? " (alpha blending)" : "") << ": first render "
+              << std::chrono::duration<double, std::milli>(rendered - start).count() << " ms, then "
+              << (std::chrono::duration<double, std::milli>(end - rendered).count() / 10) << " ms per step"
+              << std::endl;
+  }
+
+  // 100k small stickers over a sheet twice the image's size each way,
+  // rendered in tiles that are dropped as soon as they are done
+  Image dot;
+  dot.resize(16, 16);
+  Image small;
+  small.resize(64, 64);
+  StickerSheet sheet(small, 100000);
+  for (unsigned i = 0; i < 100000; i++) {
+    sheet.addSticker(dot, (i * 7919u) % (2 * width - 16), (i * 104729u) % (2 * height - 16));
+  }
+  std::atomic<std::size_t> pixels(0);
+  std::size_t bytes = allocationBytes;
+  auto start = std::chrono::steady_clock::now();
+  sheet.renderTiles(512, [&pixels](const PNG::Rect & rect, const Image &) {
+    pixels += std::size_t(rect.width) * rect.height;
+  });
+  auto tiled = std::chrono::steady_clock::now();
+  Image region = sheet.renderRegion(PNG::Rect{ width / 2, height / 2, 512, 512 });
+  auto end = std::chrono::steady_clock::now();
+  std::cout << "StickerSheet of 100k stickers: renderTiles(512) "
+            << std::chrono::duration<double, std::milli>(tiled - start).count() << " ms for "
+            << (pixels >> 20) << " Mpixels, " << ((allocationBytes - bytes) >> 20)
+            << " MB allocated in total; one 512x512 renderRegion "
+            << std::chrono::duration<double, std::milli>(end - tiled).count() << " ms" << std::endl;
+}
+
+/**
+ * Compares blitting a round sticker with an alpha test per pixel against
+ * copying the opaque spans of its SpanMask.
+ */
+void benchmarkBlit(const Options & options) {
+  const Image & base = sourceImage(options);
+
+  // A round sticker: opaque disc, transparent corners
+  Image disc;
+  disc.resize(options.width / 4, options.height / 4);
+  double radius = std::min(disc.width(), disc.height()) / 2.0;
+  for (unsigned y = 0; y < disc.height(); y++) {
+    HSLAPixel * row = disc.row(y);
+    for (unsigned x = 0; x < disc.width(); x++) {
+      double dx = x + 0.5 - disc.width() / 2.0, dy = y + 0.5 - disc.height() / 2.0;
+      row[x].a = (dx * dx + dy * dy <= radius * radius) ? 1 : 0;
+    }
+  }
+  SpanMask mask(disc);
+  PNG::Rect all = { 0, 0, disc.width(), disc.height() };
+  double perPixel = timeIt(base, [&](Image & image) {
+    for (unsigned i = 0; i < 16; i++) { image.blit(disc, all, i * 8, i * 8, true); }
+  });
+  double spans = timeIt(base, [&](Image & image) {
+    for (unsigned i = 0; i < 16; i++) { image.blit(disc, mask, all, i * 8, i * 8); }
+  });
+  std::cout << "Blit a round sticker 16 times: alpha test per pixel " << perPixel
+            << " ms, opaque spans " << spans << " ms (" << (perPixel / spans) << "x)" << std::endl;
+}
+
+/**
+ * Times operator== on two equal images.
+ */
+void benchmarkEquality(const Options & options) {
+  const Image & base = sourceImage(options);
+  reportEquality(base, Image(base));
+}
+
+/**
+ * Times encoding ../alma.png with each EncodeOptions preset.
+ */
+void benchmarkEncoding(const Options &) {
+  Image photo;
+  if (photo.readFromFile("../alma.png")) {
+    reportEncoding(photo);
+  } else {
+    std::cout << "encode: ../alma.png not found" << std::endl;
+  }
+}
+
+/**
+ * Measures lodepng's decoding throughput on the tiles, or the .png files in ..
+ */
+void benchmarkDecoding(const Options & options) {
+  reportDecoding(listPngFiles(options.tileDirectory.empty() ? ".." : options.tileDirectory));
+}
+
+/**
+ * Times loading the tiles from the heap, through mmap and from the ImageCache.
+ */
+void benchmarkTiles(const Options & options) {
+  if (options.tileDirectory.empty()) {
+    std::cout << "tiles: no --tiles directory given" << std::endl;
+    return;
+  }
+  benchmarkTileLoading(options.tileDirectory);
+}
+
+/** A part of the benchmark that can be run on its own. */
+struct Section {
+  const char * name;
+  const char * description;
+  void (*run)(const Options &);
+};
+
+const Section sections[] = {
+  { "filters", "Image filters against getPixel() loops, and pipeline()", benchmarkFilters },
+  { "scale", "scale(0.25) with each resampling filter", benchmarkScale },
+  { "allocations", "heap allocations of copies, renders and resizes", benchmarkAllocations },
+  { "stickers", "dragging a sticker, and rendering 100k stickers in tiles", benchmarkStickers },
+  { "blit", "blitting a round sticker per pixel and by spans", benchmarkBlit },
+  { "equality", "operator== and digest() on equal images", benchmarkEquality },
+  { "encode", "writeToFile() with each EncodeOptions preset", benchmarkEncoding },
+  { "decode", "lodepng decoding throughput", benchmarkDecoding },
+  { "tiles", "loading a directory of tiles: heap, mmap and ImageCache", benchmarkTiles }
+};
+
+/**
+ * Prints the command line options and the sections to stderr.
+ */
+void printUsage(const char * program) {
+  std::cerr << "Usage: " << program << " [--size WIDTHxHEIGHT] [--tiles DIRECTORY] [SECTION...]" << std::endl
+            << "Runs the given sections, or all of them; the image is 4000x3000 by default, and" << std::endl
+            << "decode reads the tiles (or the .png files in ..). Sections:" << std::endl;
+  for (const Section & section : sections) {
+    std::cerr << "  " << section.name << std::string(14 - std::string(section.name).size(), ' ')
+              << section.description << std::endl;
+  }
+}
+
+/**
+ * Runs the benchmark sections named on the command line, or all of them.
+ * Usage: ./benchmark [--size WIDTHxHEIGHT] [--tiles DIRECTORY] [SECTION...]
+ */
+int main(int argc, char *argv[]) {
+  Options options;
+  std::vector<const Section *> selected;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--size" && i + 1 < argc) {
+      if (std::sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2
+          || options.width < 16 || options.height < 16) {
+        printUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--tiles" && i + 1 < argc) {
+      options.tileDirectory = argv[++i];
+    } else {
+      auto found = std::find_if(std::begin(sections), std::end(sections),
+                                [&arg](const Section & section) { return arg == section.name; });
+      if (found == std::end(sections)) {
+        printUsage(argv[0]);
+        return 1;
+      }
+      selected.push_back(found);
+    }
+  }
+  if (selected.empty()) {
+    for (const Section & section : sections) { selected.push_back(&section); }
+  }
+
+  std::cout << "Image: " << options.width << "x" << options.height << std::endl;
+  for (const Section * section : selected) { section->run(options); }
+  return 0;
+}
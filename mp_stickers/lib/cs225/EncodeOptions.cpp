@@ -0,0 +1,57 @@
+/**
+ * @file EncodeOptions.cpp
+ * Presets for cs225::EncodeOptions.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include "lodepng/lodepng.h"
+#include "EncodeOptions.h"
+#include "ParallelDeflate.h"
+
+namespace cs225 {
+  EncodeOptions EncodeOptions::fastest() {
+    EncodeOptions options;
+    options.filter = Filter::None;
+    options.compression = Compression::RunLength;
+    options.lazyMatching = false;
+    options.autoConvert = false;
+    return options;
+  }
+
+  EncodeOptions EncodeOptions::balanced() {
+    return EncodeOptions();
+  }
+
+  EncodeOptions EncodeOptions::smallest() {
+    EncodeOptions options;
+    options.filter = Filter::BruteForce;
+    options.windowSize = 32768;
+    options.niceMatch = 258;
+    return options;
+  }
+
+  void applyEncodeOptions(EncodeOptions const & options, LodePNGEncoderSettings & settings) {
+    switch (options.filter) {
+      case EncodeOptions::Filter::None: settings.filter_strategy = LFS_ZERO; break;
+      case EncodeOptions::Filter::MinSum: settings.filter_strategy = LFS_MINSUM; break;
+      case EncodeOptions::Filter::BruteForce: settings.filter_strategy = LFS_BRUTE_FORCE; break;
+    }
+    switch (options.compression) {
+      case EncodeOptions::Compression::Stored:
+        settings.zlibsettings.btype = 0;
+        break;
+      case EncodeOptions::Compression::RunLength:
+        // A 4 byte window matches repeats of the previous byte or RGBA pixel
+        settings.zlibsettings.windowsize = 4;
+        break;
+      case EncodeOptions::Compression::LZ77:
+        settings.zlibsettings.windowsize = options.windowSize;
+        break;
+    }
+    settings.zlibsettings.nicematch = options.niceMatch;
+    settings.zlibsettings.lazymatching = options.lazyMatching;
+    settings.auto_convert = options.autoConvert;
+    if (options.parallel) { settings.zlibsettings.custom_zlib = parallelZlibCompress; }
+  }
+}
@@ -0,0 +1,73 @@
+/**
+ * @file MappedFile.cpp
+ * Implementation of a read-only memory-mapped file.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CS225_HAVE_MMAP 1
+#endif
+
+#include "MappedFile.h"
+
+namespace cs225 {
+  MappedFile::MappedFile(std::string const & fileName)
+    : data_(nullptr), size_(0), open_(false), mapped_(false) {
+#ifdef CS225_HAVE_MMAP
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+      size_ = static_cast<std::size_t>(info.st_size);
+      if (size_ == 0) {
+        open_ = true;
+      } else {
+        void * region = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (region != MAP_FAILED) {
+          // The decoder walks the file once, front to back
+          ::madvise(region, size_, MADV_SEQUENTIAL);
+          ::madvise(region, size_, MADV_WILLNEED);
+          data_ = static_cast<const unsigned char *>(region);
+          open_ = mapped_ = true;
+        }
+      }
+    }
+    ::close(fd);
+    if (open_) { return; }
+#endif
+
+    std::ifstream file(fileName, std::ios::in | std::ios::binary);
+    if (!file) { return; }
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    open_ = true;
+  }
+
+  MappedFile::~MappedFile() {
+#ifdef CS225_HAVE_MMAP
+    if (mapped_) { ::munmap(const_cast<unsigned char *>(data_), size_); }
+#endif
+  }
+
+  bool MappedFile::isOpen() const {
+    return open_;
+  }
+
+  const unsigned char * MappedFile::data() const {
+    return data_;
+  }
+
+  std::size_t MappedFile::size() const {
+    return size_;
+  }
+}
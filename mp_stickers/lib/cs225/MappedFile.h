@@ -0,0 +1,59 @@
+/**
+ * @file MappedFile.h
+ * Read-only, memory-mapped view of a whole file.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cs225 {
+  class MappedFile {
+  public:
+    /**
+      * Maps the given file read-only, hinting to the kernel that it will
+      * be read front to back. Where mmap() is not available (or fails, e.g.
+      * for a pipe) the file is read into a heap buffer instead, so callers
+      * only need to check isOpen().
+      * @param fileName Name of the file to map.
+      */
+    explicit MappedFile(std::string const & fileName);
+
+    /**
+      * Destructor: unmaps the file.
+      */
+    ~MappedFile();
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator= (MappedFile const &) = delete;
+
+    /**
+      * Gets whether the file was opened successfully.
+      * @return true, if data() holds the contents of the file.
+      */
+    bool isOpen() const;
+
+    /**
+      * Gets the contents of the file. Valid for the lifetime of this object.
+      * @return Pointer to the first byte of the file.
+      */
+    const unsigned char * data() const;
+
+    /**
+      * Gets the size of the file.
+      * @return Number of bytes in the file.
+      */
+    std::size_t size() const;
+
+  private:
+    const unsigned char * data_;         /*< Start of the file contents */
+    std::size_t size_;                   /*< Size of the file in bytes */
+    bool open_;                          /*< Whether the file was opened */
+    bool mapped_;                        /*< Whether data_ is an mmap() region */
+    std::vector<unsigned char> buffer_;  /*< Fallback copy when not mapped */
+  };
+}
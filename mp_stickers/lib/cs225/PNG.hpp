@@ -0,0 +1,18 @@
+/**
+ * @file PNG.hpp
+ * Implementation of the templated members of the PNG class.
+ *
+ * @author CS 225: Data Structures
+ */
+
+namespace cs225 {
+  template <typename PixelKernel>
+  void PNG::transform(PixelKernel kernel) {
+    unsigned int width = width_;
+    forEachRow([&kernel, width](unsigned int y, HSLAPixel * row) {
+      for (unsigned int x = 0; x < width; x++) {
+        kernel(row[x]);
+      }
+    });
+  }
+}
@@ -0,0 +1,226 @@
+/**
+ * @file PNGStream.cpp
+ * Implementation of row-by-row PNG reading and writing.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "lodepng/lodepng.h"
+#include "MappedFile.h"
+#include "ParallelDeflate.h"
+#include "PNGStream.h"
+#include "RGB_HSL_Batch.h"
+
+using std::cerr;
+using std::endl;
+
+namespace cs225 {
+  PNGReader::PNGReader() : width_(0), height_(0) { }
+
+  PNGReader::~PNGReader() { }
+
+  bool PNGReader::open(std::string const & fileName) {
+    file_.reset(new MappedFile(fileName));
+    width_ = height_ = 0;
+    if (!file_->isOpen()) {
+      cerr << "PNG decoder error 78: " << lodepng_error_text(78) << endl;
+      file_.reset();
+      return false;
+    }
+
+    lodepng::State state;
+    unsigned error = lodepng_inspect(&width_, &height_, &state, file_->data(), file_->size());
+    if (error) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      file_.reset();
+      return false;
+    }
+    return true;
+  }
+
+  unsigned int PNGReader::width() const {
+    return width_;
+  }
+
+  unsigned int PNGReader::height() const {
+    return height_;
+  }
+
+  /** What lodepng_decode_scanlines() hands each batch of rows to. */
+  struct RowReader {
+    PNGReader::RowFunction const * fn;
+    std::vector<HSLAPixel> row;
+    bool stopped;
+  };
+
+  static unsigned readBatch(void * user, unsigned y, unsigned count, const unsigned char * rows) {
+    RowReader & reader = *static_cast<RowReader *>(user);
+    std::size_t width = reader.row.size();
+    for (unsigned r = 0; r < count; r++) {
+      rgba2hslaBatch(rows + (r * width * 4), reader.row.data(), width);
+      if (!(*reader.fn)(y + r, reader.row.data())) {
+        reader.stopped = true;
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  bool PNGReader::readRows(RowFunction const & fn) {
+    if (!file_) { return false; }
+
+    RowReader reader = { &fn, std::vector<HSLAPixel>(width_), false };
+    lodepng::State state;
+    unsigned width, height;
+    unsigned error = lodepng_decode_scanlines(&width, &height, &state, file_->data(), file_->size(),
+                                              readBatch, &reader);
+    if (error && !reader.stopped) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+    }
+    return (error == 0);
+  }
+
+  PNGWriter::PNGWriter() : file_(NULL), width_(0), height_(0), rows_(0), failed_(false),
+                           dictionary_(0), adler_(1), headerWritten_(false) { }
+
+  PNGWriter::~PNGWriter() {
+    if (file_) { std::fclose(file_); }
+  }
+
+  bool PNGWriter::open(std::string const & fileName, unsigned int width, unsigned int height,
+                       EncodeOptions const & options) {
+    if (file_) { std::fclose(file_); }
+    file_ = std::fopen(fileName.c_str(), "wb");
+    if (!file_) {
+      cerr << "PNG encoding error 79: " << lodepng_error_text(79) << endl;
+      return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    rows_ = 0;
+    options_ = options;
+    failed_ = false;
+    current_.assign(std::size_t(width) * 4, 0);
+    previous_.assign(std::size_t(width) * 4, 0);
+    pending_.clear();
+    dictionary_ = 0;
+    adler_ = 1;
+    headerWritten_ = false;
+
+    // Signature, then IHDR: 8-bit RGBA, not interlaced
+    const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    failed_ = std::fwrite(signature, 1, 8, file_) != 8;
+    unsigned char header[13] = {
+      (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+      (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+      8, 6, 0, 0, 0
+    };
+    _writeChunk("IHDR", header, sizeof(header));
+    return !failed_;
+  }
+
+  bool PNGWriter::writeRow(const HSLAPixel * row) {
+    if (!file_ || failed_ || rows_ == height_) { return false; }
+
+    hsla2rgbaBatch(row, current_.data(), width_);
+    _filterRow();
+    current_.swap(previous_);
+    rows_++;
+
+    if (pending_.size() - dictionary_ >= deflateBlockSize) { _deflate(false); }
+    return !failed_;
+  }
+
+  bool PNGWriter::close() {
+    if (!file_) { return false; }
+    bool complete = (rows_ == height_);
+    if (!complete) {
+      cerr << "PNG encoding error: only " << rows_ << " of " << height_ << " rows were written" << endl;
+    } else {
+      _deflate(true);
+      _writeChunk("IEND", NULL, 0);
+    }
+    failed_ |= std::fclose(file_) != 0;
+    file_ = NULL;
+    return complete && !failed_;
+  }
+
+  /** The lodepng settings PNGWriter filters and deflates with. */
+  static LodePNGEncoderSettings encoderSettings(EncodeOptions const & options) {
+    LodePNGEncoderSettings settings;
+    lodepng_encoder_settings_init(&settings);
+    applyEncodeOptions(options, settings);
+    settings.zlibsettings.custom_zlib = NULL;
+    return settings;
+  }
+
+  void PNGWriter::_filterRow() {
+    // The filter type byte and filtered row go straight onto pending_
+    LodePNGEncoderSettings settings = encoderSettings(options_);
+    std::size_t bytes = std::size_t(width_) * 4;
+    std::size_t end = pending_.size();
+    pending_.resize(end + 1 + bytes);
+    unsigned error = lodepng_filter_scanline(pending_.data() + end, current_.data(),
+                                             (rows_ == 0) ? NULL : previous_.data(), bytes, 4,
+                                             settings.filter_strategy, &settings.zlibsettings);
+    if (error) {
+      cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+      failed_ = true;
+    }
+  }
+
+  bool PNGWriter::_deflate(bool final) {
+    LodePNGEncoderSettings settings = encoderSettings(options_);
+    unsigned char * deflated = NULL;
+    std::size_t deflatedSize = 0;
+    unsigned error = lodepng_deflate_chunk(&deflated, &deflatedSize, pending_.data(), dictionary_,
+                                           pending_.size(), final ? 1 : 0, &settings.zlibsettings);
+    if (error) {
+      cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+      std::free(deflated);
+      failed_ = true;
+      return false;
+    }
+
+    std::size_t length = pending_.size() - dictionary_;
+    adler_ = lodepng_adler32_combine(adler_, lodepng_adler32(pending_.data() + dictionary_, length), length);
+
+    // The zlib header goes before the first block and the Adler32 of
+    // everything after the final one
+    std::size_t header = headerWritten_ ? 0 : zlibHeaderSize;
+    std::size_t trailer = final ? zlibTrailerSize : 0;
+    std::vector<unsigned char> data(header + deflatedSize + trailer);
+    unsigned char * p = data.data();
+    if (header) { p = writeZlibHeader(p); }
+    p = std::copy(deflated, deflated + deflatedSize, p);
+    if (final) { writeZlibTrailer(p, adler_); }
+    std::free(deflated);
+    headerWritten_ = true;
+    _writeChunk("IDAT", data.data(), data.size());
+
+    // Keep the last 32 KB as the next block's dictionary
+    std::size_t keep = std::min(pending_.size(), deflateDictionarySize);
+    pending_.erase(pending_.begin(), pending_.end() - keep);
+    dictionary_ = keep;
+    return !failed_;
+  }
+
+  bool PNGWriter::_writeChunk(const char * type, const unsigned char * data, std::size_t size) {
+    unsigned char * chunk = NULL;
+    std::size_t chunkSize = 0;
+    unsigned error = lodepng_chunk_create(&chunk, &chunkSize, (unsigned)size, type, data);
+    if (error) {
+      cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+      failed_ = true;
+    } else {
+      failed_ |= std::fwrite(chunk, 1, chunkSize, file_) != chunkSize;
+    }
+    std::free(chunk);
+    return !failed_;
+  }
+}
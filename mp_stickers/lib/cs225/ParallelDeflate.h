@@ -0,0 +1,66 @@
+/**
+ * @file ParallelDeflate.h
+ * Multithreaded zlib compression for the lodepng encoder, and the block
+ * sizes and zlib framing it shares with PNGWriter.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+
+struct LodePNGCompressSettings;
+
+namespace cs225 {
+  /** Bytes of input deflated per block (the pigz default). */
+  const std::size_t deflateBlockSize = 131072;
+
+  /** Bytes of preceding input each block may refer back to. */
+  const std::size_t deflateDictionarySize = 32768;
+
+  /** Bytes of the zlib header written by writeZlibHeader(). */
+  const std::size_t zlibHeaderSize = 2;
+
+  /** Bytes of the zlib trailer written by writeZlibTrailer(). */
+  const std::size_t zlibTrailerSize = 4;
+
+  /**
+   * Writes the zlib header lodepng writes: deflate with a 32K window and
+   * no preset dictionary.
+   * @param out Where to write zlibHeaderSize bytes.
+   * @return The byte after the header.
+   */
+  unsigned char * writeZlibHeader(unsigned char * out);
+
+  /**
+   * Writes the zlib trailer: the big-endian Adler32 of the uncompressed
+   * data.
+   * @param out Where to write zlibTrailerSize bytes.
+   * @param adler Adler32 of all the data in the stream.
+   * @return The byte after the trailer.
+   */
+  unsigned char * writeZlibTrailer(unsigned char * out, unsigned adler);
+
+  /**
+   * Compresses `in` into a zlib stream, pigz-style: the input is cut into
+   * 128 KB blocks that are deflated independently on ThreadPool::shared(),
+   * each primed with the 32 KB before it and ended with a sync flush, and
+   * the per-block Adler32 checksums are combined for the trailer. The
+   * result decodes with any standard inflater, and is usually within a
+   * fraction of a percent of the single-threaded size.
+   *
+   * Has the signature of LodePNGCompressSettings::custom_zlib, so it can
+   * be plugged into the encoder; the other compression settings are used
+   * for every block.
+   * @param out Output buffer, reallocated with the stream appended.
+   * @param outsize Size of the output buffer in bytes.
+   * @param in Data to compress.
+   * @param insize Number of bytes of data.
+   * @param settings lodepng compression settings.
+   * @return The lodepng error code, 0 on success.
+   */
+  unsigned parallelZlibCompress(unsigned char ** out, std::size_t * outsize,
+                                const unsigned char * in, std::size_t insize,
+                                const LodePNGCompressSettings * settings);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file PixelFormat.h
+ * Backing storage formats for the pixels of a cs225::PNG.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "HSLAPixel.h"
+
+namespace cs225 {
+  /**
+   * Layout used to store the pixels of a PNG in memory.
+   *
+   * HSLA64 is the working format: one HSLAPixel (four doubles, 32 bytes)
+   * per pixel, which is what getPixel() hands out references into. The
+   * other formats are compact "at rest" formats that trade precision for
+   * memory and are converted to and from HSLAPixels only at the boundary.
+   */
+  enum class PixelFormat {
+    HSLA64,           /**< Interleaved HSLAPixels, 32 bytes per pixel. */
+    RGBA8,            /**< Interleaved 8-bit RGBA, 4 bytes per pixel. Lossless for decoded files. */
+    HSLA32,           /**< Interleaved float h, s, l, a, 16 bytes per pixel. */
+    HSLA32_PLANAR     /**< Four float planes (all h, then s, l, a), 16 bytes per pixel. */
+  };
+
+  /**
+   * Number of bytes each pixel occupies in the given format.
+   * @param format Storage format.
+   * @return Bytes per pixel.
+   */
+  std::size_t bytesPerPixel(PixelFormat format);
+
+  /**
+   * Converts `count` HSLAPixels into pixels [first, first + count) of a
+   * compact buffer holding `total` pixels in the given format.
+   * @param format Compact format to write (not HSLA64).
+   * @param src Pixels to convert.
+   * @param dst Compact buffer of total * bytesPerPixel(format) bytes.
+   * @param first Index of the first pixel to write.
+   * @param count Number of pixels to write.
+   * @param total Number of pixels in the whole buffer (the plane size).
+   */
+  void packPixels(PixelFormat format, const HSLAPixel * src, unsigned char * dst,
+                  std::size_t first, std::size_t count, std::size_t total);
+
+  /**
+   * Converts pixels [first, first + count) of a compact buffer holding
+   * `total` pixels back into HSLAPixels.
+   * @param format Compact format to read (not HSLA64).
+   * @param src Compact buffer written by packPixels().
+   * @param dst Destination array of at least `count` pixels.
+   * @param first Index of the first pixel to read.
+   * @param count Number of pixels to read.
+   * @param total Number of pixels in the whole buffer (the plane size).
+   */
+  void unpackPixels(PixelFormat format, const unsigned char * src, HSLAPixel * dst,
+                    std::size_t first, std::size_t count, std::size_t total);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file SpanMask.cpp
+ * Implementation of opaque-span masks.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include "SpanMask.h"
+#include "PNG.h"
+
+namespace cs225 {
+  SpanMask::SpanMask() : width_(0), height_(0), rows_(1, 0) { }
+
+  SpanMask::SpanMask(PNG const & image) : width_(image.width()), height_(image.height()) {
+    rows_.reserve(height_ + 1);
+    for (unsigned y = 0; y < height_; y++) {
+      rows_.push_back(spans_.size());
+      const HSLAPixel * row = image.row(y);
+      unsigned x = 0;
+      while (x < width_) {
+        while (x < width_ && row[x].a == 0) { x++; }
+        if (x == width_) { break; }
+        unsigned begin = x;
+        while (x < width_ && row[x].a != 0) { x++; }
+        spans_.push_back(Span{begin, x});
+      }
+    }
+    rows_.push_back(spans_.size());
+  }
+
+  unsigned int SpanMask::width() const {
+    return width_;
+  }
+
+  unsigned int SpanMask::height() const {
+    return height_;
+  }
+
+  const SpanMask::Span * SpanMask::rowBegin(unsigned int y) const {
+    return spans_.data() + rows_[y];
+  }
+
+  const SpanMask::Span * SpanMask::rowEnd(unsigned int y) const {
+    return spans_.data() + rows_[y + 1];
+  }
+
+  double SpanMask::coverage() const {
+    if (width_ == 0 || height_ == 0) { return 0; }
+    std::size_t opaque = 0;
+    for (const Span & span : spans_) { opaque += span.end - span.begin; }
+    return double(opaque) / (double(width_) * height_);
+  }
+}
@@ -1,156 +1,189 @@
 #include "Image.h"
+#include <algorithm>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 void Image::lighten() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).l + 0.1 > 1)
-                getPixel(i,j).l = 1;
-            else
-                getPixel(i,j).l += 0.1;
-        }
-    }
+    pipeline().lighten().apply();
 }
 
 void Image::lighten(double amount) {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).l + amount > 1)
-                getPixel(i,j).l = 1;
-            else if (getPixel(i,j).l + amount < 0)
-                getPixel(i,j).l = 0;
-            else
-                getPixel(i,j).l += amount;
-        }
-    }
+    pipeline().lighten(amount).apply();
 }
 
 void Image::darken() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).l - 0.1 < 0)
-                getPixel(i,j).l = 0;
-            else
-                getPixel(i,j).l -= 0.1;
-        }
-    }
+    pipeline().darken().apply();
 }
 
 void Image::darken(double amount) {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).l - amount < 0)
-                getPixel(i,j).l = 0;
-            else if (getPixel(i,j).l - amount > 1)
-                getPixel(i,j).l = 1;
-            else
-                getPixel(i,j).l -= amount;
-        }
-    }
+    pipeline().darken(amount).apply();
 }
 
 void Image::saturate() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).s + 0.1 > 1)
-                getPixel(i,j).s = 1;
-            else
-                getPixel(i,j).s += 0.1;
-        }
-    }
+    pipeline().saturate().apply();
 }
 
 void Image::saturate(double amount) {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).s + amount > 1)
-                getPixel(i,j).s = 1;
-            else if (getPixel(i,j).s + amount < 0)
-                getPixel(i,j).s = 0;
-            else
-                getPixel(i,j).s += amount;
-        }
-    }
+    pipeline().saturate(amount).apply();
 }
 
 void Image::desaturate() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).s - 0.1 < 0)
-                getPixel(i,j).s = 0;
-            else
-                getPixel(i,j).s -= 0.1;
-        }
-    }
+    pipeline().desaturate().apply();
 }
 
 void Image::desaturate(double amount) {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            if (getPixel(i,j).s - amount < 0)
-                getPixel(i,j).s = 0;
-            else if (getPixel(i,j).s - amount > 1)
-                getPixel(i,j).s = 1;
-            else
-                getPixel(i,j).s -= amount;
-        }
-    }
+    pipeline().desaturate(amount).apply();
 }
 
 void Image::grayscale() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            getPixel(i,j).s = 0;
-        }
-    }
+    pipeline().grayscale().apply();
 }
 
 void Image::rotateColor(double degrees) {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            getPixel(i,j).h += degrees;
-            if (degrees < 0 && getPixel(i,j).h < 0)
-                getPixel(i,j).h += 360; 
-            else if (degrees > 0 && getPixel(i,j).h >= 360)
-                getPixel(i,j).h -= 360;
-        }
-    }
+    pipeline().rotateColor(degrees).apply();
 }
 
 void Image::illinify() {
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-            double orange_dis = std::abs(11 - getPixel(i,j).h);
-            double blue_dis = std::abs(216 - getPixel(i,j).h);
-            if (orange_dis >= blue_dis) {
-                getPixel(i,j).h = 216;
-            } else {
-                getPixel(i,j).h = 11;
-            }
-        }
-    }
+    pipeline().illinify().apply();
 }
 
-void Image::scale(double factor) {
-    PNG* oldImage = new PNG(*this);
-    resize(width() * factor, height() * factor);
+void Image::scale(double factor, ResampleFilter filter) {
+    PNG scaled;
+    if (filter != ResampleFilter::Nearest) {
+        resample(*this, scaled, width() * factor, height() * factor, filter);
+        PNG::operator=(std::move(scaled));
+        return;
+    }
 
-    for (unsigned int i = 0; i < width(); i++) {
-        for (unsigned int j = 0; j < height(); j++) {
-           int x = std::floor(i / factor);
-           int y = std::floor(j / factor);
-           getPixel(i, j) = oldImage->getPixel(x, y);
-        }
+    // Pixel (i, j) comes from (floor(i / factor), floor(j / factor)), built
+    // row by row from a table of source columns
+    const PNG & oldImage = *this;
+    scaled = PNG(width() * factor, height() * factor);
+    if (width() == 0 || height() == 0) {
+        PNG::operator=(std::move(scaled));
+        return;
     }
 
-    delete oldImage;
+    unsigned oldWidth = width();
+    unsigned oldHeight = height();
+    std::vector<unsigned> columns(scaled.width());
+    for (unsigned int i = 0; i < scaled.width(); i++)
+        columns[i] = std::min<unsigned>(std::floor(i / factor), oldWidth - 1);
+
+    const HSLAPixel * oldPixels = oldImage.row(0);
+    scaled.forEachRow([&columns, oldPixels, oldWidth, oldHeight, factor](unsigned int j, HSLAPixel * row) {
+        unsigned y = std::min<unsigned>(std::floor(j / factor), oldHeight - 1);
+        const HSLAPixel * oldRow = oldPixels + (std::size_t(y) * oldWidth);
+        for (unsigned int i = 0; i < columns.size(); i++)
+            row[i] = oldRow[columns[i]];
+    });
+
+    PNG::operator=(std::move(scaled));
 }
 
-void Image::scale(unsigned w, unsigned h) {
+void Image::scale(unsigned w, unsigned h, ResampleFilter filter) {
     if (w == width() && h == height())
         return;
     else if ((double) w / (double) width() < (double) h / (double) height()) 
-        scale((double) w / width());
+        scale((double) w / width(), filter);
     else if ((double) h / (double) height() < (double) w / (double) width()) 
-        scale((double) h / (double) height());
-} 
\ No newline at end of file
+        scale((double) h / (double) height(), filter);
+}
+
+Image::Pipeline Image::pipeline() {
+    return Pipeline(*this);
+}
+
+Image::Pipeline::Pipeline(Image &image) : image_(image) { }
+
+// The one-argument filters clamp at both ends; the default ones only clamp
+// in the direction they move, as they always have
+Image::Pipeline& Image::Pipeline::lighten() { return _adjust(&HSLAPixel::l, 0.1, false, true); }
+Image::Pipeline& Image::Pipeline::lighten(double amount) { return _adjust(&HSLAPixel::l, amount, true, true); }
+Image::Pipeline& Image::Pipeline::darken() { return _adjust(&HSLAPixel::l, -0.1, true, false); }
+Image::Pipeline& Image::Pipeline::darken(double amount) { return _adjust(&HSLAPixel::l, -amount, true, true); }
+Image::Pipeline& Image::Pipeline::saturate() { return _adjust(&HSLAPixel::s, 0.1, false, true); }
+Image::Pipeline& Image::Pipeline::saturate(double amount) { return _adjust(&HSLAPixel::s, amount, true, true); }
+Image::Pipeline& Image::Pipeline::desaturate() { return _adjust(&HSLAPixel::s, -0.1, true, false); }
+Image::Pipeline& Image::Pipeline::desaturate(double amount) { return _adjust(&HSLAPixel::s, -amount, true, true); }
+
+Image::Pipeline& Image::Pipeline::grayscale() {
+    ops_.push_back({Op::Grayscale, &HSLAPixel::s, 0, false, false});
+    return *this;
+}
+
+Image::Pipeline& Image::Pipeline::rotateColor(double degrees) {
+    ops_.push_back({Op::RotateColor, &HSLAPixel::h, degrees, false, false});
+    return *this;
+}
+
+Image::Pipeline& Image::Pipeline::illinify() {
+    ops_.push_back({Op::Illinify, &HSLAPixel::h, 0, false, false});
+    return *this;
+}
+
+Image::Pipeline& Image::Pipeline::_adjust(double HSLAPixel::*channel, double amount, bool clampLow, bool clampHigh) {
+    ops_.push_back({Op::Adjust, channel, amount, clampLow, clampHigh});
+    return *this;
+}
+
+void Image::Pipeline::apply() {
+    if (ops_.empty())
+        return;
+
+    std::vector<Op> ops;
+    ops.swap(ops_);
+    unsigned width = image_.width();
+    image_.forEachRow([&ops, width](unsigned int, HSLAPixel *row) {
+        for (const Op &op : ops)
+            _run(op, row, width);
+    });
+}
+
+void Image::Pipeline::_run(const Op &op, HSLAPixel *row, unsigned width) {
+    switch (op.kind) {
+        case Op::Adjust: {
+            // x - a and x + (-a) are the same double, so darken() matches too
+            double HSLAPixel::*channel = op.channel;
+            for (unsigned x = 0; x < width; x++) {
+                double value = row[x].*channel + op.amount;
+                if (op.clampHigh && value > 1)
+                    value = 1;
+                else if (op.clampLow && value < 0)
+                    value = 0;
+                row[x].*channel = value;
+            }
+            break;
+        }
+
+        case Op::Grayscale:
+            for (unsigned x = 0; x < width; x++)
+                row[x].s = 0;
+            break;
+
+        case Op::RotateColor:
+            for (unsigned x = 0; x < width; x++) {
+                HSLAPixel &pixel = row[x];
+                pixel.h += op.amount;
+                if (op.amount < 0 && pixel.h < 0)
+                    pixel.h += 360;
+                else if (op.amount > 0 && pixel.h >= 360)
+                    pixel.h -= 360;
+            }
+            break;
+
+        case Op::Illinify:
+            for (unsigned x = 0; x < width; x++) {
+                HSLAPixel &pixel = row[x];
+                double orange_dis = std::abs(11 - pixel.h);
+                double blue_dis = std::abs(216 - pixel.h);
+                if (orange_dis >= blue_dis) {
+                    pixel.h = 216;
+                } else {
+                    pixel.h = 11;
+                }
+            }
+            break;
+    }
+}
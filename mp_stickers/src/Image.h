@@ -6,11 +6,57 @@
 #pragma once
 
 #include "../lib/cs225/PNG.h"
+#include "../lib/cs225/Resample.h"
+
+#include <vector>
 
 using namespace cs225;
 
 class Image: public PNG {
     public:
+        /**
+         * Filters recorded by Image::pipeline() and run together by apply().
+         * Each filter behaves exactly like the Image method of the same name,
+         * but apply() runs all of them on one row while it is in cache
+         * before moving on, so the image is read and written only once.
+         */
+        class Pipeline {
+            public:
+                explicit Pipeline(Image &image);
+                Pipeline& lighten();
+                Pipeline& lighten(double amount);
+                Pipeline& darken();
+                Pipeline& darken(double amount);
+                Pipeline& saturate();
+                Pipeline& saturate(double amount);
+                Pipeline& desaturate();
+                Pipeline& desaturate(double amount);
+                Pipeline& grayscale();
+                Pipeline& rotateColor(double degrees);
+                Pipeline& illinify();
+
+                /**
+                 * Runs the recorded filters, in order, in parallel by rows, and
+                 * clears them so the pipeline can be reused.
+                 */
+                void apply();
+
+            private:
+                struct Op {
+                    enum Kind { Adjust, Grayscale, RotateColor, Illinify } kind;
+                    double HSLAPixel::*channel;  // Adjust: channel to add amount to
+                    double amount;
+                    bool clampLow;               // Adjust: clamp results below 0 to 0
+                    bool clampHigh;              // Adjust: clamp results above 1 to 1
+                };
+
+                Image &image_;
+                std::vector<Op> ops_;
+
+                Pipeline& _adjust(double HSLAPixel::*channel, double amount, bool clampLow, bool clampHigh);
+                static void _run(const Op &op, HSLAPixel *row, unsigned width);
+        };
+
         void lighten();
         void lighten(double amount);
         void darken();
@@ -22,6 +68,12 @@ class Image: public PNG {
         void grayscale();
         void rotateColor(double degrees);
         void illinify();
-        void scale(double factor);
-        void scale(unsigned w, unsigned h); 
+        void scale(double factor, ResampleFilter filter = ResampleFilter::Nearest);
+        void scale(unsigned w, unsigned h, ResampleFilter filter = ResampleFilter::Nearest);
+
+        /**
+         * Starts recording filters to run on this image in a single pass, e.g.
+         * image.pipeline().lighten().saturate(0.2).rotateColor(90).apply();
+         */
+        Pipeline pipeline();
 };
@@ -1,40 +1,95 @@
 #include "StickerSheet.h"
 
-StickerSheet::StickerSheet(const Image &picture, unsigned max): max_(max) {
-    base_image_ = new Image(picture);
-}
+#include "../lib/cs225/ThreadPool.h"
 
-StickerSheet::~StickerSheet() {
-    for (size_t i = 0; i < stickers_.size(); i++) {
-        delete stickers_.at(i).image;
-    }
-    delete base_image_;
+#include <algorithm>
+#include <unordered_map>
+
+StickerSheet::StickerSheet(const Image &picture, unsigned max): max_(max), cache_valid_(false), blend_(false), index_valid_(false) {
+    base_image_ = std::make_shared<const Image>(picture);
 }
 
-StickerSheet::StickerSheet(const StickerSheet &other): max_(other.max_) {
-    for (size_t i = 0; i < other.stickers_.size(); i++) {
-        Sticker oldSticker = other.stickers_.at(i);
-        stickers_.push_back({ new Image(*oldSticker.image), oldSticker.x, oldSticker.y });
-    }
-    base_image_ = new Image(*other.base_image_);
+StickerSheet::~StickerSheet() { }
+
+StickerSheet::StickerSheet(const StickerSheet &other): max_(other.max_), cache_valid_(false), blend_(other.blend_), index_valid_(false) {
+    copyStickers(other);
+    base_image_ = other.base_image_;
+    base_premultiplied_ = other.base_premultiplied_;
 }
 
 const StickerSheet& StickerSheet::operator=(const StickerSheet &other) {
     if (&other == this)
         return *this;
-    for (size_t i = 0; i < stickers_.size(); i++) {
-        delete stickers_.at(i).image;
-    }
-    delete base_image_;
+    stickers_.clear();
 
     max_ = other.max_;
+    blend_ = other.blend_;
+    copyStickers(other);
+    base_image_ = other.base_image_;
+    base_premultiplied_ = other.base_premultiplied_;
+    blend_cache_ = PremultipliedImage();
+    cache_valid_ = false;
+    index_valid_ = false;
+
+    return *this;
+}
+
+void StickerSheet::copyStickers(const StickerSheet &other) {
+    // Share every sticker except those getSticker() handed out, which the
+    // other sheet may still change
+    stickers_ = other.stickers_;
+    masks_ = other.masks_;
+    premultiplied_ = other.premultiplied_;
+    by_digest_ = other.by_digest_;
     for (size_t i = 0; i < other.stickers_.size(); i++) {
-        Sticker oldSticker = other.stickers_.at(i);
-        stickers_.push_back({ new Image(*oldSticker.image), oldSticker.x, oldSticker.y });
+        if (other.exposed_.at(i)) {
+            stickers_.at(i).image = std::make_shared<const Image>(*other.stickers_.at(i).image);
+            masks_.at(i) = std::make_shared<const SpanMask>(*stickers_.at(i).image);
+            if (blend_)
+                premultiplied_.at(i) = std::make_shared<const PremultipliedImage>(*stickers_.at(i).image);
+        }
     }
-    base_image_ = new Image(*other.base_image_);
+    drawn_.assign(stickers_.size(), PNG::Rect{0, 0, 0, 0});
+    exposed_.assign(stickers_.size(), false);
+}
 
-    return *this;
+size_t StickerSheet::findShared(const Image &image, std::uint64_t digest) const {
+    // Removals shift the indices, so check the entry still holds the image
+    auto found = by_digest_.find(digest);
+    if (found != by_digest_.end()) {
+        size_t i = found->second;
+        if (i < stickers_.size() && !exposed_.at(i) && *stickers_.at(i).image == image)
+            return i;
+    }
+    return stickers_.size();
+}
+
+void StickerSheet::premultiplyStickers() {
+    // Convert each distinct image once, however many stickers share it
+    std::unordered_map<const Image *, std::shared_ptr<const PremultipliedImage>> converted;
+    for (size_t i = 0; i < stickers_.size(); i++) {
+        if (premultiplied_.at(i))
+            continue;
+        std::shared_ptr<const PremultipliedImage> &done = converted[stickers_.at(i).image.get()];
+        if (!done)
+            done = std::make_shared<const PremultipliedImage>(*stickers_.at(i).image);
+        premultiplied_.at(i) = done;
+    }
+}
+
+void StickerSheet::setAlphaBlending(bool enabled) {
+    if (enabled == blend_)
+        return;
+    blend_ = enabled;
+    cache_valid_ = false;
+    if (enabled) {
+        base_premultiplied_ = std::make_shared<const PremultipliedImage>(*base_image_);
+        premultiplyStickers();
+    } else {
+        base_premultiplied_.reset();
+        premultiplied_.assign(stickers_.size(), nullptr);
+        blend_cache_ = PremultipliedImage();
+    }
 }
 
 void StickerSheet::changeMaxStickers(unsigned max) {
@@ -42,24 +97,48 @@ void StickerSheet::changeMaxStickers(unsigned max) {
         return;
     } else if (max == 0) {
         while (!stickers_.empty()) {
-            delete stickers_.at(stickers_.size() - 1).image;
+            markDirty(drawn_.back());
             stickers_.pop_back();
+            drawn_.pop_back();
+            exposed_.pop_back();
+            masks_.pop_back();
+            premultiplied_.pop_back();
         }
     } else if (max < stickers_.size()) {
         for (size_t i = stickers_.size() - 1; i >= max; i--) {
-            delete stickers_.at(i).image;
+            markDirty(drawn_.back());
             stickers_.pop_back();
+            drawn_.pop_back();
+            exposed_.pop_back();
+            masks_.pop_back();
+            premultiplied_.pop_back();
         }
     }
     max_ = max;
+    index_valid_ = false;
 }
 
 int StickerSheet::addSticker(Image &sticker, unsigned x, unsigned y) {
     if (stickers_.size() == max_) {
         return -1;
     }
-    Sticker newSticker = Sticker{ new Image(sticker), x, y};
-    stickers_.push_back(newSticker);
+    std::uint64_t digest = sticker.digest();
+    size_t shared = findShared(sticker, digest);
+    if (shared < stickers_.size()) {
+        stickers_.push_back(Sticker{ stickers_.at(shared).image, x, y });
+        masks_.push_back(masks_.at(shared));
+        premultiplied_.push_back(premultiplied_.at(shared));
+    } else {
+        stickers_.push_back(Sticker{ std::make_shared<const Image>(sticker), x, y });
+        masks_.push_back(std::make_shared<const SpanMask>(*stickers_.back().image));
+        premultiplied_.push_back(blend_ ? std::make_shared<const PremultipliedImage>(*stickers_.back().image) : nullptr);
+        by_digest_[digest] = stickers_.size() - 1;
+    }
+    drawn_.push_back(PNG::Rect{0, 0, 0, 0});
+    exposed_.push_back(false);
+    markDirty(stickerRect(stickers_.size() - 1));
+    if (index_valid_)
+        index_.set(stickers_.size() - 1, stickerRect(stickers_.size() - 1));
     return stickers_.size() - 1;
 }
 
@@ -67,15 +146,24 @@ bool StickerSheet::translate(unsigned index, unsigned x, unsigned y) {
     if (index >= stickers_.size()) {
         return false;
     }
+    markDirty(drawn_.at(index));
     stickers_.at(index).x = x;
     stickers_.at(index).y = y;
+    markDirty(stickerRect(index));
+    if (index_valid_)
+        index_.set(index, stickerRect(index));
     return true;
 }
 
 void StickerSheet::removeSticker(unsigned index) {
     if (index < stickers_.size()) {
-        delete stickers_.at(index).image;
+        markDirty(drawn_.at(index));
         stickers_.erase(stickers_.begin() + index);
+        drawn_.erase(drawn_.begin() + index);
+        exposed_.erase(exposed_.begin() + index);
+        masks_.erase(masks_.begin() + index);
+        premultiplied_.erase(premultiplied_.begin() + index);
+        index_valid_ = false;
     }
 }
 
@@ -83,30 +171,192 @@ Image* StickerSheet::getSticker(unsigned index) {
     if (index >= stickers_.size()) {
         return NULL;
     }
-    return stickers_.at(index).image;
+    // Hand out a private copy, so the change does not reach the stickers
+    // (and sheets) that share its image
+    Sticker &sticker = stickers_.at(index);
+    if (!exposed_.at(index)) {
+        std::shared_ptr<Image> own = std::make_shared<Image>(*sticker.image);
+        sticker.image = own;
+        exposed_.at(index) = true;
+        return own.get();
+    }
+    return const_cast<Image*>(sticker.image.get());
 }
 
-Image StickerSheet::render() const {
+const Image* StickerSheet::getSticker(unsigned index) const {
+    if (index >= stickers_.size()) {
+        return NULL;
+    }
+    return stickers_.at(index).image.get();
+}
+
+PNG::Rect StickerSheet::stickerRect(size_t index) const {
+    const Sticker &sticker = stickers_.at(index);
+    return PNG::Rect{ sticker.x, sticker.y, sticker.image->width(), sticker.image->height() };
+}
+
+void StickerSheet::markDirty(const PNG::Rect &rect) const {
+    if (rect.width == 0 || rect.height == 0)
+        return;
+
+    // Merge overlapping rectangles, so no pixel is composited twice
+    PNG::Rect merged = rect;
+    for (size_t i = 0; i < dirty_.size(); ) {
+        const PNG::Rect &other = dirty_[i];
+        bool overlaps = merged.x < other.x + other.width && other.x < merged.x + merged.width
+                     && merged.y < other.y + other.height && other.y < merged.y + merged.height;
+        if (!overlaps) {
+            i++;
+            continue;
+        }
+        unsigned x = std::min(merged.x, other.x);
+        unsigned y = std::min(merged.y, other.y);
+        merged.width = std::max(merged.x + merged.width, other.x + other.width) - x;
+        merged.height = std::max(merged.y + merged.height, other.y + other.height) - y;
+        merged.x = x;
+        merged.y = y;
+        dirty_.erase(dirty_.begin() + i);
+        i = 0;
+    }
+    dirty_.push_back(merged);
+}
+
+void StickerSheet::composite(const PNG::Rect &rect, Image &target, PremultipliedImage &blendTarget,
+                             unsigned originX, unsigned originY) const {
+    // rect is in sheet coordinates; target holds the pixels from (originX, originY)
+    unsigned right = std::min(rect.x + rect.width, originX + target.width());
+    unsigned bottom = std::min(rect.y + rect.height, originY + target.height());
+    unsigned left = std::max(rect.x, originX);
+    unsigned top = std::max(rect.y, originY);
+    if (left >= right || top >= bottom)
+        return;
+    PNG::Rect area = { left, top, right - left, bottom - top };
+    PNG::Rect local = { left - originX, top - originY, area.width, area.height };
+
+    // Start from white, as resize() does beyond the base image
+    if (blend_) {
+        blendTarget.fill(local, HSLAPixel());
+        blendTarget.copy(*base_premultiplied_, area, local.x, local.y);
+    } else {
+        target.fill(local, HSLAPixel());
+        target.blit(*base_image_, area, local.x, local.y);
+    }
+
+    // Then the stickers over it, in z-order
+    std::vector<size_t> over = index_.query(area);
+    for (size_t i : over) {
+        const Sticker &sticker = stickers_.at(i);
+        const Image &image = *sticker.image;
+        unsigned stickerLeft = std::max(left, sticker.x);
+        unsigned stickerTop = std::max(top, sticker.y);
+        unsigned stickerRight = std::min(right, sticker.x + image.width());
+        unsigned stickerBottom = std::min(bottom, sticker.y + image.height());
+        if (stickerLeft >= stickerRight || stickerTop >= stickerBottom)
+            continue;
+        PNG::Rect part = { stickerLeft - sticker.x, stickerTop - sticker.y,
+                           stickerRight - stickerLeft, stickerBottom - stickerTop };
+        if (blend_)
+            blendTarget.over(*premultiplied_.at(i), *masks_.at(i), part, stickerLeft - originX, stickerTop - originY);
+        else
+            target.blit(image, *masks_.at(i), part, stickerLeft - originX, stickerTop - originY);
+    }
+    if (blend_)
+        blendTarget.store(target, local);
+}
+
+PNG::Rect StickerSheet::canvas() const {
     unsigned int max_x = base_image_->width();
     unsigned int max_y = base_image_->height();
     for (size_t i = 0; i < stickers_.size(); i++) {
-        Sticker sticker = stickers_.at(i);
+        const Sticker &sticker = stickers_.at(i);
         max_x = std::max(max_x, sticker.x + sticker.image->width()); 
         max_y = std::max(max_y, sticker.y + sticker.image->height());
     }
-    Image retval(*base_image_);
-    retval.resize(max_x, max_y);
+    return PNG::Rect{ 0, 0, max_x, max_y };
+}
 
+void StickerSheet::refresh() const {
+    if (!index_valid_) {
+        index_.clear();
+        for (size_t i = 0; i < stickers_.size(); i++)
+            index_.set(i, stickerRect(i));
+        index_valid_ = true;
+    }
+
+    // Stickers handed out by getSticker() may have been edited or resized
     for (size_t i = 0; i < stickers_.size(); i++) {
-        Sticker sticker = stickers_.at(i);
-        for (size_t x = 0; x < sticker.image->width(); x++) {
-            for (size_t y = 0; y < sticker.image->height(); y++) {
-                if (sticker.image->getPixel(x,y).a != 0) {
-                    retval.getPixel(sticker.x + x, sticker.y + y) = sticker.image->getPixel(x,y);
-                }
-            }
+        if (exposed_.at(i)) {
+            masks_.at(i) = std::make_shared<const SpanMask>(*stickers_.at(i).image);
+            if (blend_)
+                premultiplied_.at(i) = std::make_shared<const PremultipliedImage>(*stickers_.at(i).image);
+            index_.set(i, stickerRect(i));
         }
     }
+}
 
-    return retval;
-}
\ No newline at end of file
+Image StickerSheet::render() const {
+    PNG::Rect size = canvas();
+    refresh();
+    for (size_t i = 0; i < stickers_.size(); i++) {
+        if (exposed_.at(i)) {
+            markDirty(drawn_.at(i));
+            markDirty(stickerRect(i));
+        }
+    }
+
+    if (!cache_valid_ || cache_.width() != size.width || cache_.height() != size.height) {
+        // Composite everything into an output allocated once
+        cache_.resize(size.width, size.height);
+        if (blend_)
+            blend_cache_.resize(size.width, size.height);
+        composite(size, cache_, blend_cache_, 0, 0);
+        cache_valid_ = true;
+    } else {
+        for (size_t i = 0; i < dirty_.size(); i++)
+            composite(dirty_[i], cache_, blend_cache_, 0, 0);
+    }
+    dirty_.clear();
+    for (size_t i = 0; i < stickers_.size(); i++)
+        drawn_.at(i) = stickerRect(i);
+
+    // cache_ was only written through blit() and fill(), so the frame
+    // shares its pixels; the next render() copies them only if the caller
+    // still holds this frame
+    return cache_;
+}
+
+Image StickerSheet::renderRegion(const PNG::Rect &rect) const {
+    refresh();
+    return renderArea(rect);
+}
+
+Image StickerSheet::renderArea(const PNG::Rect &rect) const {
+    Image region;
+    region.resize(rect.width, rect.height);
+    PremultipliedImage blendRegion(blend_ ? rect.width : 0, blend_ ? rect.height : 0);
+    composite(rect, region, blendRegion, rect.x, rect.y);
+    return region;
+}
+
+void StickerSheet::renderTiles(unsigned tileSize,
+                               const std::function<void(const PNG::Rect &, const Image &)> &sink) const {
+    PNG::Rect size = canvas();
+    if (tileSize == 0 || size.width == 0 || size.height == 0)
+        return;
+    refresh();
+
+    // The tasks only read the sheet, so expand the base image now; the
+    // stickers were expanded when their masks were made
+    base_image_->row(0);
+
+    size_t columns = (size.width + tileSize - 1) / tileSize;
+    size_t rows = (size.height + tileSize - 1) / tileSize;
+    ThreadPool::shared().parallelFor(columns * rows, 1, [&](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++) {
+            unsigned x = (tile % columns) * tileSize;
+            unsigned y = (tile / columns) * tileSize;
+            PNG::Rect area = { x, y, std::min(tileSize, size.width - x), std::min(tileSize, size.height - y) };
+            sink(area, renderArea(area));
+        }
+    });
+}
@@ -5,20 +5,69 @@
 #pragma once
 
 #include "Image.h"
+#include "../lib/cs225/PremultipliedImage.h"
+#include "../lib/cs225/RectGrid.h"
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
+// Stickers share their pixels: stamping the same image many times, or
+// copying a sheet, stores each distinct image only once
 struct Sticker {
-            Image* image;
+            std::shared_ptr<const Image> image;
             unsigned x;
             unsigned y;
         };
 
 class StickerSheet {
     private:
-        Image* base_image_;
+        std::shared_ptr<const Image> base_image_;
         std::vector<Sticker> stickers_;
         unsigned int max_;
+
+        // The last render and what has changed since: render() recomposites
+        // only the dirty rectangles of cache_, unless its size changed
+        mutable Image cache_;
+        mutable bool cache_valid_;
+        mutable std::vector<PNG::Rect> dirty_;
+        // Per sticker: where it is drawn in cache_, and whether getSticker()
+        // has handed it out (so its pixels may change without notice, and
+        // it is no longer shared)
+        mutable std::vector<PNG::Rect> drawn_;
+        std::vector<bool> exposed_;
+        // Per sticker: its opaque runs, so composite() copies whole runs
+        // and skips transparent ones; shared along with the image
+        mutable std::vector<std::shared_ptr<const SpanMask>> masks_;
+        // The index of a sticker holding an image with each digest, so
+        // addSticker() finds an equal image to share without a search
+        std::unordered_map<std::uint64_t, size_t> by_digest_;
+
+        // Alpha blending: the base image and every sticker in premultiplied
+        // RGBA (shared like the masks), composited in blend_cache_ and then
+        // converted into cache_; all empty while blending is off
+        bool blend_;
+        mutable PremultipliedImage blend_cache_;
+        std::shared_ptr<const PremultipliedImage> base_premultiplied_;
+        mutable std::vector<std::shared_ptr<const PremultipliedImage>> premultiplied_;
+
+        // Where each sticker is, so compositing an area looks only at the
+        // stickers over it; rebuilt by refresh() after removals shift the
+        // indices, and kept up to date by add and translate otherwise
+        mutable RectGrid index_;
+        mutable bool index_valid_;
+
+        PNG::Rect stickerRect(size_t index) const;
+        PNG::Rect canvas() const;
+        void refresh() const;
+        Image renderArea(const PNG::Rect &rect) const;
+        void markDirty(const PNG::Rect &rect) const;
+        void composite(const PNG::Rect &rect, Image &target, PremultipliedImage &blendTarget,
+                       unsigned originX, unsigned originY) const;
+        void copyStickers(const StickerSheet &other);
+        size_t findShared(const Image &image, std::uint64_t digest) const;
+        void premultiplyStickers();
     public:
         StickerSheet(const Image &picture, unsigned max);
         ~StickerSheet();
@@ -29,5 +78,37 @@ class StickerSheet {
         bool translate(unsigned index, unsigned x, unsigned y);
         void removeSticker(unsigned index);
         Image* getSticker(unsigned index);
+
+        /**
+         * Gets a sticker for reading only, so unlike getSticker() it stays
+         * shared: stamps of the same image return the same Image.
+         */
+        const Image* getSticker(unsigned index) const;
+
+        /**
+         * By default a sticker pixel with any alpha above 0 replaces the
+         * pixel beneath it. With alpha blending on, render() instead blends
+         * each sticker over what lies beneath it by its alpha, in
+         * premultiplied RGBA; colors are rounded to 8 bits per channel.
+         */
+        void setAlphaBlending(bool enabled);
         Image render() const;
+
+        /**
+         * Renders just the given area of the sheet, as render() would draw
+         * it, compositing only the stickers over it. Parts of the area
+         * beyond the base image and every sticker are white.
+         */
+        Image renderRegion(const PNG::Rect &rect) const;
+
+        /**
+         * Renders the area render() would return as tiles of at most
+         * tileSize x tileSize pixels, several at once on the ThreadPool,
+         * and hands each finished tile and its area to sink; only the tiles
+         * being rendered are in memory at any time, so the sheet may be far
+         * larger than memory. sink may be called from several threads at
+         * once, and tiles arrive in no particular order.
+         */
+        void renderTiles(unsigned tileSize,
+                         const std::function<void(const PNG::Rect &, const Image &)> &sink) const;
 };
\ No newline at end of file
@@ -139,3 +139,43 @@ TEST_CASE("Image scale(0.5) scales pixel data in a reasonable way", "[weight=1][
   REQUIRE( result.getPixel(100, 20).h > 180 );
   REQUIRE( result.getPixel(100, 20).h < 220 );
 }
+
+TEST_CASE("Image scale() with an interpolating filter keeps flat colors flat", "[weight=1][part=1]") {
+  for (ResampleFilter filter : {ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos}) {
+    Image img;
+    img.resize(90, 60);
+    img.transform([](HSLAPixel & pixel) { pixel = HSLAPixel(120, 1, 0.5); });
+    Image expected(img);
+
+    img.scale(0.5, filter);
+    REQUIRE( img.width() == 45 );
+    REQUIRE( img.height() == 30 );
+    expected.resize(45, 30);
+    REQUIRE( img == expected );
+  }
+}
+
+
+//
+// pipeline
+//
+TEST_CASE("Image pipeline() matches running each filter in turn", "[weight=1][part=1]") {
+  Image expected = createRainbowImage();
+  expected.lighten();
+  expected.saturate(0.5);
+  expected.rotateColor(-90);
+  expected.darken();
+  expected.desaturate(0.3);
+  expected.grayscale();
+
+  Image result = createRainbowImage();
+  result.pipeline().lighten().saturate(0.5).rotateColor(-90).darken().desaturate(0.3).grayscale().apply();
+
+  for (unsigned x = 0; x < result.width(); x++) {
+    for (unsigned y = 0; y < result.height(); y++) {
+      REQUIRE( result.getPixel(x, y).h == expected.getPixel(x, y).h );
+      REQUIRE( result.getPixel(x, y).s == expected.getPixel(x, y).s );
+      REQUIRE( result.getPixel(x, y).l == expected.getPixel(x, y).l );
+    }
+  }
+}
@@ -5,6 +5,9 @@
 #include "cs225/PNG.h"
 #include "cs225/HSLAPixel.h"
 
+#include <cmath>
+#include <mutex>
+
 using namespace cs225;
 
 static void checkStickerPlacement(const Image& sticker, const Image& sheet, const int& xOffset, const int& yOffset) {
@@ -334,3 +337,147 @@ TEST_CASE("A Stickersheet with stickers placed beyond base image boundaries work
   REQUIRE( sheet.render() == alma );
 }
 
+
+TEST_CASE("A sticker made transparent through getSticker() shows the base image beneath it", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image alma; alma.readFromFile("../tests/alma.png");
+  Image i;    i.readFromFile("../tests/i.png");
+
+  StickerSheet sheet(alma, 5);
+  sheet.addSticker(i, 20, 200);
+  REQUIRE_FALSE( sheet.render() == alma );
+
+  Image *sticker = sheet.getSticker(0);
+  for (unsigned y = 0; y < sticker->height(); y++) {
+    for (unsigned x = 0; x < sticker->width(); x++) {
+      sticker->getPixel(x, y).a = 0;
+    }
+  }
+
+  REQUIRE( sheet.render() == alma );
+}
+
+TEST_CASE("StickerSheet with alpha blending blends a half-transparent sticker with the base", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image black; black.resize(20, 20);
+  black.transform([](HSLAPixel &pixel) { pixel.l = 0; });
+  Image white; white.resize(10, 10);
+  white.transform([](HSLAPixel &pixel) { pixel.l = 1; pixel.a = 0.5; });
+
+  StickerSheet sheet(black, 1);
+  sheet.addSticker(white, 5, 5);
+  REQUIRE( sheet.render().getPixel(8, 8).l == 1 );
+
+  sheet.setAlphaBlending(true);
+  Image blended = sheet.render();
+  REQUIRE( std::abs(blended.getPixel(8, 8).l - 0.5) < 0.01 );
+  REQUIRE( blended.getPixel(8, 8).a == 1 );
+  REQUIRE( blended.getPixel(2, 2).l == 0 );
+}
+
+TEST_CASE("StickerSheet renderRegion() and renderTiles() match render()", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image alma; alma.readFromFile("../tests/alma.png");
+  Image i;    i.readFromFile("../tests/i.png");
+
+  StickerSheet sheet(alma, 5);
+  sheet.addSticker(i, 20, 200);
+  sheet.addSticker(i, 800, 500);
+  Image expected = sheet.render();
+
+  PNG::Rect area = { 10, 190, 150, 120 };
+  REQUIRE( sheet.renderRegion(area) == expected.crop(area) );
+
+  Image tiled; tiled.resize(expected.width(), expected.height());
+  std::mutex lock;
+  sheet.renderTiles(256, [&](const PNG::Rect &rect, const Image &tile) {
+    std::lock_guard<std::mutex> guard(lock);
+    tiled.blit(tile, PNG::Rect{ 0, 0, rect.width, rect.height }, rect.x, rect.y);
+  });
+  REQUIRE( tiled == expected );
+}
+
+TEST_CASE("StickerSheet render() after changes on the same canvas matches a fresh render", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image alma; alma.readFromFile("../tests/alma.png");
+  Image i;    i.readFromFile("../tests/i.png");
+
+  for (bool blend : {false, true}) {
+    INFO( (blend ? "with" : "without") << " alpha blending" );
+    StickerSheet sheet(alma, 5);
+    sheet.setAlphaBlending(blend);
+    sheet.addSticker(i, 20, 200);
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+
+    // Each step keeps every sticker inside the base, so the canvas never changes size
+    sheet.translate(0, 60, 180);
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+
+    sheet.addSticker(i, 100, 150);
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+
+    sheet.translate(0, 600, 250);
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+
+    sheet.removeSticker(1);
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+
+    Image *sticker = sheet.getSticker(0);
+    for (unsigned y = 0; y < sticker->height() / 2; y++) {
+      for (unsigned x = 0; x < sticker->width(); x++) {
+        sticker->getPixel(x, y).a = 0;
+      }
+    }
+    REQUIRE( sheet.render() == StickerSheet(sheet).render() );
+  }
+}
+
+TEST_CASE("Stamps of one image share it until getSticker() hands one out", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image alma; alma.readFromFile("../tests/alma.png");
+  Image i;    i.readFromFile("../tests/i.png");
+
+  StickerSheet sheet(alma, 5);
+  sheet.addSticker(i, 20, 200);
+  sheet.addSticker(i, 400, 100);
+  const StickerSheet &view = sheet;
+  REQUIRE( view.getSticker(0) == view.getSticker(1) );
+
+  StickerSheet copy(sheet);
+  Image expected = copy.render();
+
+  Image *edited = sheet.getSticker(0);
+  for (unsigned y = 0; y < edited->height(); y++) {
+    for (unsigned x = 0; x < edited->width(); x++) {
+      edited->getPixel(x, y).l = 0;
+    }
+  }
+
+  REQUIRE( view.getSticker(0) == edited );
+  REQUIRE( view.getSticker(0) != view.getSticker(1) );
+  REQUIRE( *view.getSticker(1) == i );
+  REQUIRE( copy.render() == expected );
+
+  const StickerSheet &copyView = copy;
+  REQUIRE( *copyView.getSticker(0) == i );
+  REQUIRE( copyView.getSticker(0) == copyView.getSticker(1) );
+}
+
+TEST_CASE("StickerSheet render() shares its pixels with the frames it returned", "[weight=1][part=2][timeout=30000][valgrind]") {
+  Image alma; alma.readFromFile("../tests/alma.png");
+  Image i;    i.readFromFile("../tests/i.png");
+
+  for (bool blend : {false, true}) {
+    INFO( (blend ? "with" : "without") << " alpha blending" );
+    StickerSheet sheet(alma, 5);
+    sheet.setAlphaBlending(blend);
+    sheet.addSticker(i, 20, 200);
+
+    const Image first = sheet.render();
+    const Image again = sheet.render();
+    REQUIRE( first.row(0) == again.row(0) );
+
+    // A frame still held keeps its pixels when the sheet changes
+    PNG before = first.crop(PNG::Rect{ 0, 0, first.width(), first.height() });
+    sheet.translate(0, 300, 100);
+    const Image moved = sheet.render();
+    REQUIRE( first == before );
+    REQUIRE( moved.row(0) != first.row(0) );
+    REQUIRE( moved == StickerSheet(sheet).render() );
+  }
+}
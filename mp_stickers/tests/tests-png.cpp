@@ -0,0 +1,364 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "cs225/PNG.h"
+#include "cs225/HSLAPixel.h"
+#include "cs225/EncodeOptions.h"
+#include "cs225/ImageCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace cs225;
+
+/**
+ * An image with smooth gradients, flat areas and noise, so that every
+ * filter and deflate strategy has something to do.
+ */
+static PNG createTestImage(unsigned width, unsigned height) {
+  PNG png(width, height);
+  unsigned seed = 225;
+  for (unsigned y = 0; y < height; y++) {
+    for (unsigned x = 0; x < width; x++) {
+      seed = (seed * 1103515245) + 12345;
+      HSLAPixel & pixel = png.getPixel(x, y);
+      pixel.h = (x * 360.0) / width;
+      pixel.s = (y < height / 2) ? 1 : ((seed >> 16) % 100) / 100.0;
+      pixel.l = (x % 64 < 32) ? 0.5 : y / (double) height;
+      pixel.a = (x + y) % 5 == 0 ? 0.5 : 1;
+    }
+  }
+  return png;
+}
+
+/** An image whose pixel (x, y) has hue x and luminance y / 100, to tell where pixels went. */
+static PNG createCoordinateImage(unsigned width, unsigned height) {
+  PNG png(width, height);
+  for (unsigned y = 0; y < height; y++) {
+    for (unsigned x = 0; x < width; x++) {
+      png.getPixel(x, y) = HSLAPixel(x, 1, y / 100.0);
+    }
+  }
+  return png;
+}
+
+/** The names of the entries in an ImageCache directory. */
+static std::vector<std::string> cacheEntries(std::string const & directory) {
+  std::vector<std::string> entries;
+  if (DIR * dir = opendir(directory.c_str())) {
+    while (dirent * item = readdir(dir)) {
+      std::string name = item->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".raw") == 0) { entries.push_back(name); }
+    }
+    closedir(dir);
+  }
+  return entries;
+}
+
+static std::string readBytes(std::string const & fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+//
+// Pixel formats
+//
+TEST_CASE("PNG read into and written from each compact format round-trips", "[weight=1][part=png]") {
+  REQUIRE( createTestImage(50, 40).writeToFile("test_formats_in.png") );
+  PNG expected;
+  REQUIRE( expected.readFromFile("test_formats_in.png") );
+
+  for (PixelFormat format : {PixelFormat::RGBA8, PixelFormat::HSLA32, PixelFormat::HSLA32_PLANAR}) {
+    INFO( "format " << static_cast<int>(format) );
+    PNG compact;
+    compact.setPixelFormat(format);
+    REQUIRE( compact.readFromFile("test_formats_in.png") );
+    REQUIRE( compact.pixelFormat() == format );
+    REQUIRE( compact.writeToFile("test_formats_out.png") );
+    REQUIRE( compact.pixelFormat() == format );
+
+    PNG decoded;
+    REQUIRE( decoded.readFromFile("test_formats_out.png") );
+    REQUIRE( decoded == expected );
+    REQUIRE( compact == expected );
+  }
+  std::remove("test_formats_in.png");
+  std::remove("test_formats_out.png");
+}
+
+
+//
+// Cropping, blitting and resizing
+//
+TEST_CASE("PNG crop() leaves out the parts of the area past the right and bottom edges", "[weight=1][part=png]") {
+  PNG image = createCoordinateImage(20, 10);
+
+  PNG cropped = image.crop(PNG::Rect{15, 6, 10, 10});
+  REQUIRE( cropped.width() == 5 );
+  REQUIRE( cropped.height() == 4 );
+  for (unsigned y = 0; y < cropped.height(); y++) {
+    for (unsigned x = 0; x < cropped.width(); x++) {
+      REQUIRE( cropped.getPixel(x, y) == image.getPixel(15 + x, 6 + y) );
+    }
+  }
+
+  REQUIRE( image.crop(PNG::Rect{25, 0, 5, 5}).width() == 0 );
+  REQUIRE( image.crop(PNG::Rect{0, 12, 5, 5}).height() == 0 );
+}
+
+TEST_CASE("PNG blit() skips the pixels that fall past the right and bottom edges", "[weight=1][part=png]") {
+  PNG source = createCoordinateImage(8, 8);
+  PNG before(20, 10);
+  PNG image(before);
+
+  image.blit(source, PNG::Rect{0, 0, 8, 8}, 16, 7);
+  for (unsigned y = 0; y < image.height(); y++) {
+    for (unsigned x = 0; x < image.width(); x++) {
+      if (x >= 16 && y >= 7) {
+        REQUIRE( image.getPixel(x, y) == source.getPixel(x - 16, y - 7) );
+      } else {
+        REQUIRE( image.getPixel(x, y) == before.getPixel(x, y) );
+      }
+    }
+  }
+
+  // Entirely outside the image: nothing changes
+  PNG unchanged(image);
+  image.blit(source, PNG::Rect{0, 0, 8, 8}, 20, 0);
+  image.blit(source, PNG::Rect{8, 0, 8, 8}, 0, 0);
+  REQUIRE( image == unchanged );
+}
+
+TEST_CASE("PNG blit() with skipTransparent keeps the pixels beneath transparent ones", "[weight=1][part=png]") {
+  PNG source = createCoordinateImage(6, 6);
+  for (unsigned y = 0; y < 6; y++) {
+    for (unsigned x = 0; x < 6; x++) {
+      if ((x + y) % 2 == 0) { source.getPixel(x, y).a = 0; }
+    }
+  }
+  PNG base(6, 6);
+  for (unsigned y = 0; y < 6; y++) {
+    for (unsigned x = 0; x < 6; x++) {
+      base.getPixel(x, y) = HSLAPixel(200, 0.5, 0.25);
+    }
+  }
+
+  PNG skipping(base);
+  skipping.blit(source, PNG::Rect{0, 0, 6, 6}, 0, 0, true);
+  PNG copying(base);
+  copying.blit(source, PNG::Rect{0, 0, 6, 6}, 0, 0);
+  for (unsigned y = 0; y < 6; y++) {
+    for (unsigned x = 0; x < 6; x++) {
+      bool transparent = (x + y) % 2 == 0;
+      REQUIRE( skipping.getPixel(x, y) == (transparent ? base : source).getPixel(x, y) );
+      REQUIRE( copying.getPixel(x, y) == source.getPixel(x, y) );
+    }
+  }
+}
+
+TEST_CASE("PNG blit() within one image copies overlapping areas as if through a copy", "[weight=1][part=png]") {
+  // Forward (down and right) and backward (up and left), across and within rows
+  struct Move { PNG::Rect rect; unsigned dstX, dstY; };
+  for (Move move : {Move{{2, 1, 12, 8}, 5, 3}, Move{{5, 3, 12, 8}, 2, 1},
+                    Move{{0, 4, 16, 1}, 3, 4}, Move{{3, 4, 13, 1}, 0, 4}}) {
+    INFO( "from (" << move.rect.x << ", " << move.rect.y << ") to (" << move.dstX << ", " << move.dstY << ")" );
+    PNG image = createCoordinateImage(20, 12);
+    PNG expected(image);
+    expected.blit(PNG(image), move.rect, move.dstX, move.dstY);
+
+    image.blit(image, move.rect, move.dstX, move.dstY);
+    REQUIRE( image == expected );
+  }
+}
+
+TEST_CASE("PNG resize() after reserve() keeps the pixels without reallocating", "[weight=1][part=png]") {
+  PNG image = createCoordinateImage(10, 10);
+  PNG original(image);
+  image.reserve(40 * 40);
+  std::size_t capacity = image.capacity();
+  REQUIRE( capacity >= 40 * 40 );
+  const HSLAPixel * pixels = static_cast<const PNG &>(image).row(0);
+
+  image.resize(30, 25);
+  REQUIRE( image.width() == 30 );
+  REQUIRE( image.height() == 25 );
+  REQUIRE( image.capacity() == capacity );
+  REQUIRE( static_cast<const PNG &>(image).row(0) == pixels );
+  HSLAPixel white = PNG(1, 1).getPixel(0, 0);
+  for (unsigned y = 0; y < image.height(); y++) {
+    for (unsigned x = 0; x < image.width(); x++) {
+      REQUIRE( image.getPixel(x, y) == ((x < 10 && y < 10) ? original.getPixel(x, y) : white) );
+    }
+  }
+
+  image.resize(4, 3);
+  REQUIRE( image.capacity() == capacity );
+  REQUIRE( static_cast<const PNG &>(image).row(0) == pixels );
+  REQUIRE( image == original.crop(PNG::Rect{0, 0, 4, 3}) );
+}
+
+
+//
+// Copies and moves
+//
+TEST_CASE("PNG move constructor and assignment take the pixels", "[weight=1][part=png]") {
+  PNG original = createTestImage(40, 30);
+  PNG expected = createTestImage(40, 30);
+  const HSLAPixel * pixels = static_cast<const PNG &>(original).row(0);
+
+  PNG moved(std::move(original));
+  REQUIRE( moved == expected );
+  REQUIRE( static_cast<const PNG &>(moved).row(0) == pixels );
+  REQUIRE( original.width() == 0 );
+  REQUIRE( original.height() == 0 );
+
+  PNG assigned(5, 5);
+  assigned = std::move(moved);
+  REQUIRE( assigned == expected );
+  REQUIRE( static_cast<const PNG &>(assigned).row(0) == pixels );
+  REQUIRE( moved.width() == 0 );
+  REQUIRE( moved.height() == 0 );
+
+  // A moved-from image can be used again
+  moved = expected;
+  REQUIRE( moved == expected );
+}
+
+TEST_CASE("PNG copies share pixels until one is written to", "[weight=1][part=png]") {
+  // createTestImage() wrote through getPixel(), so its image is copied
+  // eagerly; the copy has handed out nothing, so it can be shared
+  PNG drawn = createTestImage(40, 30);
+  PNG original(drawn);
+  REQUIRE( static_cast<const PNG &>(drawn).row(0) != static_cast<const PNG &>(original).row(0) );
+
+  PNG copy(original);
+  PNG assigned;
+  assigned = original;
+  const PNG & constOriginal = original;
+  REQUIRE( static_cast<const PNG &>(copy).row(0) == constOriginal.row(0) );
+  REQUIRE( static_cast<const PNG &>(assigned).row(0) == constOriginal.row(0) );
+
+  copy.getPixel(3, 4).l = 0.125;
+  REQUIRE( static_cast<const PNG &>(copy).row(0) != constOriginal.row(0) );
+  REQUIRE( constOriginal.getPixel(3, 4).l != 0.125 );
+  REQUIRE( assigned == original );
+  REQUIRE( !(copy == original) );
+}
+
+TEST_CASE("PNG copies never alias references handed out before the copy", "[weight=1][part=png]") {
+  PNG original = createTestImage(40, 30);
+  HSLAPixel & pixel = original.getPixel(3, 4);
+
+  PNG copy(original);
+  REQUIRE( copy == original );
+  pixel.l = 0.125;
+  REQUIRE( copy.getPixel(3, 4).l != 0.125 );
+  REQUIRE( original.getPixel(3, 4).l == 0.125 );
+}
+
+
+//
+// EncodeOptions
+//
+TEST_CASE("PNG writeToFile() with parallel deflate round-trips every preset", "[weight=1][part=png]") {
+  // 260x130 RGBA is 132 KB of filtered rows, past one 128 KB deflate block
+  PNG original = createTestImage(260, 130);
+  std::vector<std::pair<std::string, EncodeOptions>> presets = {
+    {"fastest", EncodeOptions::fastest()},
+    {"balanced", EncodeOptions::balanced()},
+    {"smallest", EncodeOptions::smallest()}
+  };
+
+  for (auto & preset : presets) {
+    for (bool parallel : {false, true}) {
+      INFO( preset.first << (parallel ? ", parallel" : "") );
+      EncodeOptions options = preset.second;
+      options.parallel = parallel;
+      REQUIRE( original.writeToFile("test_parallel_deflate.png", options) );
+
+      PNG decoded;
+      REQUIRE( decoded.readFromFile("test_parallel_deflate.png") );
+      REQUIRE( decoded.width() == original.width() );
+      REQUIRE( decoded.height() == original.height() );
+      REQUIRE( decoded == original );
+    }
+  }
+  std::remove("test_parallel_deflate.png");
+}
+
+
+//
+// ImageCache
+//
+TEST_CASE("PNG readFromFile() with the image cache", "[weight=1][part=png]") {
+  // ImageCache::shared() reads $CS225_IMAGE_CACHE once, on its first use,
+  // so the directory is made once for all the sections below
+  static const std::string directory = []() {
+    char name[] = "/tmp/cs225-cache-test-XXXXXX";
+    std::string made = mkdtemp(name) ? name : "";
+    setenv("CS225_IMAGE_CACHE", made.c_str(), 1);
+    return made;
+  }();
+  REQUIRE( !directory.empty() );
+  REQUIRE( ImageCache::shared().directory() == directory );
+
+  const std::string source = "test_image_cache.png";
+  REQUIRE( createTestImage(64, 48).writeToFile(source) );
+  PNG uncached;
+  REQUIRE( uncached.readFromFile(source) );
+
+  PNG cold;
+  REQUIRE( cold.readFromFile(source, true) );
+  std::vector<std::string> entries = cacheEntries(directory);
+  REQUIRE( entries.size() == 1 );
+  std::string entry = directory + "/" + entries[0];
+  std::string stored = readBytes(entry);
+
+  SECTION("a warm load is equal to a cold load") {
+    PNG warm;
+    REQUIRE( warm.readFromFile(source, true) );
+    REQUIRE( cacheEntries(directory).size() == 1 );
+    REQUIRE( warm.width() == cold.width() );
+    REQUIRE( warm.height() == cold.height() );
+    REQUIRE( warm == cold );
+    REQUIRE( warm == uncached );
+  }
+
+  SECTION("writing to a cached image leaves the cache entry unchanged") {
+    PNG warm;
+    REQUIRE( warm.readFromFile(source, true) );
+    for (unsigned x = 0; x < warm.width(); x++) {
+      warm.getPixel(x, 0) = HSLAPixel(120, 1, 0.25, 1);
+    }
+    REQUIRE( readBytes(entry) == stored );
+
+    PNG again;
+    REQUIRE( again.readFromFile(source, true) );
+    REQUIRE( again == uncached );
+    REQUIRE( !(again == warm) );
+  }
+
+  SECTION("changing the source's modification time is a miss") {
+    struct timeval times[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+    REQUIRE( utimes(source.c_str(), times) == 0 );
+    PNG reread;
+    REQUIRE( reread.readFromFile(source, true) );
+    REQUIRE( cacheEntries(directory).size() == 2 );
+    REQUIRE( reread == uncached );
+  }
+
+  for (std::string const & name : cacheEntries(directory)) {
+    std::remove((directory + "/" + name).c_str());
+  }
+  rmdir(directory.c_str());
+  std::remove(source.c_str());
+}
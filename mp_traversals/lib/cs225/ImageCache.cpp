@@ -0,0 +1,272 @@
+/**
+ * @file ImageCache.cpp
+ * Implementation of the on-disk decoded image cache.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CS225_HAVE_MMAP 1
+#endif
+
+#include "ImageCache.h"
+
+namespace cs225 {
+  /** Entries start with a header padded to this size, so the pixels that
+   * follow are page-aligned when the entry is mapped. */
+  static const std::size_t headerSize = 4096;
+
+  /** Changed whenever the entry format changes, so old entries are misses. */
+  static const std::uint32_t entryVersion = 1;
+
+  static const char entryMagic[8] = { 'C', 'S', '2', '2', '5', 'R', 'A', 'W' };
+
+  /** Start of every entry; the rest of the first headerSize bytes is zero. */
+  struct EntryHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t reserved;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint64_t dataSize;
+    char layout[32];
+  };
+
+  /** 64-bit FNV-1a, plenty to name entries by. */
+  static std::uint64_t fnv1a(std::string const & text) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : text) {
+      hash ^= c;
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  ImageCache::ImageCache(std::string const & directory, std::uint64_t maxBytes)
+    : directory_(directory), maxBytes_(maxBytes), usedBytes_(0), scanned_(false) { }
+
+  ImageCache & ImageCache::shared() {
+    static ImageCache cache([]() {
+      if (const char * dir = std::getenv("CS225_IMAGE_CACHE")) { return std::string(dir); }
+      if (const char * xdg = std::getenv("XDG_CACHE_HOME")) { return std::string(xdg) + "/cs225"; }
+      if (const char * home = std::getenv("HOME")) { return std::string(home) + "/.cache/cs225"; }
+      return std::string("/tmp/cs225-cache");
+    }(), []() {
+      const char * mb = std::getenv("CS225_IMAGE_CACHE_MB");
+      return std::uint64_t(mb ? std::strtoull(mb, NULL, 10) : 1024) << 20;
+    }());
+    return cache;
+  }
+
+  std::string const & ImageCache::directory() const {
+    return directory_;
+  }
+
+  std::uint64_t ImageCache::maxBytes() const {
+    return maxBytes_;
+  }
+
+  void ImageCache::setMaxBytes(std::uint64_t maxBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxBytes_ = maxBytes;
+    _evict();
+  }
+
+  void ImageCache::evict() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    _evict();
+  }
+
+#ifdef CS225_HAVE_MMAP
+  bool ImageCache::_entryPath(std::string const & fileName, std::string const & layout, std::string & path,
+                              std::uint64_t & sourceSize, std::int64_t & sourceTime) const {
+    struct stat info;
+    if (::stat(fileName.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) { return false; }
+    sourceSize = static_cast<std::uint64_t>(info.st_size);
+#ifdef __APPLE__
+    sourceTime = (std::int64_t(info.st_mtimespec.tv_sec) * 1000000000) + info.st_mtimespec.tv_nsec;
+#else
+    sourceTime = (std::int64_t(info.st_mtim.tv_sec) * 1000000000) + info.st_mtim.tv_nsec;
+#endif
+
+    // The same file reached through different relative paths is one entry
+    char resolved[PATH_MAX];
+    std::string key = ::realpath(fileName.c_str(), resolved) ? resolved : fileName;
+    key += '\n' + layout + '\n' + std::to_string(sourceSize) + '\n' + std::to_string(sourceTime);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.raw", static_cast<unsigned long long>(fnv1a(key)));
+    path = directory_ + "/" + name;
+    return true;
+  }
+
+  bool ImageCache::load(std::string const & fileName, std::string const & layout, Entry & entry) {
+    std::string path;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    if (!_entryPath(fileName, layout, path, sourceSize, sourceTime)) { return false; }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat info;
+    void * region = MAP_FAILED;
+    std::size_t length = 0;
+    if (::fstat(fd, &info) == 0 && std::size_t(info.st_size) >= headerSize) {
+      length = static_cast<std::size_t>(info.st_size);
+      // Private and writable: pages the PNG writes to are copied, never written back
+      region = ::mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    if (region != MAP_FAILED) {
+      // Mark the entry as recently used for eviction
+      ::futimens(fd, NULL);
+    }
+    ::close(fd);
+    if (region == MAP_FAILED) { return false; }
+
+    const EntryHeader * header = static_cast<const EntryHeader *>(region);
+    if (std::memcmp(header->magic, entryMagic, sizeof(entryMagic)) != 0
+        || header->version != entryVersion
+        || header->sourceSize != sourceSize
+        || header->sourceTime != sourceTime
+        || header->dataSize != length - headerSize
+        || layout.compare(0, std::string::npos, header->layout, strnlen(header->layout, sizeof(header->layout))) != 0) {
+      ::munmap(region, length);
+      return false;
+    }
+
+    ::madvise(region, length, MADV_WILLNEED);
+    unsigned char * base = static_cast<unsigned char *>(region);
+    entry.width = header->width;
+    entry.height = header->height;
+    entry.size = header->dataSize;
+    entry.pixels = std::shared_ptr<unsigned char>(base + headerSize, [base, length](unsigned char *) {
+      ::munmap(base, length);
+    });
+    return true;
+  }
+
+  /** Creates `path` and any missing parent directories. */
+  static bool makeDirectories(std::string const & path) {
+    for (std::size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+      std::string prefix = path.substr(0, slash);
+      if (::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) { return false; }
+      if (slash == std::string::npos) { return true; }
+    }
+  }
+
+  /** Writes all of `size` bytes, retrying short writes. */
+  static bool writeAll(int fd, const void * data, std::size_t size) {
+    const char * p = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t written = ::write(fd, p, size);
+      if (written < 0) {
+        if (errno == EINTR) { continue; }
+        return false;
+      }
+      p += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  bool ImageCache::store(std::string const & fileName, std::string const & layout,
+                         unsigned int width, unsigned int height,
+                         const void * pixels, std::size_t size) {
+    std::string path;
+    EntryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (layout.size() >= sizeof(header.layout)) { return false; }
+    if (!_entryPath(fileName, layout, path, header.sourceSize, header.sourceTime)) { return false; }
+    if (!makeDirectories(directory_)) { return false; }
+
+    std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.version = entryVersion;
+    header.width = width;
+    header.height = height;
+    header.dataSize = size;
+    std::memcpy(header.layout, layout.data(), layout.size());
+
+    // Write to a private name and rename into place, so that a concurrent
+    // load never sees a partial entry
+    static std::atomic<unsigned> counter(0);
+    std::string temp = path + ".tmp" + std::to_string(::getpid()) + "-" + std::to_string(counter++);
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { return false; }
+    std::vector<unsigned char> page(headerSize, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+    bool ok = writeAll(fd, page.data(), page.size()) && writeAll(fd, pixels, size);
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || ::rename(temp.c_str(), path.c_str()) != 0) {
+      ::unlink(temp.c_str());
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    usedBytes_ += headerSize + size;
+    if (!scanned_ || usedBytes_ > maxBytes_) { _evict(); }
+    return true;
+  }
+
+  void ImageCache::_evict() {
+    DIR * dir = ::opendir(directory_.c_str());
+    if (!dir) { return; }
+
+    // Other runs share the directory, so measure it rather than trust usedBytes_
+    std::vector<std::pair<std::int64_t, std::pair<std::string, std::uint64_t>>> entries;
+    std::uint64_t used = 0;
+    while (dirent * item = ::readdir(dir)) {
+      std::string name = item->d_name;
+      if (name.size() < 4 || name.compare(name.size() - 4, 4, ".raw") != 0) { continue; }
+      std::string path = directory_ + "/" + name;
+      struct stat info;
+      if (::stat(path.c_str(), &info) != 0) { continue; }
+      entries.push_back({ std::int64_t(info.st_mtime), { path, std::uint64_t(info.st_size) } });
+      used += info.st_size;
+    }
+    ::closedir(dir);
+
+    if (used > maxBytes_) {
+      std::sort(entries.begin(), entries.end());
+      for (std::size_t i = 0; i < entries.size() && used > maxBytes_; i++) {
+        if (::unlink(entries[i].second.first.c_str()) == 0) { used -= entries[i].second.second; }
+      }
+    }
+    usedBytes_ = used;
+    scanned_ = true;
+  }
+#else
+  bool ImageCache::_entryPath(std::string const &, std::string const &, std::string &,
+                              std::uint64_t &, std::int64_t &) const {
+    return false;
+  }
+
+  bool ImageCache::load(std::string const &, std::string const &, Entry &) {
+    return false;
+  }
+
+  bool ImageCache::store(std::string const &, std::string const &, unsigned int, unsigned int,
+                         const void *, std::size_t) {
+    return false;
+  }
+
+  void ImageCache::_evict() { }
+#endif
+}
@@ -16,47 +16,119 @@ using std::string;
 using std::vector;
 
 #include <cassert>
+#include <cstring>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 
 #include "lodepng/lodepng.h"
 #include "PNG.h"
+#include "ContentHash.h"
+#include "ImageCache.h"
+#include "MappedFile.h"
 #include "RGB_HSL.h"
+#include "RGB_HSL_Batch.h"
+#include "ThreadPool.h"
 
 
 namespace cs225 {
   void PNG::_copy(PNG const & other) {
     // Clear self
-    delete[] imageData_;
+    _release();
 
     // Copy `other` to self
     width_ = other.width_;
     height_ = other.height_;
-    imageData_ = new HSLAPixel[width_ * height_];
-    for (unsigned i = 0; i < width_ * height_; i++) {
-      imageData_[i] = other.imageData_[i];
+    format_ = other.format_;
+    packedData_ = other.packedData_;
+    digest_ = other.digest_;
+    digestValid_ = other.digestValid_;
+    if (format_ != PixelFormat::HSLA64) { return; }
+
+    if (other.buffer_ && other.shareable_) {
+      // Share the pixels until either image hands out mutable access
+      buffer_ = other.buffer_;
+      imageData_ = other.imageData_;
+      capacity_ = other.capacity_;
+      return;
     }
+
+    _allocate(width_ * height_);
+    std::copy(other.imageData_, other.imageData_ + (width_ * height_), imageData_);
+  }
+
+  void PNG::_allocate(unsigned int count) const {
+    buffer_.reset(new HSLAPixel[count]);
+    imageData_ = buffer_.get();
+    capacity_ = count;
+    shareable_ = true;
+  }
+
+  void PNG::_release() const {
+    buffer_.reset();
+    imageData_ = NULL;
+    capacity_ = 0;
+    shareable_ = true;
+  }
+
+  void PNG::_detach() {
+    _own();
+    shareable_ = false;
+  }
+
+  void PNG::_own() {
+    _expand();
+    if (buffer_ && buffer_.use_count() > 1) {
+      std::shared_ptr<HSLAPixel[]> shared = buffer_;
+      _allocate(width_ * height_);
+      std::copy(shared.get(), shared.get() + (width_ * height_), imageData_);
+    }
+    digestValid_ = false;
+  }
+
+  void PNG::_expand() const {
+    if (format_ == PixelFormat::HSLA64) { return; }
+
+    unsigned count = width_ * height_;
+    _allocate(count);
+    unpackPixels(format_, packedData_.data(), imageData_, 0, count, count);
+
+    std::vector<unsigned char>().swap(packedData_);
+    format_ = PixelFormat::HSLA64;
   }
 
   PNG::PNG() {
     width_ = 0;
     height_ = 0;
+    format_ = PixelFormat::HSLA64;
     imageData_ = NULL;
+    capacity_ = 0;
+    shareable_ = true;
+    digestValid_ = false;
   }
 
   PNG::PNG(unsigned int width, unsigned int height) {
     width_ = width;
     height_ = height;
-    imageData_ = new HSLAPixel[width * height];
+    format_ = PixelFormat::HSLA64;
+    digestValid_ = false;
+    _allocate(width * height);
   }
 
   PNG::PNG(PNG const & other) {
     imageData_ = NULL;
+    capacity_ = 0;
     _copy(other);
   }
 
+  PNG::PNG(PNG && other) noexcept {
+    imageData_ = NULL;
+    digestValid_ = false;
+    *this = std::move(other);
+  }
+
   PNG::~PNG() {
-    delete[] imageData_;
+    _release();
   }
 
   PNG const & PNG::operator=(PNG const & other) {
@@ -64,28 +136,81 @@ namespace cs225 {
     return *this;
   }
 
+  PNG const & PNG::operator=(PNG && other) noexcept {
+    if (this == &other) { return *this; }
+
+    // Take `other`'s storage
+    width_ = other.width_;
+    height_ = other.height_;
+    format_ = other.format_;
+    buffer_ = std::move(other.buffer_);
+    imageData_ = other.imageData_;
+    capacity_ = other.capacity_;
+    shareable_ = other.shareable_;
+    packedData_ = std::move(other.packedData_);
+    digest_ = other.digest_;
+    digestValid_ = other.digestValid_;
+
+    // Leave `other` as an empty image
+    other.width_ = 0;
+    other.height_ = 0;
+    other.format_ = PixelFormat::HSLA64;
+    other._release();
+    other.packedData_.clear();
+    other.digestValid_ = false;
+    return *this;
+  }
+
+  /** Pixels hashed by each task of _computeDigest() and compared by
+   * each task of _samePixels(); fixed, so that the digest does not
+   * depend on the number of threads. */
+  static const std::size_t digestBlockPixels = 65536;
+
   bool PNG::operator== (PNG const & other) const {
     if (width_ != other.width_) { return false; }
     if (height_ != other.height_) { return false; }
 
-    hslaColor hslaSpace1;
-    hslaColor hslaSpace2;
-    rgbaColor rgbaSpace1;
-    rgbaColor rgbaSpace2;
-    for (unsigned i = 0; i < width_ * height_; i++) {
-      HSLAPixel & p1 = imageData_[i];
-      HSLAPixel & p2 = other.imageData_[i];
-      hslaSpace1 = {p1.h, p1.s, p1.l, p1.a};
-      hslaSpace2 = {p2.h, p2.s, p2.l, p2.a};
-      rgbaSpace1 = hsl2rgb(hslaSpace1);
-      rgbaSpace2 = hsl2rgb(hslaSpace2);
-      if (rgbaSpace1.r != rgbaSpace2.r
-          || rgbaSpace1.g != rgbaSpace2.g
-          || rgbaSpace1.b != rgbaSpace2.b
-          || rgbaSpace1.a != rgbaSpace2.a) { return false; }
+    // Copies sharing a buffer are trivially equal
+    if (format_ == PixelFormat::HSLA64 && imageData_ == other.imageData_) { return true; }
+
+    // Different digests settle it; equal ones may still be a collision
+    if (digest() != other.digest()) { return false; }
+    return _samePixels(other);
+  }
+
+  bool PNG::_samePixels(PNG const & other) const {
+    if (format_ != PixelFormat::RGBA8) { _expand(); }
+    if (other.format_ != PixelFormat::RGBA8) { other._expand(); }
+
+    std::size_t count = std::size_t(width_) * height_;
+    if (format_ == PixelFormat::RGBA8 && other.format_ == PixelFormat::RGBA8) {
+      return std::memcmp(packedData_.data(), other.packedData_.data(), count * 4) == 0;
     }
 
-    return true;
+    // Compare the 8-bit RGBA values block by block, as digest() hashes them
+    std::size_t blocks = (count + digestBlockPixels - 1) / digestBlockPixels;
+    std::atomic<bool> same(true);
+    PNG const * images[2] = { this, &other };
+    ThreadPool::shared().parallelFor(blocks, 1,
+      [&same, &images, count](std::size_t begin, std::size_t end) {
+        vector<unsigned char> rgba[2];
+        for (std::size_t i = begin; i < end && same; i++) {
+          std::size_t first = i * digestBlockPixels;
+          std::size_t length = std::min(digestBlockPixels, count - first);
+          const unsigned char * bytes[2];
+          for (int k = 0; k < 2; k++) {
+            if (images[k]->format_ == PixelFormat::RGBA8) {
+              bytes[k] = images[k]->packedData_.data() + (first * 4);
+            } else {
+              rgba[k].resize(length * 4);
+              hsla2rgbaBatch(images[k]->imageData_ + first, rgba[k].data(), length);
+              bytes[k] = rgba[k].data();
+            }
+          }
+          if (std::memcmp(bytes[0], bytes[1], length * 4) != 0) { same = false; }
+        }
+      });
+    return same;
   }
 
   bool PNG::operator!= (PNG const & other) const {
@@ -93,6 +218,8 @@ namespace cs225 {
   }
 
   HSLAPixel & PNG::_getPixelHelper(unsigned int x, unsigned int y) const {
+    _expand();
+
     if (width_ == 0 || height_ == 0) {
       cerr << "ERROR: Call to cs225::PNG::getPixel() made on an image with no pixels." << endl;
       assert(width_ > 0);
@@ -117,59 +244,210 @@ namespace cs225 {
     return imageData_[index];
   }
 
-  HSLAPixel & PNG::getPixel(unsigned int x, unsigned int y) { return _getPixelHelper(x,y); }
+  HSLAPixel & PNG::getPixel(unsigned int x, unsigned int y) {
+    _detach();
+    return _getPixelHelper(x,y);
+  }
 
   const HSLAPixel & PNG::getPixel(unsigned int x, unsigned int y) const { return _getPixelHelper(x,y); }
 
-  bool PNG::readFromFile(string const & fileName) {
-    vector<unsigned char> byteData;
-    unsigned error = lodepng::decode(byteData, width_, height_, fileName);
+  HSLAPixel * PNG::row(unsigned int y) {
+    _detach();
+    assert(y < height_);
+    return imageData_ + (y * width_);
+  }
 
-    if (error) {
-      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
-      return false;
+  const HSLAPixel * PNG::row(unsigned int y) const {
+    _expand();
+    assert(y < height_);
+    return imageData_ + (y * width_);
+  }
+
+  /**
+   * Number of rows handed to one ThreadPool task: enough pixels that the
+   * task outweighs the cost of scheduling it.
+   */
+  static std::size_t rowGrain(unsigned int width) {
+    const std::size_t pixelsPerTask = 16384;
+    return std::max<std::size_t>(1, pixelsPerTask / std::max(1u, width));
+  }
+
+  void PNG::forEachRow(RowKernel const & kernel) {
+    _detach();
+    if (width_ == 0) { return; }
+
+    HSLAPixel * data = imageData_;
+    unsigned int width = width_;
+    ThreadPool::shared().parallelFor(height_, rowGrain(width_),
+      [&kernel, data, width](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; y++) {
+          kernel(y, data + (y * width));
+        }
+      });
+  }
+
+  void PNG::forEachRow(ConstRowKernel const & kernel) const {
+    _expand();
+    if (width_ == 0) { return; }
+
+    const HSLAPixel * data = imageData_;
+    unsigned int width = width_;
+    ThreadPool::shared().parallelFor(height_, rowGrain(width_),
+      [&kernel, data, width](std::size_t begin, std::size_t end) {
+        for (std::size_t y = begin; y < end; y++) {
+          kernel(y, data + (y * width));
+        }
+      });
+  }
+
+  unsigned PNG::_storeRows(void * png, unsigned int y, unsigned int count, const unsigned char * rows) {
+    PNG & image = *static_cast<PNG *>(png);
+    unsigned int width = image.width_;
+    unsigned int total = width * image.height_;
+
+    // The first rows arrive once the header has set the image size
+    if (y == 0) {
+      if (image.format_ == PixelFormat::HSLA64) { image._allocate(total); }
+      else { image.packedData_.resize(total * bytesPerPixel(image.format_)); }
+    }
+
+    if (image.format_ == PixelFormat::RGBA8) {
+      std::copy(rows, rows + (count * width * 4), image.packedData_.data() + (y * width * 4));
+    } else if (image.format_ == PixelFormat::HSLA64) {
+      HSLAPixel * pixels = image.imageData_ + (y * width);
+      ThreadPool::shared().parallelFor(count, rowGrain(width),
+        [rows, pixels, width](std::size_t begin, std::size_t end) {
+          std::size_t first = begin * width;
+          rgba2hslaBatch(rows + (first * 4), pixels + first, (end - begin) * width);
+        });
+    } else {
+      vector<HSLAPixel> row(width);
+      for (unsigned int r = 0; r < count; r++) {
+        unpackPixels(PixelFormat::RGBA8, rows, row.data(), r * width, width, count * width);
+        packPixels(image.format_, row.data(), image.packedData_.data(), (y + r) * width, width, total);
+      }
+    }
+    return 0;
+  }
+
+  /**
+   * Encodes 8-bit RGBA pixels with the given options and writes the result
+   * to a file. Returns the lodepng error code.
+   */
+  static unsigned encodeToFile(string const & fileName, const unsigned char * rgba,
+                               unsigned int width, unsigned int height, EncodeOptions const & options) {
+    lodepng::State state;
+    applyEncodeOptions(options, state.encoder);
+
+    vector<unsigned char> png;
+    unsigned error = lodepng::encode(png, rgba, width, height, state);
+    if (!error) { error = lodepng::save_file(png, fileName); }
+    return error;
+  }
+
+  /** Names the layout of the pixels of each format in the ImageCache. */
+  static const char * cacheLayout(PixelFormat format) {
+    static_assert(sizeof(HSLAPixel) == 32, "cached HSLA64 pixels are four packed doubles");
+    switch (format) {
+      case PixelFormat::HSLA64: return "cs225::PNG/HSLA64";
+      case PixelFormat::RGBA8: return "cs225::PNG/RGBA8";
+      case PixelFormat::HSLA32: return "cs225::PNG/HSLA32";
+      case PixelFormat::HSLA32_PLANAR: return "cs225::PNG/HSLA32_PLANAR";
     }
+    return "";
+  }
 
-    delete[] imageData_;
-    imageData_ = new HSLAPixel[width_ * height_];
+  bool PNG::readFromFile(string const & fileName, bool useCache) {
+    if (useCache && _readFromCache(fileName)) { return true; }
+
+    // Decode straight out of the page cache instead of copying the file
+    MappedFile file(fileName);
+    if (!file.isOpen()) {
+      cerr << "PNG decoder error 78: " << lodepng_error_text(78) << endl;
+      return false;
+    }
+    if (!readFromMemory(file.data(), file.size())) { return false; }
 
-    for (unsigned i = 0; i < byteData.size(); i += 4) {
-      rgbaColor rgb;
-      rgb.r = byteData[i];
-      rgb.g = byteData[i + 1];
-      rgb.b = byteData[i + 2];
-      rgb.a = byteData[i + 3];
+    if (useCache) {
+      std::size_t bytes = std::size_t(width_) * height_ * bytesPerPixel(format_);
+      const void * pixels = (format_ == PixelFormat::HSLA64) ? static_cast<const void *>(imageData_)
+                                                             : static_cast<const void *>(packedData_.data());
+      ImageCache::shared().store(fileName, cacheLayout(format_), width_, height_, pixels, bytes);
+    }
+    return true;
+  }
 
-      hslaColor hsl = rgb2hsl(rgb);
-      HSLAPixel & pixel = imageData_[i/4];
-      pixel.h = hsl.h;
-      pixel.s = hsl.s;
-      pixel.l = hsl.l;
-      pixel.a = hsl.a;
+  bool PNG::_readFromCache(string const & fileName) {
+    ImageCache::Entry entry;
+    if (!ImageCache::shared().load(fileName, cacheLayout(format_), entry)) { return false; }
+    std::size_t count = std::size_t(entry.width) * entry.height;
+    if (entry.size != count * bytesPerPixel(format_)) { return false; }
+
+    PNG cached;
+    cached.width_ = entry.width;
+    cached.height_ = entry.height;
+    cached.format_ = format_;
+    if (format_ == PixelFormat::HSLA64) {
+      // Use the mapped pixels as the buffer; it unmaps them when released
+      HSLAPixel * pixels = reinterpret_cast<HSLAPixel *>(entry.pixels.get());
+      cached.buffer_ = std::shared_ptr<HSLAPixel[]>(entry.pixels, pixels);
+      cached.imageData_ = pixels;
+      cached.capacity_ = count;
+    } else {
+      cached.packedData_.assign(entry.pixels.get(), entry.pixels.get() + entry.size);
     }
 
+    *this = std::move(cached);
     return true;
   }
 
-  bool PNG::writeToFile(string const & fileName) {
-    unsigned char *byteData = new unsigned char[width_ * height_ * 4];
+  bool PNG::readFromMemory(const unsigned char * data, std::size_t size) {
+    // Decode row by row straight into the new image's storage
+    PNG decoded;
+    decoded.format_ = format_;
+    lodepng::State state;
+    unsigned error = lodepng_decode_scanlines(&decoded.width_, &decoded.height_, &state,
+                                              data, size, _storeRows, &decoded);
 
-    for (unsigned i = 0; i < width_ * height_; i++) {
-      hslaColor hsl;
-      hsl.h = imageData_[i].h;
-      hsl.s = imageData_[i].s;
-      hsl.l = imageData_[i].l;
-      hsl.a = imageData_[i].a;
+    if (error) {
+      cerr << "PNG decoder error " << error << ": " << lodepng_error_text(error) << endl;
+      return false;
+    }
 
-      rgbaColor rgb = hsl2rgb(hsl);
+    *this = std::move(decoded);
+    return true;
+  }
 
-      byteData[(i * 4)]     = rgb.r;
-      byteData[(i * 4) + 1] = rgb.g;
-      byteData[(i * 4) + 2] = rgb.b;
-      byteData[(i * 4) + 3] = rgb.a;
+  bool PNG::writeToFile(string const & fileName, EncodeOptions const & options) {
+    if (format_ == PixelFormat::RGBA8) {
+      unsigned error = encodeToFile(fileName, packedData_.data(), width_, height_, options);
+      if (error) {
+        cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
+      }
+      return (error == 0);
     }
 
-    unsigned error = lodepng::encode(fileName, byteData, width_, height_);
+    unsigned char *byteData = new unsigned char[width_ * height_ * 4];
+
+    if (format_ != PixelFormat::HSLA64) {
+      // Convert one row at a time rather than expanding the whole image
+      unsigned count = width_ * height_;
+      vector<HSLAPixel> row(width_);
+      for (unsigned y = 0; y < height_; y++) {
+        unpackPixels(format_, packedData_.data(), row.data(), y * width_, width_, count);
+        packPixels(PixelFormat::RGBA8, row.data(), byteData, y * width_, width_, count);
+      }
+    } else {
+      const HSLAPixel * pixels = imageData_;
+      unsigned int width = width_;
+      ThreadPool::shared().parallelFor(height_, rowGrain(width_),
+        [byteData, pixels, width](std::size_t begin, std::size_t end) {
+          std::size_t first = begin * width;
+          hsla2rgbaBatch(pixels + first, byteData + (first * 4), (end - begin) * width);
+        });
+    }
+
+    unsigned error = encodeToFile(fileName, byteData, width_, height_, options);
     if (error) {
       cerr << "PNG encoding error " << error << ": " << lodepng_error_text(error) << endl;
     }
@@ -187,45 +465,217 @@ namespace cs225 {
   }
 
   void PNG::resize(unsigned int newWidth, unsigned int newHeight) {
-    // Create a new vector to store the image data for the new (resized) image
-    HSLAPixel * newImageData = new HSLAPixel[newWidth * newHeight];
-
-    // Copy the current data to the new image data, using the existing pixel
-    // for coordinates within the bounds of the old image size
-    for (unsigned x = 0; x < newWidth; x++) {
-      for (unsigned y = 0; y < newHeight; y++) {
-        if (x < width_ && y < height_) {
-          HSLAPixel & oldPixel = this->getPixel(x, y);
-          HSLAPixel & newPixel = newImageData[ (x + (y * newWidth)) ];
-          newPixel = oldPixel;
+    _expand();
+
+    std::size_t count = std::size_t(newWidth) * newHeight;
+    unsigned rows = std::min(height_, newHeight);
+    unsigned columns = std::min(width_, newWidth);
+
+    if (buffer_ && buffer_.use_count() == 1 && count <= capacity_) {
+      // Move the rows within the current buffer: narrowing moves each row
+      // towards the front, so go top to bottom; widening moves them towards
+      // the back, so go bottom to top and whiten the end of each row
+      HSLAPixel * data = imageData_;
+      if (newWidth <= width_) {
+        for (unsigned y = 0; y < rows; y++) {
+          std::memmove(data + (std::size_t(y) * newWidth), data + (std::size_t(y) * width_),
+                       columns * sizeof(HSLAPixel));
+        }
+      } else {
+        for (unsigned y = rows; y-- > 0; ) {
+          HSLAPixel * row = data + (std::size_t(y) * newWidth);
+          std::memmove(row, data + (std::size_t(y) * width_), columns * sizeof(HSLAPixel));
+          std::fill(row + columns, row + newWidth, HSLAPixel());
         }
       }
+      std::fill(data + (std::size_t(rows) * newWidth), data + count, HSLAPixel());
+    } else {
+      // Keep the current pixels (which may be shared) alive while a new
+      // buffer for the resized image replaces them
+      std::shared_ptr<HSLAPixel[]> oldBuffer = buffer_;
+      const HSLAPixel * oldImageData = imageData_;
+      _allocate(count);
+      for (unsigned y = 0; y < rows; y++) {
+        std::memcpy(imageData_ + (std::size_t(y) * newWidth), oldImageData + (std::size_t(y) * width_),
+                    columns * sizeof(HSLAPixel));
+      }
     }
 
-    // Clear the existing image
-    delete[] imageData_;
-
-    // Update the image to reflect the new image size and data
+    // Update the image to reflect the new image size
     width_ = newWidth;
     height_ = newHeight;
-    imageData_ = newImageData;
+    digestValid_ = false;
   }
 
-  std::ostream & operator << ( std::ostream& os, PNG const& png ) {
-    std::hash<double> hashFunction;
-    std::size_t hash = 0;
-
-    for (unsigned x = 0; x < png.width(); x++) {
-      for (unsigned y = 0; y < png.height(); y++) {
-        const HSLAPixel &pixel = png.getPixel(x, y);
-        hash ^= hashFunction(pixel.h);
-        hash ^= hashFunction(pixel.s);
-        hash ^= hashFunction(pixel.l);
-        hash ^= hashFunction(pixel.a);
+  void PNG::reserve(std::size_t pixels) {
+    _expand();
+    if (pixels <= capacity_) { return; }
+
+    std::shared_ptr<HSLAPixel[]> oldBuffer = buffer_;
+    const HSLAPixel * oldImageData = imageData_;
+    bool shareable = shareable_;
+    _allocate(pixels);
+    shareable_ = shareable;
+    if (oldImageData) {
+      std::memcpy(imageData_, oldImageData, std::size_t(width_) * height_ * sizeof(HSLAPixel));
+    }
+  }
+
+  std::size_t PNG::capacity() const {
+    return capacity_;
+  }
+
+  PNG PNG::crop(Rect const & rect) const {
+    unsigned x = std::min(rect.x, width_);
+    unsigned y = std::min(rect.y, height_);
+    PNG cropped(std::min(rect.width, width_ - x), std::min(rect.height, height_ - y));
+    cropped.blit(*this, Rect{x, y, cropped.width_, cropped.height_}, 0, 0);
+    return cropped;
+  }
+
+  void PNG::fill(Rect const & rect, HSLAPixel const & color) {
+    unsigned x = std::min(rect.x, width_);
+    unsigned y = std::min(rect.y, height_);
+    unsigned columns = std::min(rect.width, width_ - x);
+    unsigned rows = std::min(rect.height, height_ - y);
+    if (columns == 0 || rows == 0) { return; }
+
+    _own();
+    for (unsigned row = y; row < y + rows; row++) {
+      HSLAPixel * start = imageData_ + (std::size_t(row) * width_) + x;
+      std::fill(start, start + columns, color);
+    }
+  }
+
+  void PNG::blit(PNG const & source, Rect const & rect, unsigned int dstX, unsigned int dstY,
+                 bool skipTransparent) {
+    // Clip the rectangle to both images
+    unsigned x = std::min(rect.x, source.width_);
+    unsigned y = std::min(rect.y, source.height_);
+    unsigned columns = std::min(rect.width, source.width_ - x);
+    unsigned rows = std::min(rect.height, source.height_ - y);
+    columns = std::min(columns, width_ - std::min(dstX, width_));
+    rows = std::min(rows, height_ - std::min(dstY, height_));
+    if (columns == 0 || rows == 0) { return; }
+
+    _own();
+    source._expand();
+    const HSLAPixel * from = source.imageData_ + x + (std::size_t(y) * source.width_);
+    HSLAPixel * to = imageData_ + dstX + (std::size_t(dstY) * width_);
+
+    // Within one image, copy bottom to top (and right to left) when moving
+    // pixels forward, so that no pixel is overwritten before it is read
+    bool backwards = (source.imageData_ == imageData_) && to > from;
+    for (unsigned step = 0; step < rows; step++) {
+      unsigned row = backwards ? (rows - 1 - step) : step;
+      const HSLAPixel * src = from + (std::size_t(row) * source.width_);
+      HSLAPixel * dst = to + (std::size_t(row) * width_);
+      if (skipTransparent) {
+        for (unsigned i = 0; i < columns; i++) {
+          unsigned column = backwards ? (columns - 1 - i) : i;
+          if (src[column].a != 0) { dst[column] = src[column]; }
+        }
+      } else {
+        std::memmove(dst, src, columns * sizeof(HSLAPixel));
       }
     }
+  }
+
+  void PNG::blit(PNG const & source, SpanMask const & mask, Rect const & rect,
+                 unsigned int dstX, unsigned int dstY) {
+    assert(&source != this);
+    assert(mask.width() == source.width_ && mask.height() == source.height_);
+    unsigned x = std::min(rect.x, source.width_);
+    unsigned y = std::min(rect.y, source.height_);
+    unsigned columns = std::min(rect.width, source.width_ - x);
+    unsigned rows = std::min(rect.height, source.height_ - y);
+    columns = std::min(columns, width_ - std::min(dstX, width_));
+    rows = std::min(rows, height_ - std::min(dstY, height_));
+    if (columns == 0 || rows == 0) { return; }
+
+    _own();
+    source._expand();
+    unsigned right = x + columns;
+    for (unsigned row = 0; row < rows; row++) {
+      const HSLAPixel * src = source.imageData_ + (std::size_t(y + row) * source.width_);
+      HSLAPixel * dst = imageData_ + (std::size_t(dstY + row) * width_) + dstX;
+      for (const SpanMask::Span * span = mask.rowBegin(y + row); span != mask.rowEnd(y + row); span++) {
+        if (span->end <= x) { continue; }
+        if (span->begin >= right) { break; }
+        unsigned begin = std::max(span->begin, x);
+        unsigned end = std::min(span->end, right);
+        std::memcpy(dst + (begin - x), src + begin, (end - begin) * sizeof(HSLAPixel));
+      }
+    }
+  }
+
+  std::uint64_t PNG::digest() const {
+    if (digestValid_) { return digest_; }
+
+    std::uint64_t digest = _computeDigest();
+    // Pixels handed out by reference may change without the image noticing
+    if (format_ != PixelFormat::HSLA64 || shareable_) {
+      digest_ = digest;
+      digestValid_ = true;
+    }
+    return digest;
+  }
+
+  std::uint64_t PNG::_computeDigest() const {
+    if (format_ != PixelFormat::RGBA8) { _expand(); }
+
+    // Hash the RGBA bytes in fixed-size blocks on the thread pool, then hash
+    // the block hashes together with the dimensions
+    std::size_t count = std::size_t(width_) * height_;
+    std::size_t blocks = (count + digestBlockPixels - 1) / digestBlockPixels;
+    vector<std::uint64_t> hashes(blocks + 1);
+    hashes[blocks] = (std::uint64_t(width_) << 32) | height_;
+
+    const unsigned char * packed = packedData_.data();
+    const HSLAPixel * data = imageData_;
+    bool convert = (format_ == PixelFormat::HSLA64);
+    ThreadPool::shared().parallelFor(blocks, 1,
+      [&hashes, packed, data, convert, count](std::size_t begin, std::size_t end) {
+        vector<unsigned char> rgba;
+        for (std::size_t i = begin; i < end; i++) {
+          std::size_t first = i * digestBlockPixels;
+          std::size_t length = std::min(digestBlockPixels, count - first);
+          const unsigned char * bytes = packed + (first * 4);
+          if (convert) {
+            rgba.resize(length * 4);
+            hsla2rgbaBatch(data + first, rgba.data(), length);
+            bytes = rgba.data();
+          }
+          hashes[i] = xxHash64(bytes, length * 4);
+        }
+      });
+
+    return xxHash64(hashes.data(), hashes.size() * sizeof(std::uint64_t));
+  }
+
+  PixelFormat PNG::pixelFormat() const {
+    return format_;
+  }
+
+  void PNG::setPixelFormat(PixelFormat format) {
+    if (format == format_) { return; }
+    _expand();
+    if (format == PixelFormat::HSLA64) { return; }
+
+    // Packing to RGBA8 keeps exactly the bytes the digest is taken over;
+    // the other formats round the HSLA channels instead
+    if (format != PixelFormat::RGBA8) { digestValid_ = false; }
+
+    unsigned count = width_ * height_;
+    packedData_.resize(count * bytesPerPixel(format));
+    packPixels(format, imageData_, packedData_.data(), 0, count, count);
 
-    os << "PNG(w=" << png.width() << ", h=" << png.height() << ", hash=" << std::hex << hash << std::dec << ")";
+    _release();
+    format_ = format;
+  }
+
+  std::ostream & operator << ( std::ostream& os, PNG const& png ) {
+    os << "PNG(w=" << png.width() << ", h=" << png.height() << ", hash=" << std::hex << png.digest() << std::dec << ")";
     return os;
   }
 
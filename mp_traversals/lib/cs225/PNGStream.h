@@ -0,0 +1,145 @@
+/**
+ * @file PNGStream.h
+ * Reading and writing PNG files one row at a time.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EncodeOptions.h"
+#include "HSLAPixel.h"
+
+namespace cs225 {
+  class MappedFile;
+
+  /**
+   * Decodes a PNG file row by row, for images too large to hold as a PNG.
+   * Only a few hundred kilobytes of rows and the 32 KB inflate window are
+   * held at a time, besides the file's compressed pixel data.
+   */
+  class PNGReader {
+  public:
+    /**
+      * Called with each row of the image in turn, from the top; the row
+      * is only valid during the call. Returns false to stop reading.
+      */
+    typedef std::function<bool(unsigned int y, const HSLAPixel * row)> RowFunction;
+
+    /**
+      * Creates a reader with no file open.
+      */
+    PNGReader();
+
+    /**
+      * Destructor: closes the file.
+      */
+    ~PNGReader();
+
+    /**
+      * Opens a PNG file and reads its header.
+      * @param fileName Name of the file to read.
+      * @return true, if the file is a PNG image.
+      */
+    bool open(std::string const & fileName);
+
+    /**
+      * Gets the width of the open image.
+      * @return Width of the image.
+      */
+    unsigned int width() const;
+
+    /**
+      * Gets the height of the open image.
+      * @return Height of the image.
+      */
+    unsigned int height() const;
+
+    /**
+      * Decodes the open image, handing each row to `fn` as it is decoded.
+      * @param fn Function to call with each row.
+      * @return true, if every row was decoded and accepted by `fn`.
+      */
+    bool readRows(RowFunction const & fn);
+
+  private:
+    std::unique_ptr<MappedFile> file_;  /*< The open file */
+    unsigned int width_;                /*< Width of the image */
+    unsigned int height_;               /*< Height of the image */
+  };
+
+  /**
+   * Encodes a PNG file row by row as 8-bit RGBA, for images too large to
+   * hold as a PNG. Each row is filtered as it arrives and every 128 KB of
+   * filtered rows is deflated (with the 32 KB before it as the LZ77
+   * window) and written out as an IDAT chunk, so memory use does not grow
+   * with the height of the image.
+   *
+   * The filter, compression and LZ77 settings of EncodeOptions are used,
+   * with each row filtered as PNG::writeToFile() would; autoConvert and
+   * parallel are ignored.
+   */
+  class PNGWriter {
+  public:
+    /**
+      * Creates a writer with no file open.
+      */
+    PNGWriter();
+
+    /**
+      * Destructor: closes the file, finished or not.
+      */
+    ~PNGWriter();
+
+    PNGWriter(PNGWriter const &) = delete;
+    PNGWriter & operator= (PNGWriter const &) = delete;
+
+    /**
+      * Creates a PNG file and writes its header.
+      * @param fileName Name of the file to write.
+      * @param width Width of the image.
+      * @param height Height of the image.
+      * @param options How to filter and compress the rows.
+      * @return true, if the file was created.
+      */
+    bool open(std::string const & fileName, unsigned int width, unsigned int height,
+              EncodeOptions const & options = EncodeOptions());
+
+    /**
+      * Writes the next row of the image.
+      * @param row width() pixels.
+      * @return true, if the row was written.
+      */
+    bool writeRow(const HSLAPixel * row);
+
+    /**
+      * Finishes the file, once every row has been written, and closes it.
+      * @return true, if the complete image was written.
+      */
+    bool close();
+
+  private:
+    std::FILE * file_;                    /*< The file being written */
+    unsigned int width_;                  /*< Width of the image */
+    unsigned int height_;                 /*< Height of the image */
+    unsigned int rows_;                   /*< Rows written so far */
+    EncodeOptions options_;               /*< Filter and compression settings */
+    bool failed_;                         /*< Whether a write has failed */
+    std::vector<unsigned char> current_;  /*< RGBA bytes of the row being written */
+    std::vector<unsigned char> previous_; /*< RGBA bytes of the row before it */
+    std::vector<unsigned char> pending_;  /*< Up to 32 KB already deflated, then filtered bytes not yet */
+    std::size_t dictionary_;              /*< Bytes at the front of pending_ already deflated */
+    unsigned adler_;                      /*< Adler32 of all filtered bytes deflated so far */
+    bool headerWritten_;                  /*< Whether the zlib header has been written */
+
+    void _filterRow();
+    bool _deflate(bool final);
+    bool _writeChunk(const char * type, const unsigned char * data, std::size_t size);
+  };
+}
@@ -0,0 +1,82 @@
+/**
+ * @file ParallelDeflate.cpp
+ * Implementation of multithreaded zlib compression.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "lodepng/lodepng.h"
+#include "ParallelDeflate.h"
+#include "ThreadPool.h"
+
+namespace cs225 {
+  unsigned char * writeZlibHeader(unsigned char * out) {
+    *out++ = 0x78;
+    *out++ = 0x01;
+    return out;
+  }
+
+  unsigned char * writeZlibTrailer(unsigned char * out, unsigned adler) {
+    *out++ = static_cast<unsigned char>(adler >> 24);
+    *out++ = static_cast<unsigned char>(adler >> 16);
+    *out++ = static_cast<unsigned char>(adler >> 8);
+    *out++ = static_cast<unsigned char>(adler);
+    return out;
+  }
+
+  unsigned parallelZlibCompress(unsigned char ** out, std::size_t * outsize,
+                                const unsigned char * in, std::size_t insize,
+                                const LodePNGCompressSettings * settings) {
+    std::size_t blocks = std::max<std::size_t>(1, (insize + deflateBlockSize - 1) / deflateBlockSize);
+    std::vector<unsigned char *> deflated(blocks, nullptr);
+    std::vector<std::size_t> sizes(blocks, 0);
+    std::vector<unsigned> adlers(blocks, 1);
+    std::vector<unsigned> errors(blocks, 0);
+
+    ThreadPool::shared().parallelFor(blocks, 1, [&](std::size_t begin, std::size_t end) {
+      for (std::size_t i = begin; i < end; i++) {
+        std::size_t start = i * deflateBlockSize;
+        std::size_t length = std::min(deflateBlockSize, insize - start);
+        std::size_t dictionary = std::min(start, deflateDictionarySize);
+        errors[i] = lodepng_deflate_chunk(&deflated[i], &sizes[i], in + start - dictionary,
+                                          dictionary, dictionary + length, i == blocks - 1, settings);
+        adlers[i] = lodepng_adler32(in + start, length);
+      }
+    });
+
+    unsigned error = 0;
+    std::size_t total = zlibHeaderSize + zlibTrailerSize;
+    for (std::size_t i = 0; i < blocks; i++) {
+      if (errors[i] && !error) { error = errors[i]; }
+      total += sizes[i];
+    }
+
+    unsigned char * data = error ? nullptr : static_cast<unsigned char *>(std::realloc(*out, *outsize + total));
+    if (!error && !data) { error = 83; }
+    if (!error) {
+      unsigned char * p = writeZlibHeader(data + *outsize);
+
+      unsigned adler = adlers[0];
+      for (std::size_t i = 0; i < blocks; i++) {
+        std::memcpy(p, deflated[i], sizes[i]);
+        p += sizes[i];
+        if (i > 0) {
+          std::size_t length = std::min(deflateBlockSize, insize - i * deflateBlockSize);
+          adler = lodepng_adler32_combine(adler, adlers[i], length);
+        }
+      }
+      writeZlibTrailer(p, adler);
+
+      *out = data;
+      *outsize += total;
+    }
+
+    for (unsigned char * block : deflated) { std::free(block); }
+    return error;
+  }
+}
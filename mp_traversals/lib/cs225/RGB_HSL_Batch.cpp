@@ -0,0 +1,389 @@
+/**
+ * @file RGB_HSL_Batch.cpp
+ * Vectorized RGBA <-> HSLA scanline conversion with runtime CPU dispatch.
+ *
+ * The SIMD paths follow rgb2hsl()/hsl2rgb() operation for operation, so
+ * their results are bit-identical:
+ *  - fmod((g - b) / chroma, 6) is the identity, since |g - b| <= chroma.
+ *  - fmod(hh, 2) is computed as hh - 2 * trunc(hh / 2), which is exact.
+ *  - round() (halfway cases away from zero) is trunc(x) plus one in the
+ *    direction of x when |x - trunc(x)| >= 0.5, which is also exact.
+ *
+ * Set the CS225_SIMD environment variable to "sse4.1" or "none" to cap the
+ * instruction set used (e.g. to compare against the scalar path).
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#include "RGB_HSL_Batch.h"
+#include "RGB_HSL.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CS225_BATCH_X86
+#endif
+
+namespace cs225 {
+  static_assert(sizeof(HSLAPixel) == 4 * sizeof(double), "HSLAPixel must be four packed doubles");
+
+  static void rgba2hslaScalar(const unsigned char * rgba, HSLAPixel * hsla, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+      rgbaColor rgb = {rgba[(i * 4)], rgba[(i * 4) + 1], rgba[(i * 4) + 2], rgba[(i * 4) + 3]};
+      hslaColor hsl = rgb2hsl(rgb);
+      hsla[i].h = hsl.h;
+      hsla[i].s = hsl.s;
+      hsla[i].l = hsl.l;
+      hsla[i].a = hsl.a;
+    }
+  }
+
+  static void hsla2rgbaScalar(const HSLAPixel * hsla, unsigned char * rgba, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) {
+      hslaColor hsl = {hsla[i].h, hsla[i].s, hsla[i].l, hsla[i].a};
+      rgbaColor rgb = hsl2rgb(hsl);
+      rgba[(i * 4)]     = rgb.r;
+      rgba[(i * 4) + 1] = rgb.g;
+      rgba[(i * 4) + 2] = rgb.b;
+      rgba[(i * 4) + 3] = rgb.a;
+    }
+  }
+
+#ifdef CS225_BATCH_X86
+  /*
+   * AVX2: four pixels per iteration, one pixel per double lane.
+   */
+
+  __attribute__((target("avx2")))
+  static inline __m256d roundAVX2(__m256d x) {
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d t = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d frac = _mm256_andnot_pd(sign, _mm256_sub_pd(x, t));
+    __m256d step = _mm256_or_pd(one, _mm256_and_pd(x, sign));
+    return _mm256_add_pd(t, _mm256_and_pd(_mm256_cmp_pd(frac, half, _CMP_GE_OQ), step));
+  }
+
+  __attribute__((target("avx2")))
+  static void rgba2hslaAVX2(const unsigned char * rgba, HSLAPixel * hsla, std::size_t count) {
+    const __m128i planes = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256d k255 = _mm256_set1_pd(255.0);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d sixty = _mm256_set1_pd(60.0);
+    const __m256d k360 = _mm256_set1_pd(360.0);
+    const __m256d eps = _mm256_set1_pd(0.0001);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      // rrrr gggg bbbb aaaa
+      __m128i px = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (rgba + (i * 4))), planes);
+      __m256d r = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_cvtepu8_epi32(px)), k255);
+      __m256d g = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 4))), k255);
+      __m256d b = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 8))), k255);
+      __m256d a = _mm256_div_pd(_mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 12))), k255);
+
+      __m256d min = _mm256_min_pd(_mm256_min_pd(r, g), b);
+      __m256d max = _mm256_max_pd(_mm256_max_pd(r, g), b);
+      __m256d chroma = _mm256_sub_pd(max, min);
+      __m256d l = _mm256_mul_pd(half, _mm256_add_pd(max, min));
+      __m256d gray = _mm256_or_pd(_mm256_cmp_pd(chroma, eps, _CMP_LT_OQ), _mm256_cmp_pd(max, eps, _CMP_LT_OQ));
+
+      __m256d twoLMinusOne = _mm256_sub_pd(_mm256_mul_pd(two, l), one);
+      __m256d s = _mm256_div_pd(chroma, _mm256_sub_pd(one, _mm256_andnot_pd(sign, twoLMinusOne)));
+
+      __m256d hr = _mm256_div_pd(_mm256_sub_pd(g, b), chroma);
+      __m256d hg = _mm256_add_pd(_mm256_div_pd(_mm256_sub_pd(b, r), chroma), two);
+      __m256d hb = _mm256_add_pd(_mm256_div_pd(_mm256_sub_pd(r, g), chroma), four);
+      __m256d h = _mm256_blendv_pd(hb, hg, _mm256_cmp_pd(max, g, _CMP_EQ_OQ));
+      h = _mm256_blendv_pd(h, hr, _mm256_cmp_pd(max, r, _CMP_EQ_OQ));
+      h = _mm256_mul_pd(h, sixty);
+      h = _mm256_blendv_pd(h, _mm256_add_pd(h, k360), _mm256_cmp_pd(h, zero, _CMP_LT_OQ));
+
+      h = _mm256_andnot_pd(gray, h);
+      s = _mm256_andnot_pd(gray, s);
+
+      // Transpose the h, s, l, a planes back into four HSLAPixels
+      __m256d t0 = _mm256_unpacklo_pd(h, s);
+      __m256d t1 = _mm256_unpackhi_pd(h, s);
+      __m256d t2 = _mm256_unpacklo_pd(l, a);
+      __m256d t3 = _mm256_unpackhi_pd(l, a);
+      double * out = reinterpret_cast<double *>(hsla + i);
+      _mm256_storeu_pd(out,      _mm256_permute2f128_pd(t0, t2, 0x20));
+      _mm256_storeu_pd(out + 4,  _mm256_permute2f128_pd(t1, t3, 0x20));
+      _mm256_storeu_pd(out + 8,  _mm256_permute2f128_pd(t0, t2, 0x31));
+      _mm256_storeu_pd(out + 12, _mm256_permute2f128_pd(t1, t3, 0x31));
+    }
+
+    rgba2hslaScalar(rgba + (i * 4), hsla + i, count - i);
+  }
+
+  __attribute__((target("avx2")))
+  static void hsla2rgbaAVX2(const HSLAPixel * hsla, unsigned char * rgba, std::size_t count) {
+    const __m256d k255 = _mm256_set1_pd(255.0);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d three = _mm256_set1_pd(3.0);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m256d five = _mm256_set1_pd(5.0);
+    const __m256d sixty = _mm256_set1_pd(60.0);
+    const __m256d grayS = _mm256_set1_pd(0.001);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      // Transpose four HSLAPixels into h, s, l, a planes
+      const double * in = reinterpret_cast<const double *>(hsla + i);
+      __m256d p0 = _mm256_loadu_pd(in);
+      __m256d p1 = _mm256_loadu_pd(in + 4);
+      __m256d p2 = _mm256_loadu_pd(in + 8);
+      __m256d p3 = _mm256_loadu_pd(in + 12);
+      __m256d t0 = _mm256_unpacklo_pd(p0, p1);
+      __m256d t1 = _mm256_unpackhi_pd(p0, p1);
+      __m256d t2 = _mm256_unpacklo_pd(p2, p3);
+      __m256d t3 = _mm256_unpackhi_pd(p2, p3);
+      __m256d h = _mm256_permute2f128_pd(t0, t2, 0x20);
+      __m256d l = _mm256_permute2f128_pd(t0, t2, 0x31);
+      __m256d s = _mm256_permute2f128_pd(t1, t3, 0x20);
+      __m256d a = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+      __m256d twoLMinusOne = _mm256_sub_pd(_mm256_mul_pd(two, l), one);
+      __m256d c = _mm256_mul_pd(_mm256_sub_pd(one, _mm256_andnot_pd(sign, twoLMinusOne)), s);
+      __m256d hh = _mm256_div_pd(h, sixty);
+      __m256d hhMod2 = _mm256_sub_pd(hh, _mm256_mul_pd(two,
+          _mm256_round_pd(_mm256_div_pd(hh, two), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)));
+      __m256d x = _mm256_mul_pd(c, _mm256_sub_pd(one, _mm256_andnot_pd(sign, _mm256_sub_pd(hhMod2, one))));
+
+      // Pick the hue sector; the first matching `hh <= n` test wins
+      __m256d r = c, g = zero, b = x;
+      __m256d m = _mm256_cmp_pd(hh, five, _CMP_LE_OQ);
+      r = _mm256_blendv_pd(r, x, m);    g = _mm256_blendv_pd(g, zero, m); b = _mm256_blendv_pd(b, c, m);
+      m = _mm256_cmp_pd(hh, four, _CMP_LE_OQ);
+      r = _mm256_blendv_pd(r, zero, m); g = _mm256_blendv_pd(g, x, m);    b = _mm256_blendv_pd(b, c, m);
+      m = _mm256_cmp_pd(hh, three, _CMP_LE_OQ);
+      r = _mm256_blendv_pd(r, zero, m); g = _mm256_blendv_pd(g, c, m);    b = _mm256_blendv_pd(b, x, m);
+      m = _mm256_cmp_pd(hh, two, _CMP_LE_OQ);
+      r = _mm256_blendv_pd(r, x, m);    g = _mm256_blendv_pd(g, c, m);    b = _mm256_blendv_pd(b, zero, m);
+      m = _mm256_cmp_pd(hh, one, _CMP_LE_OQ);
+      r = _mm256_blendv_pd(r, c, m);    g = _mm256_blendv_pd(g, x, m);    b = _mm256_blendv_pd(b, zero, m);
+
+      __m256d offset = _mm256_sub_pd(l, _mm256_mul_pd(half, c));
+      r = roundAVX2(_mm256_mul_pd(_mm256_add_pd(r, offset), k255));
+      g = roundAVX2(_mm256_mul_pd(_mm256_add_pd(g, offset), k255));
+      b = roundAVX2(_mm256_mul_pd(_mm256_add_pd(b, offset), k255));
+
+      __m256d gray = _mm256_cmp_pd(s, grayS, _CMP_LE_OQ);
+      __m256d grayValue = roundAVX2(_mm256_mul_pd(l, k255));
+      r = _mm256_blendv_pd(r, grayValue, gray);
+      g = _mm256_blendv_pd(g, grayValue, gray);
+      b = _mm256_blendv_pd(b, grayValue, gray);
+      a = roundAVX2(_mm256_mul_pd(a, k255));
+
+      // Keep the low byte of each channel, as the scalar conversion does
+      __m128i ri = _mm_and_si128(_mm256_cvttpd_epi32(r), lowByte);
+      __m128i gi = _mm_and_si128(_mm256_cvttpd_epi32(g), lowByte);
+      __m128i bi = _mm_and_si128(_mm256_cvttpd_epi32(b), lowByte);
+      __m128i ai = _mm_and_si128(_mm256_cvttpd_epi32(a), lowByte);
+      __m128i packed = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)),
+                                    _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_slli_epi32(ai, 24)));
+      _mm_storeu_si128((__m128i *) (rgba + (i * 4)), packed);
+    }
+
+    hsla2rgbaScalar(hsla + i, rgba + (i * 4), count - i);
+  }
+
+  /*
+   * SSE4.1: two pixels per iteration, one pixel per double lane.
+   */
+
+  __attribute__((target("sse4.1")))
+  static inline __m128d roundSSE41(__m128d x) {
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    __m128d t = _mm_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m128d frac = _mm_andnot_pd(sign, _mm_sub_pd(x, t));
+    __m128d step = _mm_or_pd(one, _mm_and_pd(x, sign));
+    return _mm_add_pd(t, _mm_and_pd(_mm_cmpge_pd(frac, half), step));
+  }
+
+  __attribute__((target("sse4.1")))
+  static void rgba2hslaSSE41(const unsigned char * rgba, HSLAPixel * hsla, std::size_t count) {
+    const __m128i planes = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128d k255 = _mm_set1_pd(255.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d sixty = _mm_set1_pd(60.0);
+    const __m128d k360 = _mm_set1_pd(360.0);
+    const __m128d eps = _mm_set1_pd(0.0001);
+    const __m128d sign = _mm_set1_pd(-0.0);
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+      // rr gg bb aa
+      __m128i px = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *) (rgba + (i * 4))), planes);
+      __m128d r = _mm_div_pd(_mm_cvtepi32_pd(_mm_cvtepu8_epi32(px)), k255);
+      __m128d g = _mm_div_pd(_mm_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 2))), k255);
+      __m128d b = _mm_div_pd(_mm_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 4))), k255);
+      __m128d a = _mm_div_pd(_mm_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(px, 6))), k255);
+
+      __m128d min = _mm_min_pd(_mm_min_pd(r, g), b);
+      __m128d max = _mm_max_pd(_mm_max_pd(r, g), b);
+      __m128d chroma = _mm_sub_pd(max, min);
+      __m128d l = _mm_mul_pd(half, _mm_add_pd(max, min));
+      __m128d gray = _mm_or_pd(_mm_cmplt_pd(chroma, eps), _mm_cmplt_pd(max, eps));
+
+      __m128d twoLMinusOne = _mm_sub_pd(_mm_mul_pd(two, l), one);
+      __m128d s = _mm_div_pd(chroma, _mm_sub_pd(one, _mm_andnot_pd(sign, twoLMinusOne)));
+
+      __m128d hr = _mm_div_pd(_mm_sub_pd(g, b), chroma);
+      __m128d hg = _mm_add_pd(_mm_div_pd(_mm_sub_pd(b, r), chroma), two);
+      __m128d hb = _mm_add_pd(_mm_div_pd(_mm_sub_pd(r, g), chroma), four);
+      __m128d h = _mm_blendv_pd(hb, hg, _mm_cmpeq_pd(max, g));
+      h = _mm_blendv_pd(h, hr, _mm_cmpeq_pd(max, r));
+      h = _mm_mul_pd(h, sixty);
+      h = _mm_blendv_pd(h, _mm_add_pd(h, k360), _mm_cmplt_pd(h, zero));
+
+      h = _mm_andnot_pd(gray, h);
+      s = _mm_andnot_pd(gray, s);
+
+      double * out = reinterpret_cast<double *>(hsla + i);
+      _mm_storeu_pd(out,     _mm_unpacklo_pd(h, s));
+      _mm_storeu_pd(out + 2, _mm_unpacklo_pd(l, a));
+      _mm_storeu_pd(out + 4, _mm_unpackhi_pd(h, s));
+      _mm_storeu_pd(out + 6, _mm_unpackhi_pd(l, a));
+    }
+
+    rgba2hslaScalar(rgba + (i * 4), hsla + i, count - i);
+  }
+
+  __attribute__((target("sse4.1")))
+  static void hsla2rgbaSSE41(const HSLAPixel * hsla, unsigned char * rgba, std::size_t count) {
+    const __m128d k255 = _mm_set1_pd(255.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d two = _mm_set1_pd(2.0);
+    const __m128d three = _mm_set1_pd(3.0);
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d five = _mm_set1_pd(5.0);
+    const __m128d sixty = _mm_set1_pd(60.0);
+    const __m128d grayS = _mm_set1_pd(0.001);
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128i lowByte = _mm_set1_epi32(0xFF);
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+      const double * in = reinterpret_cast<const double *>(hsla + i);
+      __m128d q0 = _mm_loadu_pd(in);
+      __m128d q1 = _mm_loadu_pd(in + 2);
+      __m128d q2 = _mm_loadu_pd(in + 4);
+      __m128d q3 = _mm_loadu_pd(in + 6);
+      __m128d h = _mm_unpacklo_pd(q0, q2);
+      __m128d s = _mm_unpackhi_pd(q0, q2);
+      __m128d l = _mm_unpacklo_pd(q1, q3);
+      __m128d a = _mm_unpackhi_pd(q1, q3);
+
+      __m128d twoLMinusOne = _mm_sub_pd(_mm_mul_pd(two, l), one);
+      __m128d c = _mm_mul_pd(_mm_sub_pd(one, _mm_andnot_pd(sign, twoLMinusOne)), s);
+      __m128d hh = _mm_div_pd(h, sixty);
+      __m128d hhMod2 = _mm_sub_pd(hh, _mm_mul_pd(two,
+          _mm_round_pd(_mm_div_pd(hh, two), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)));
+      __m128d x = _mm_mul_pd(c, _mm_sub_pd(one, _mm_andnot_pd(sign, _mm_sub_pd(hhMod2, one))));
+
+      __m128d r = c, g = zero, b = x;
+      __m128d m = _mm_cmple_pd(hh, five);
+      r = _mm_blendv_pd(r, x, m);    g = _mm_blendv_pd(g, zero, m); b = _mm_blendv_pd(b, c, m);
+      m = _mm_cmple_pd(hh, four);
+      r = _mm_blendv_pd(r, zero, m); g = _mm_blendv_pd(g, x, m);    b = _mm_blendv_pd(b, c, m);
+      m = _mm_cmple_pd(hh, three);
+      r = _mm_blendv_pd(r, zero, m); g = _mm_blendv_pd(g, c, m);    b = _mm_blendv_pd(b, x, m);
+      m = _mm_cmple_pd(hh, two);
+      r = _mm_blendv_pd(r, x, m);    g = _mm_blendv_pd(g, c, m);    b = _mm_blendv_pd(b, zero, m);
+      m = _mm_cmple_pd(hh, one);
+      r = _mm_blendv_pd(r, c, m);    g = _mm_blendv_pd(g, x, m);    b = _mm_blendv_pd(b, zero, m);
+
+      __m128d offset = _mm_sub_pd(l, _mm_mul_pd(half, c));
+      r = roundSSE41(_mm_mul_pd(_mm_add_pd(r, offset), k255));
+      g = roundSSE41(_mm_mul_pd(_mm_add_pd(g, offset), k255));
+      b = roundSSE41(_mm_mul_pd(_mm_add_pd(b, offset), k255));
+
+      __m128d gray = _mm_cmple_pd(s, grayS);
+      __m128d grayValue = roundSSE41(_mm_mul_pd(l, k255));
+      r = _mm_blendv_pd(r, grayValue, gray);
+      g = _mm_blendv_pd(g, grayValue, gray);
+      b = _mm_blendv_pd(b, grayValue, gray);
+      a = roundSSE41(_mm_mul_pd(a, k255));
+
+      __m128i ri = _mm_and_si128(_mm_cvttpd_epi32(r), lowByte);
+      __m128i gi = _mm_and_si128(_mm_cvttpd_epi32(g), lowByte);
+      __m128i bi = _mm_and_si128(_mm_cvttpd_epi32(b), lowByte);
+      __m128i ai = _mm_and_si128(_mm_cvttpd_epi32(a), lowByte);
+      __m128i packed = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)),
+                                    _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_slli_epi32(ai, 24)));
+      _mm_storel_epi64((__m128i *) (rgba + (i * 4)), packed);
+    }
+
+    hsla2rgbaScalar(hsla + i, rgba + (i * 4), count - i);
+  }
+#endif
+
+  typedef void (*ToHslaFunction)(const unsigned char *, HSLAPixel *, std::size_t);
+  typedef void (*ToRgbaFunction)(const HSLAPixel *, unsigned char *, std::size_t);
+
+  /**
+   * Highest instruction set the CPU supports, capped by CS225_SIMD.
+   * 0 = scalar, 1 = SSE4.1, 2 = AVX2.
+   */
+  static int simdLevel() {
+    int level = 0;
+#ifdef CS225_BATCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) { level = 1; }
+    if (__builtin_cpu_supports("avx2")) { level = 2; }
+#endif
+    const char * cap = std::getenv("CS225_SIMD");
+    if (cap != NULL && std::strcmp(cap, "none") == 0 && level > 0) { level = 0; }
+    if (cap != NULL && std::strcmp(cap, "sse4.1") == 0 && level > 1) { level = 1; }
+    return level;
+  }
+
+  void rgba2hslaBatch(const unsigned char * rgba, HSLAPixel * hsla, std::size_t count) {
+    static const ToHslaFunction convert = [] {
+      switch (simdLevel()) {
+#ifdef CS225_BATCH_X86
+        case 2: return rgba2hslaAVX2;
+        case 1: return rgba2hslaSSE41;
+#endif
+        default: return rgba2hslaScalar;
+      }
+    }();
+    convert(rgba, hsla, count);
+  }
+
+  void hsla2rgbaBatch(const HSLAPixel * hsla, unsigned char * rgba, std::size_t count) {
+    static const ToRgbaFunction convert = [] {
+      switch (simdLevel()) {
+#ifdef CS225_BATCH_X86
+        case 2: return hsla2rgbaAVX2;
+        case 1: return hsla2rgbaSSE41;
+#endif
+        default: return hsla2rgbaScalar;
+      }
+    }();
+    convert(hsla, rgba, count);
+  }
+}
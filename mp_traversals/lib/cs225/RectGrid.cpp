@@ -0,0 +1,66 @@
+/**
+ * @file RectGrid.cpp
+ * Implementation of the rectangle grid index.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+
+#include "RectGrid.h"
+
+namespace cs225 {
+  static bool overlaps(PNG::Rect const & a, PNG::Rect const & b) {
+    return std::uint64_t(a.x) < std::uint64_t(b.x) + b.width && std::uint64_t(b.x) < std::uint64_t(a.x) + a.width
+        && std::uint64_t(a.y) < std::uint64_t(b.y) + b.height && std::uint64_t(b.y) < std::uint64_t(a.y) + a.height;
+  }
+
+  RectGrid::RectGrid(unsigned int cellSize) : cellSize_(std::max(cellSize, 1u)) { }
+
+  void RectGrid::clear() {
+    rects_.clear();
+    cells_.clear();
+  }
+
+  void RectGrid::set(std::size_t id, PNG::Rect const & rect) {
+    if (id >= rects_.size()) { rects_.resize(id + 1, PNG::Rect{0, 0, 0, 0}); }
+
+    // Take the id out of the cells of its old rectangle
+    for (std::uint64_t key : _cellsOf(rects_[id])) {
+      std::vector<std::size_t> & ids = cells_[key];
+      ids.erase(std::find(ids.begin(), ids.end(), id));
+      if (ids.empty()) { cells_.erase(key); }
+    }
+
+    rects_[id] = rect;
+    for (std::uint64_t key : _cellsOf(rect)) { cells_[key].push_back(id); }
+  }
+
+  std::vector<std::size_t> RectGrid::query(PNG::Rect const & rect) const {
+    std::vector<std::size_t> found;
+    for (std::uint64_t key : _cellsOf(rect)) {
+      auto cell = cells_.find(key);
+      if (cell == cells_.end()) { continue; }
+      for (std::size_t id : cell->second) {
+        if (overlaps(rects_[id], rect)) { found.push_back(id); }
+      }
+    }
+
+    // A rectangle spanning several of the cells is found once in each
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    return found;
+  }
+
+  std::vector<std::uint64_t> RectGrid::_cellsOf(PNG::Rect const & rect) const {
+    std::vector<std::uint64_t> keys;
+    if (rect.width == 0 || rect.height == 0) { return keys; }
+    std::uint64_t left = rect.x / cellSize_, right = (std::uint64_t(rect.x) + rect.width - 1) / cellSize_;
+    std::uint64_t top = rect.y / cellSize_, bottom = (std::uint64_t(rect.y) + rect.height - 1) / cellSize_;
+    keys.reserve((right - left + 1) * (bottom - top + 1));
+    for (std::uint64_t y = top; y <= bottom; y++) {
+      for (std::uint64_t x = left; x <= right; x++) { keys.push_back((x << 32) | y); }
+    }
+    return keys;
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file RectGrid.h
+ * A uniform grid index of rectangles.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "PNG.h"
+
+namespace cs225 {
+  /**
+   * Finds which of many rectangles, each known by a small integer id,
+   * overlap a given area. The plane is cut into square cells and each
+   * rectangle is listed in every cell it touches, so a query looks only at
+   * the rectangles in the cells it covers rather than at all of them.
+   * Cells are hashed, so a sparse, very large plane costs nothing for its
+   * empty parts.
+   */
+  class RectGrid {
+  public:
+    /**
+      * Creates an empty grid.
+      * @param cellSize Width and height of each cell, in pixels.
+      */
+    explicit RectGrid(unsigned int cellSize = 256);
+
+    /**
+      * Removes every rectangle.
+      */
+    void clear();
+
+    /**
+      * Sets the rectangle with the given id, replacing any it had; an
+      * empty rectangle removes it.
+      * @param id Id of the rectangle; the grid keeps a slot for every id
+      *   up to the largest one set, so ids should be dense.
+      * @param rect The rectangle.
+      */
+    void set(std::size_t id, PNG::Rect const & rect);
+
+    /**
+      * Gets the ids of the rectangles that overlap `rect`.
+      * @param rect Area to look in.
+      * @return The ids, in increasing order.
+      */
+    std::vector<std::size_t> query(PNG::Rect const & rect) const;
+
+  private:
+    unsigned int cellSize_;                                               /*< Size of each cell */
+    std::vector<PNG::Rect> rects_;                                        /*< Rectangle of each id; empty if none */
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> cells_;   /*< Ids in each non-empty cell */
+
+    /**
+      * Gets the keys of the cells that `rect` touches.
+      */
+    std::vector<std::uint64_t> _cellsOf(PNG::Rect const & rect) const;
+  };
+}
@@ -0,0 +1,244 @@
+/**
+ * @file Resample.cpp
+ * Implementation of separable image resampling.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Resample.h"
+#include "RGB_HSL_Batch.h"
+#include "ThreadPool.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace cs225 {
+  /** A filter kernel: weight(x) is zero for |x| >= radius. */
+  struct Kernel {
+    double radius;
+    double (*weight)(double x);
+  };
+
+  static double triangle(double x) {
+    x = std::fabs(x);
+    return (x < 1) ? (1 - x) : 0;
+  }
+
+  /** The cubic convolution kernel with a = -0.5 (Catmull-Rom). */
+  static double catmullRom(double x) {
+    x = std::fabs(x);
+    if (x < 1) { return (((1.5 * x) - 2.5) * x * x) + 1; }
+    if (x < 2) { return (((((-0.5 * x) + 2.5) * x) - 4) * x) + 2; }
+    return 0;
+  }
+
+  static double sinc(double x) {
+    const double pi = 3.14159265358979323846;
+    if (x == 0) { return 1; }
+    x *= pi;
+    return std::sin(x) / x;
+  }
+
+  static double lanczos3(double x) {
+    return (std::fabs(x) < 3) ? sinc(x) * sinc(x / 3) : 0;
+  }
+
+  static Kernel kernelFor(ResampleFilter filter) {
+    switch (filter) {
+      case ResampleFilter::Bicubic: return { 2, catmullRom };
+      case ResampleFilter::Lanczos: return { 3, lanczos3 };
+      default: return { 1, triangle };
+    }
+  }
+
+  /**
+   * The weights that make each of `dstSize` output pixels from `srcSize`
+   * source pixels along one axis: output pixel i is the sum over k < taps
+   * of weights[(i * taps) + k] times source pixel first[i] + k. Every
+   * window lies within [0, srcSize); pixels beyond the edges are treated
+   * as copies of the edge pixel.
+   */
+  struct WeightTable {
+    unsigned taps;
+    std::vector<unsigned> first;
+    std::vector<float> weights;
+  };
+
+  static WeightTable makeWeights(unsigned srcSize, unsigned dstSize, Kernel kernel) {
+    double scale = double(dstSize) / srcSize;
+    // When shrinking, stretch the kernel over the source pixels each output pixel covers
+    double stretch = (scale < 1) ? (1 / scale) : 1;
+    double support = kernel.radius * stretch;
+
+    std::vector<std::vector<double>> windows(dstSize);
+    std::vector<unsigned> starts(dstSize);
+    unsigned taps = 1;
+    for (unsigned i = 0; i < dstSize; i++) {
+      double center = (i + 0.5) / scale;
+      long lo = std::max(0L, long(std::floor(center - support)));
+      long hi = std::min(long(srcSize) - 1, long(std::ceil(center + support)));
+      std::vector<double> & window = windows[i];
+      window.assign(hi - lo + 1, 0.0);
+
+      // Weights of pixels beyond the edges go to the edge pixel
+      double total = 0;
+      for (long j = long(std::floor(center - support)); j <= long(std::ceil(center + support)); j++) {
+        double weight = kernel.weight(((j + 0.5) - center) / stretch);
+        window[std::min(std::max(j, lo), hi) - lo] += weight;
+        total += weight;
+      }
+      for (double & weight : window) { weight /= total; }
+
+      starts[i] = unsigned(lo);
+      taps = std::max(taps, unsigned(window.size()));
+    }
+
+    WeightTable table;
+    table.taps = taps;
+    table.first.resize(dstSize);
+    table.weights.assign(std::size_t(dstSize) * taps, 0.0f);
+    for (unsigned i = 0; i < dstSize; i++) {
+      // Pad every window to `taps` weights without reaching past the edge
+      unsigned first = std::min(starts[i], srcSize - taps);
+      unsigned offset = starts[i] - first;
+      table.first[i] = first;
+      for (std::size_t k = 0; k < windows[i].size(); k++) {
+        table.weights[(std::size_t(i) * taps) + offset + k] = float(windows[i][k]);
+      }
+    }
+    return table;
+  }
+
+  /** Converts a row of HSLAPixels to RGBA floats in [0, 255], alpha premultiplied. */
+  static void loadRow(const HSLAPixel * row, unsigned width, unsigned char * bytes, float * out) {
+    hsla2rgbaBatch(row, bytes, width);
+    for (unsigned x = 0; x < width; x++) {
+      const unsigned char * p = bytes + (x * 4);
+      float alpha = p[3] * (1.0f / 255);
+      out[(x * 4)] = p[0] * alpha;
+      out[(x * 4) + 1] = p[1] * alpha;
+      out[(x * 4) + 2] = p[2] * alpha;
+      out[(x * 4) + 3] = p[3];
+    }
+  }
+
+  /** Converts premultiplied RGBA floats back to a row of HSLAPixels. */
+  static void storeRow(const float * in, unsigned width, unsigned char * bytes, HSLAPixel * row) {
+    for (unsigned x = 0; x < width; x++) {
+      const float * p = in + (x * 4);
+      float alpha = std::min(std::max(p[3], 0.0f), 255.0f);
+      float unpremultiply = (alpha > 0) ? (255 / alpha) : 0;
+      for (unsigned c = 0; c < 3; c++) {
+        float value = std::min(std::max(p[c] * unpremultiply, 0.0f), 255.0f);
+        bytes[(x * 4) + c] = (unsigned char) std::lround(value);
+      }
+      bytes[(x * 4) + 3] = (unsigned char) std::lround(alpha);
+    }
+    rgba2hslaBatch(bytes, row, width);
+  }
+
+  /** Filters one row of RGBA floats along x. */
+  static void filterRow(const float * in, float * out, WeightTable const & table, unsigned width) {
+    unsigned taps = table.taps;
+    for (unsigned x = 0; x < width; x++) {
+      const float * weights = table.weights.data() + (std::size_t(x) * taps);
+      const float * pixel = in + (std::size_t(table.first[x]) * 4);
+#ifdef __SSE2__
+      // One RGBA pixel per register
+      __m128 sum = _mm_setzero_ps();
+      for (unsigned k = 0; k < taps; k++) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(pixel + (k * 4))));
+      }
+      _mm_storeu_ps(out + (std::size_t(x) * 4), sum);
+#else
+      float sum[4] = {0, 0, 0, 0};
+      for (unsigned k = 0; k < taps; k++) {
+        for (unsigned c = 0; c < 4; c++) { sum[c] += weights[k] * pixel[(k * 4) + c]; }
+      }
+      std::copy(sum, sum + 4, out + (std::size_t(x) * 4));
+#endif
+    }
+  }
+
+  /** Adds `weight` times `row` to `sum`, for `count` floats. */
+  static void accumulate(float * sum, const float * row, float weight, std::size_t count) {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    __m128 w = _mm_set1_ps(weight);
+    for (; i + 4 <= count; i += 4) {
+      _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(w, _mm_loadu_ps(row + i))));
+    }
+#endif
+    for (; i < count; i++) { sum[i] += weight * row[i]; }
+  }
+
+  static void resampleNearest(PNG const & source, PNG & destination, unsigned width, unsigned height) {
+    std::vector<unsigned> columns(width);
+    for (unsigned x = 0; x < width; x++) {
+      columns[x] = unsigned((std::size_t(x) * source.width()) / width);
+    }
+
+    const HSLAPixel * in = source.row(0);
+    std::size_t sourceWidth = source.width();
+    std::size_t sourceHeight = source.height();
+    destination.forEachRow([in, &columns, width, height, sourceWidth, sourceHeight](unsigned y, HSLAPixel * row) {
+      const HSLAPixel * from = in + (((std::size_t(y) * sourceHeight) / height) * sourceWidth);
+      for (unsigned x = 0; x < width; x++) { row[x] = from[columns[x]]; }
+    });
+  }
+
+  void resample(PNG const & source, PNG & destination, unsigned int width, unsigned int height,
+                ResampleFilter filter) {
+    destination = PNG(width, height);
+    if (width == 0 || height == 0 || source.width() == 0 || source.height() == 0) { return; }
+    if (filter == ResampleFilter::Nearest) {
+      resampleNearest(source, destination, width, height);
+      return;
+    }
+
+    Kernel kernel = kernelFor(filter);
+    const WeightTable columns = makeWeights(source.width(), width, kernel);
+    const WeightTable rows = makeWeights(source.height(), height, kernel);
+    unsigned sourceWidth = source.width();
+
+    // Take the rows' addresses up front: row() may expand or detach the
+    // images, which must not happen from several threads at once
+    const HSLAPixel * in = source.row(0);
+    HSLAPixel * out = destination.row(0);
+
+    // Split the output rows so that each task filters about a megabyte of
+    // source rows along x, then combines them along y
+    std::size_t sourceRowsPerRow = std::max<std::size_t>(1, source.height() / height);
+    std::size_t grain = std::max<std::size_t>(4, (std::size_t(1) << 16) / (std::size_t(width) * sourceRowsPerRow));
+
+    ThreadPool::shared().parallelFor(height, grain, [&](std::size_t begin, std::size_t end) {
+      unsigned firstRow = rows.first[begin];
+      unsigned lastRow = rows.first[end - 1] + rows.taps;
+
+      std::vector<unsigned char> bytes(std::size_t(std::max(sourceWidth, width)) * 4);
+      std::vector<float> line(std::size_t(sourceWidth) * 4);
+      std::vector<float> filtered(std::size_t(lastRow - firstRow) * width * 4);
+      for (unsigned y = firstRow; y < lastRow; y++) {
+        loadRow(in + (std::size_t(y) * sourceWidth), sourceWidth, bytes.data(), line.data());
+        filterRow(line.data(), filtered.data() + (std::size_t(y - firstRow) * width * 4), columns, width);
+      }
+
+      std::vector<float> sum(std::size_t(width) * 4);
+      for (std::size_t y = begin; y < end; y++) {
+        std::fill(sum.begin(), sum.end(), 0.0f);
+        const float * weights = rows.weights.data() + (y * rows.taps);
+        for (unsigned k = 0; k < rows.taps; k++) {
+          if (weights[k] == 0) { continue; }
+          const float * row = filtered.data() + (std::size_t(rows.first[y] + k - firstRow) * width * 4);
+          accumulate(sum.data(), row, weights[k], sum.size());
+        }
+        storeRow(sum.data(), width, bytes.data(), out + (y * width));
+      }
+    });
+  }
+}
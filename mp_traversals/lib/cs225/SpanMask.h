@@ -0,0 +1,82 @@
+/**
+ * @file SpanMask.h
+ * Run-length encoding of the opaque pixels of an image.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace cs225 {
+  class PNG;
+
+  /**
+   * The runs of pixels with non-zero alpha in each row of an image, so
+   * that compositing it (see PNG::blit()) can copy each run with a single
+   * memcpy and skip transparent areas without looking at them. The mask
+   * describes the image as it was when the mask was made; make a new one
+   * after changing the image.
+   */
+  class SpanMask {
+  public:
+    /**
+      * A run of opaque pixels: columns [begin, end) of a row.
+      */
+    struct Span {
+      unsigned int begin;
+      unsigned int end;
+    };
+
+    /**
+      * Creates an empty mask, for a 0x0 image.
+      */
+    SpanMask();
+
+    /**
+      * Creates the mask of the given image.
+      * @param image Image to find the opaque runs of.
+      */
+    explicit SpanMask(PNG const & image);
+
+    /**
+      * Gets the width of the image the mask was made from.
+      * @return Width of the image.
+      */
+    unsigned int width() const;
+
+    /**
+      * Gets the height of the image the mask was made from.
+      * @return Height of the image.
+      */
+    unsigned int height() const;
+
+    /**
+      * Gets the first opaque run of row `y`; the runs of a row are
+      * contiguous, in increasing order, and end at rowEnd(y).
+      * @param y Row to get the runs of, in [0, height()).
+      * @return Pointer to the first run.
+      */
+    const Span * rowBegin(unsigned int y) const;
+
+    /**
+      * Gets one past the last opaque run of row `y`.
+      * @param y Row to get the runs of, in [0, height()).
+      * @return Pointer past the last run.
+      */
+    const Span * rowEnd(unsigned int y) const;
+
+    /**
+      * Gets the fraction of the image's pixels that are opaque.
+      * @return Opaque pixels divided by all pixels, 0 for an empty image.
+      */
+    double coverage() const;
+
+  private:
+    unsigned int width_;               /*< Width of the image */
+    unsigned int height_;              /*< Height of the image */
+    std::vector<Span> spans_;          /*< Runs of all rows, in row order */
+    std::vector<unsigned int> rows_;   /*< Index in spans_ of each row's first run, then spans_.size() */
+  };
+}
@@ -0,0 +1,89 @@
+/**
+ * @file ThreadPool.h
+ * A small fixed-size pool of worker threads for data-parallel loops.
+ *
+ * @author CS 225: Data Structures
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cs225 {
+  class ThreadPool {
+  public:
+    /**
+      * The function run by parallelFor(): called with a half-open range
+      * [begin, end) of loop indices.
+      */
+    typedef std::function<void(std::size_t begin, std::size_t end)> RangeFunction;
+
+    /**
+      * Creates a pool with the given number of worker threads. The thread
+      * calling parallelFor() also does work, so a pool of size 0 simply runs
+      * every loop on the calling thread.
+      * @param threads Number of worker threads to start.
+      */
+    explicit ThreadPool(unsigned threads);
+
+    /**
+      * Destructor: stops and joins all worker threads.
+      */
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const & other) = delete;
+    ThreadPool & operator=(ThreadPool const & other) = delete;
+
+    /**
+      * Gets the pool shared by the whole library, sized to the number of
+      * hardware threads.
+      * @return The shared pool.
+      */
+    static ThreadPool & shared();
+
+    /**
+      * Gets the number of threads that run a parallelFor(), including the
+      * calling thread.
+      * @return The number of threads.
+      */
+    unsigned concurrency() const;
+
+    /**
+      * Runs fn over [0, count) in chunks of at most `grain` indices and
+      * blocks until every chunk has finished. Chunks run concurrently, so
+      * fn must only write to data owned by its own range. May be called
+      * from inside another parallelFor(). If fn throws, the first
+      * exception is rethrown here once all chunks are done.
+      * @param count Number of loop indices.
+      * @param grain Maximum number of indices handed to one call of fn.
+      * @param fn Function run on each chunk.
+      */
+    void parallelFor(std::size_t count, std::size_t grain, RangeFunction const & fn);
+
+  private:
+    struct Job;
+
+    std::vector<std::thread> workers_;              /*< Worker threads */
+    std::deque<std::shared_ptr<Job>> jobs_;         /*< Jobs with chunks left to hand out */
+    std::mutex mutex_;                              /*< Guards jobs_ and stopping_ */
+    std::condition_variable wake_;                  /*< Signals new jobs or shutdown */
+    bool stopping_;                                 /*< Set when the pool is being destroyed */
+
+    /**
+     * Main loop of each worker thread.
+     */
+    void _workerLoop();
+
+    /**
+     * Runs chunks of `job` until none are left to claim.
+     */
+    static void _runChunks(Job & job);
+  };
+}
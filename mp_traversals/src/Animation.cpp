@@ -15,6 +15,7 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
 #include "Animation.h"
 #include "cs225/PNG.h"
 
@@ -57,6 +58,10 @@ void Animation::addFrame(PNG const& img) {
     frames.push_back(img);
 }
 
+void Animation::addFrame(PNG&& img) {
+    frames.push_back(std::move(img));
+}
+
 PNG Animation::getFrame(unsigned index) {
   return frames[index];
 }
@@ -39,6 +39,14 @@ class Animation
      */
     void addFrame(const PNG& img);
 
+    /**
+     * Adds a frame to the animation, taking its pixels instead of
+     * copying them.
+     *
+     * @param img The image to be added; left empty afterwards.
+     */
+    void addFrame(PNG&& img);
+
     /**
      * Writes the animation to the file name specified.
      *